@@ -37,6 +37,57 @@ extern int pthread_fchdir_np(int fd);
   return true;
 }
 
++ (BOOL)tiocsti:(const uint8_t *)bytes length:(size_t)length error:(NSError **)error {
+  int fd = fileno(stdin);
+  for (size_t idx = 0; idx < length; ++idx) {
+    const char value = bytes[idx];
+    if (ioctl(fd, TIOCSTI, &value) < 0) {
+      *error = [[NSError alloc] initWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+      return false;
+    }
+  }
+  return true;
+}
+
++ (pid_t)spawn:(NSArray<NSString *> *)args tty:(NSString *)tty error:(NSError **)error {
+  if (args.count == 0) {
+    *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EINVAL userInfo:nil];
+    return 0;
+  }
+
+  // Everything must be prepared before fork, as the child may only call async-signal-safe functions.
+  const char *path = tty.fileSystemRepresentation;
+  const char **argv = calloc(args.count + 1, sizeof(char *));
+  for (NSUInteger idx = 0; idx < args.count; ++idx)
+    argv[idx] = args[idx].UTF8String;
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+    free(argv);
+    return 0;
+  }
+
+  if (pid == 0) {
+    // Child: new session, and acquire the pty as controlling terminal.
+    if (setsid() < 0)
+      _exit(127);
+    int slave = open(path, O_RDWR);
+    if (slave < 0 || ioctl(slave, TIOCSCTTY, 0) < 0)
+      _exit(127);
+    dup2(slave, STDIN_FILENO);
+    dup2(slave, STDOUT_FILENO);
+    dup2(slave, STDERR_FILENO);
+    if (slave > STDERR_FILENO)
+      close(slave);
+    execvp(argv[0], (char * const *)argv);
+    _exit(127);
+  }
+
+  free(argv);
+  return pid;
+}
+
 @end
 
 @implementation Socket
@@ -18,6 +18,13 @@ NS_ASSUME_NONNULL_BEGIN
 
 + (BOOL)tiocsti:(uint8_t)c error:(NSError ** _Nullable)error;
 
+/// Push a whole buffer into the input queue of the current tty.
+/// This still performs one ioctl() per byte, but avoid crossing the Swift/ObjC boundary for each of them.
++ (BOOL)tiocsti:(const uint8_t *)bytes length:(size_t)length error:(NSError ** _Nullable)error;
+
+/// Spawn a process in a new session, with the pty slave at path `tty` as controlling terminal and standard streams.
++ (pid_t)spawn:(NSArray<NSString *> *)args tty:(NSString *)tty error:(NSError ** _Nullable)error __attribute__((swift_error(zero_result)));
+
 @end
 
 @interface Socket : NSObject
@@ -7,7 +7,6 @@
 
 import Foundation
 import System
-import RegexBuilder
 
 
 extension Settings {
@@ -21,13 +20,8 @@ extension Settings {
       try hostList.add(host, command: nil)
     }
     
-    do {
-      try hostList.load(clustersFile: "/etc/clusters")
-    } catch CocoaError.fileNoSuchFile {
-      logger.debug("/etc/clusters does not exists. Skipping it.")
-    } catch {
-      throw error
-    }
+    // Skipped if it does not exists.
+    hostList.load(clustersFile: "/etc/clusters")
     
     // Load predefined csshrc files
     for file in ["/etc/csshrc", "~/.csshrc"] {
@@ -50,6 +44,9 @@ extension Settings {
       try settings.load(csshrc: FilePath(file), hosts: &hostList)
     }
     
+    // All clusters sources are known -> compile them (or load them from cache).
+    try hostList.compileClusters()
+    
     options.override(&settings)
     sshOptions.override(&settings)
     layoutOptions.override(&settings)
@@ -57,49 +54,61 @@ extension Settings {
   }
   
   mutating func load(csshrc file: FilePath, hosts: inout HostList) throws {
+    // Values are applied once the whole file is read, as clusters may be declared after their definition.
+    struct Entry {
+      let value: String
+      let line: Int
+      let keyColumn: Int
+      let valueColumn: Int
+    }
     var clusters = Set<String>()
-    var settings = [String:String]()
+    var settings = [String: Entry]()
     
-    let comment = /#.*$/
-    try file.readLines { line in
-      let l = line.replacing(comment, with: "")
-      guard let match = l.wholeMatch(of: /^\s*(\S+)\s*=\s*(.*?)\s*$/) else {
-        if !l.isEmpty {
-          logger.warning("invalid csshrc line: \(l, privacy: .public))")
-        }
+    try file.readFields { fields in
+      // key = value
+      let key: String, value: String, column: Int
+      do throws(ParseError) {
+        (key, value, column) = try fields.assignment()
+      } catch var error {
+        error.file = file.string
+        logger.warning("invalid csshrc line: \(error, privacy: .public)")
         return
       }
-      let key = match.output.1
-      let value = match.output.2
       if (key == "extra_cluster_file") {
-        for extra in value.split(separator: /\s*,\s*/) {
-          try hosts.load(clustersFile: FilePath(String(extra)))
+        for extra in value.items(separatedBy: UInt8(ascii: ",")) {
+          hosts.load(clustersFile: FilePath(extra))
         }
       } else if (key == "clusters") {
         // Insert clusters into the clusters set.
-        clusters.formUnion(value.split(separator: /\s+/).map { String($0) })
+        clusters.formUnion(value.items())
       } else if (key == "hosts") {
         // load host file
-        for extra in value.split(separator: /\s*,\s*/) {
-          try hosts.load(hostFile: FilePath(String(extra)))
+        for extra in value.items(separatedBy: UInt8(ascii: ",")) {
+          try hosts.load(hostFile: FilePath(extra))
         }
       } else {
-        settings[String(key)] = String(value)
+        settings[key] = Entry(value: value, line: fields.number, keyColumn: fields.column(at: 0), valueColumn: column)
       }
     }
     
     for cluster in clusters {
       // For each cluster declared in the settings
-      guard let clusterHosts = settings[cluster]?.split(separator: /\s+/), !clusterHosts.isEmpty else {
+      guard let clusterHosts = settings[cluster]?.value.items(), !clusterHosts.isEmpty else {
         logger.warning("No hosts defined for cluster \(cluster, privacy: .public) in \(file, privacy: .public)")
         continue
       }
-      hosts.add(clusterHosts.map(String.init), to: cluster)
+      hosts.add(clusterHosts, to: cluster)
     }
     
-    for (key, value) in settings where !clusters.contains(key) {
-      try set(String(key), value: String(value))
+    for (key, entry) in settings where !clusters.contains(key) {
+      do {
+        try set(key, value: entry.value)
+      } catch {
+        guard Self.arguments[key] != nil else {
+          throw ParseError(file: file.string, line: entry.line, column: entry.keyColumn, reason: "unknown setting '\(key)'")
+        }
+        throw ParseError(file: file.string, line: entry.line, column: entry.valueColumn, reason: "invalid value for '\(key)': \(entry.value)")
+      }
     }
   }
 }
-
@@ -253,6 +253,30 @@ struct EscapeSequence: ExpressibleByStringArgument {
   }
 }
 
+extension HostConnection.OverflowPolicy: ExpressibleByStringArgument {
+  init?(argument: String) {
+    self.init(rawValue: argument)
+  }
+}
+
+extension Reachability.Method: ExpressibleByStringArgument {
+  init?(argument: String) {
+    self.init(rawValue: argument)
+  }
+}
+
+extension SessionBackendType: ExpressibleByStringArgument {
+  init?(argument: String) {
+    self.init(rawValue: argument)
+  }
+}
+
+extension HostCommand.Injection: ExpressibleByStringArgument {
+  init?(argument: String) {
+    self.init(rawValue: argument)
+  }
+}
+
 // MARK: - Settings
 struct Settings: Sendable {
 
@@ -260,6 +284,31 @@ struct Settings: Sendable {
   // Windows Layout
   var layout = WindowLayoutManager.Config()
   var hostWindow = HostWindow.Config()
+  // Per host output queue limits
+  var broadcast = HostConnection.Limits()
+  // Broadcast input batching during bursts
+  var coalescing = InputCoalescer.Options()
+  // File push chunking and flow control
+  var push = FilePush.Options()
+  // Hosts launch pipeline
+  var launch = LaunchScheduler.Options()
+  var sessionBackend: SessionBackendType = .terminal
+  // Output kept for each headless session, in bytes.
+  var sessionBufferSize: Int = 64 * 1024
+  // Count of relay processes the hosts are sharded across (headless sessions only). 0 to disable.
+  var relays: Int = 0
+  // Check host connections come from the session tty, in addition to the session token.
+  var verifyTTY: Bool = false
+  // Hosts send their ssh output to the controller, which groups hosts with identical output.
+  var capture: Bool = false
+  // Output kept for each host and command, to show the output variants, in bytes.
+  var captureSampleSize: Int = 16 * 1024
+  // Path of the file recording all input sent to the hosts.
+  var record: String? = nil
+  // Print the startup phases timings once all hosts are ready.
+  var traceStartup: Bool = false
+  // Interval between latency probes in milliseconds. 0 to disable probing.
+  var latencyProbeInterval: Int = 1000
   
   var actionKey: EscapeSequence = EscapeSequence(argument: "\\001")!
   
@@ -272,6 +321,11 @@ struct Settings: Sendable {
   // SSH
   var sshArgs: String? = nil
   var remoteCommand: String? = nil
+  // Pre-warm a ssh master connection per target, used by the hosts ssh (see SSHMasters).
+  var sshControlMaster: Bool = false
+  var sshControlMasterConcurrency: Int = 16
+  // Seconds idle masters are kept after the controller closed. 0 to stop them on close.
+  var sshControlPersist: Int = 0
   
   var login: String?
   
@@ -279,11 +333,17 @@ struct Settings: Sendable {
   var sessionMax = 256
   
   var pingTest: Bool = false
+  // Max number of hosts expanded before the ping test, which filters out the unreachable ones.
+  var pingTestMaxHosts = 2048
   var pingTimeout: Int = 2
+  var pingMode: Reachability.Method = .icmp
+  // Max number of concurrent DNS lookups and probes.
+  var pingConcurrency: Int = 64
   
   var socket: String? = nil
   
   var ssh: String = "ssh"
+  var injection: HostCommand.Injection = .pty
   var interleave: Int = 0
   
   var controllerWindowProfile: String? = nil
@@ -301,6 +361,9 @@ struct Settings: Sendable {
 
 
 extension Settings {
+  /// Max number of hosts the host list may expand to. With the ping test, the limit only applies to reachable hosts.
+  var expansionLimit: Int { pingTest ? max(sessionMax, pingTestMaxHosts) : sessionMax }
+  
   static let arguments : [String: Op] = [
     // Common settings
     "debug": .set(\Settings.debug),
@@ -337,10 +400,37 @@ extension Settings {
     "login": .set(\Settings.login),
     "ssh_args": .set(\Settings.sshArgs),
     "remote_command": .set(\Settings.remoteCommand),
+    "injection_mode": .set(\Settings.injection),
+    "ssh_control_master": .set(\Settings.sshControlMaster),
+    "ssh_control_master_concurrency": .set(\Settings.sshControlMasterConcurrency),
+    "ssh_control_persist": .set(\Settings.sshControlPersist),
     
     "session_max": .set(\Settings.sessionMax),
+    "launch_concurrency": .set(\Settings.launch.concurrency),
+    "launch_batch_size": .set(\Settings.launch.batchSize),
+    "launch_timeout": .set(\Settings.launch.timeout),
+    "session_backend": .set(\Settings.sessionBackend),
+    "session_buffer_size": .set(\Settings.sessionBufferSize),
+    "relays": .set(\Settings.relays),
+    "verify_tty": .set(\Settings.verifyTTY),
+    
+    // Broadcast
+    "broadcast_max_bytes": .set(\Settings.broadcast.maxBytes),
+    "broadcast_max_latency": .set(\Settings.broadcast.maxLatency),
+    "broadcast_overflow": .set(\Settings.broadcast.policy),
+    "input_coalescing_budget": .set(\Settings.coalescing.budget),
+    "input_coalescing_max_size": .set(\Settings.coalescing.maxSize),
+    "push_chunk_size": .set(\Settings.push.chunkSize),
+    "push_window": .set(\Settings.push.window),
+    "latency_probe_interval": .set(\Settings.latencyProbeInterval),
+    "record": .set(\Settings.record),
+    "capture_output": .set(\Settings.capture),
+    "capture_sample_size": .set(\Settings.captureSampleSize),
     "ping_test": .set(\Settings.pingTest),
+    "ping_test_max_hosts": .set(\Settings.pingTestMaxHosts),
     "ping_timeout": .set(\Settings.pingTimeout),
+    "ping_mode": .set(\Settings.pingMode),
+    "ping_concurrency": .set(\Settings.pingConcurrency),
     
     // Hosts loading
     "sorthosts": .set(\Settings.sortHosts),
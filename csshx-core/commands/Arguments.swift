@@ -107,6 +107,15 @@ struct SSHOptions: ParsableArguments {
                              """))
   var remoteCommand: String?
   
+  @Option(help: ArgumentHelp(discussion: """
+                             Sets how keyboard input is forwarded to the ssh sessions.
+                             
+                             'pty' (default) runs ssh on a pseudo terminal owned by csshX, and
+                             writes input in bulk. 'tiocsti' runs ssh directly in the Terminal
+                             window and pushes input one character at a time.
+                             """))
+  var injection: HostCommand.Injection?
+  
   @Option(help: ArgumentHelp(discussion: """
                              Set the maximum number of ssh Terminal sessions that can be opened
                              during a single csshX session. By default csshX will not open more
@@ -119,11 +128,12 @@ struct SSHOptions: ParsableArguments {
   var sessionMax: Int? = nil
   
   @Flag(name: [.long, .customLong("ping")],
-        help: ArgumentHelp("Make csshX ping each host/port before opening ssh connections",
+        help: ArgumentHelp("Make csshX ping each host before opening ssh connections",
                            discussion: """
                         To avoid opening connections to machines that are down, or not running
-                        sshd, this option will make csshX ping each host/port that is specified.
-                        This uses the Net::Ping module to perform a simple syn/ack check.
+                        sshd, this option will make csshX check each host before opening any
+                        window. Hosts that cannot be resolved or do not answer are reported and
+                        skipped.
                         
                         Use of this option is highly recommended when subnet ranges are used.
                         """))
@@ -132,24 +142,41 @@ struct SSHOptions: ParsableArguments {
   @Option(help: ArgumentHelp(discussion: """
                              This sets the timeout used when the "ping_test" feature is enabled.
                              
-                             Due to the implementation of Net::Ping syn/ack checks, this timeout
-                             applies once per destination port used. Also, if the number of hosts
-                             to ping is greater than the number of filehandles available pings
-                             will be batched, and the timeout will apply once per batch. You can
-                             set 'ulimit -n' to improve this performance.
+                             Hosts are probed concurrently, so this timeout applies once per
+                             batch of 'ping_concurrency' hosts (64 by default).
                              
                              The value is in seconds.
                              """))
   var pingTimeout: Int? = nil
   
+  @Option(help: ArgumentHelp(discussion: """
+                             Sets how hosts are checked when the "ping_test" feature is enabled.
+                             
+                             'icmp' (default) sends an echo request per host. 'tcp' connects to
+                             the ssh port of each host/port pair. The tcp mode is used when ICMP
+                             is not available.
+                             """))
+  var pingMode: Reachability.Method?
+  
+  @Flag(help: ArgumentHelp("Pre-warm a ssh master connection per host, shared by the host sessions.",
+                           discussion: """
+                           Masters are started in the background (ControlMaster) while the host windows
+                           are created, and the host ssh use them when they are ready, so re-adding a
+                           host does not require a new ssh handshake. Masters never prompt for a password.
+                           """))
+  var sshControlMaster = false
+  
   func override(_ settings: inout Settings) {
     if let login { settings.login = login }
     if let ssh { settings.ssh = ssh }
     if let sshArgs { settings.sshArgs = sshArgs }
     if let remoteCommand { settings.remoteCommand = remoteCommand }
+    if let injection { settings.injection = injection }
     if let sessionMax { settings.sessionMax = sessionMax }
     settings.pingTest = settings.pingTest || pingTest
     if let pingTimeout { settings.pingTimeout = pingTimeout }
+    if let pingMode { settings.pingMode = pingMode }
+    settings.sshControlMaster = settings.sshControlMaster || sshControlMaster
   }
 }
 
@@ -190,9 +217,54 @@ struct Config: ParsableArguments {
   
   @Flag(help: .private) var dummy: Bool = false
   
+  @Flag(help: ArgumentHelp("Run the hosts sessions without Terminal windows",
+                           discussion: """
+                           Each host runs on a pseudo terminal owned by the controller, which runs
+                           in the current terminal. The last output of each session can be shown
+                           by attaching to it from the action mode.
+                           """))
+  var headless: Bool = false
+  
+  @Option(help: ArgumentHelp("Shard the hosts across <relays> relay processes (with --headless).",
+                             discussion: """
+                             Each relay connects to the controller as a single host, and forwards
+                             the controller input to its own share of the hosts, so the fan-out
+                             cost is spread across several processes.
+                             """))
+  var relays: Int?
+  
+  @Option(help: ArgumentHelp("Record all input sent to the hosts into <file>.",
+                             discussion: """
+                             The recording keeps the time and target of each input, and can be
+                             replayed against dummy hosts with 'csshx -- replay <file>'.
+                             """),
+          completion: .file())
+  var record: String?
+  
+  @Flag(help: ArgumentHelp("Capture the hosts output, and group hosts with identical output.",
+                           discussion: """
+                           The output of each command is hashed per host, and the distinct outputs
+                           can be shown from the action mode, with the hosts producing them.
+                           """))
+  var capture: Bool = false
+  
+  @Flag(help: ArgumentHelp("Print the startup phases timings once all hosts are ready.",
+                           discussion: """
+                           The phases are: config parse, host expansion, socket bind, first window
+                           and all hosts ready, timed from the launcher start.
+                           """))
+  var traceStartup: Bool = false
+  
   func override(_ settings: inout Settings) {
     if let socket { settings.socket = socket }
     settings.debug = settings.debug || debug
     settings.dummy = settings.dummy || dummy
+    if headless { settings.sessionBackend = .headless }
+    if let relays { settings.relays = relays }
+    if let record { settings.record = record }
+    settings.capture = settings.capture || capture
+    settings.traceStartup = settings.traceStartup || traceStartup
   }
 }
+
+extension Reachability.Method: ExpressibleByArgument {}
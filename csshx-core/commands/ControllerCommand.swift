@@ -15,6 +15,9 @@ public struct ControllerCommand: ParsableCommand, Sendable {
   @Option var tabIdx: Int = 1
 
   @Option var launchpid: pid_t = 0
+  // Launcher start time (uptime ns), and shell used by Terminal, passed by the launcher.
+  @Option(help: .private) var launchTime: UInt64?
+  @Option(help: .private) var terminalShell: String?
 
   @OptionGroup(title:"Options")
   var options: Config
@@ -31,10 +34,21 @@ public struct ControllerCommand: ParsableCommand, Sendable {
   public init() {}
 
   public func run() throws {
+    var trace = StartupTrace()
+    if let launchTime, launchTime < trace.origin {
+      trace = StartupTrace(origin: launchTime)
+      trace.mark("launcher")
+    }
+    if let terminalShell {
+      Terminal.shell = terminalShell
+    }
+
     let (settings, hostList) = try Settings.load(hosts, options: options, sshOptions: sshOptions, layoutOptions: layoutOptions)
+    trace.mark("config parse")
 
     // TODO: should it be passed as parameter or send though the master socket instead ?
-    var hosts = try hostList.getHosts(limit: settings.pingTest ? 2048 : settings.sessionMax)
+    var hosts = try hostList.getHosts(limit: settings.expansionLimit)
+    trace.mark("host expansion")
 
     let socket = settings.socket ?? FileManager.default.temporaryDirectory.appendingPathComponent("csshx.\(UUID()).sock").path
 
@@ -44,21 +58,22 @@ public struct ControllerCommand: ParsableCommand, Sendable {
 
     var tab: Terminal.Tab? = nil
 
-    // Used in debug mode to launch the controller manually
-    if windowId == 0 {
-      var st = stat()
-      fstat(STDIN_FILENO, &st)
-      tab = try Terminal.Tab(tty: st.st_rdev)
-    } else if let windowId {
-      tab = try Terminal.Tab(window: windowId, tab: tabIdx)
+    // Headless sessions do not use Terminal windows at all.
+    if settings.sessionBackend == .terminal {
+      // Used in debug mode to launch the controller manually
+      if windowId == 0 {
+        var st = stat()
+        fstat(STDIN_FILENO, &st)
+        tab = try Terminal.Tab(tty: st.st_rdev)
+      } else if let windowId {
+        tab = try Terminal.Tab(window: windowId, tab: tabIdx)
+      }
     }
 
     let ctrl = try Controller(tab: tab, socket: socket, settings: settings)
     // Start listening socket
     try ctrl.listen()
-
-    // Start UI
-    try ctrl.runInputLoop()
+    trace.mark("socket bind")
 
     // Signal the launcher that the socket is ready
     if (launchpid > 0 && kill(launchpid, SIGUSR1) < 0) {
@@ -66,6 +81,22 @@ public struct ControllerCommand: ParsableCommand, Sendable {
       logger.warning("launcher signaling failed: \(err)")
     }
 
+    // Pre-flight check: skip unreachable hosts before creating their windows.
+    // Done before the input loop starts, so a failure leaves the terminal as it was.
+    if (settings.pingTest) {
+      do {
+        hosts = try Self.reachableHosts(hosts, settings: settings)
+      } catch {
+        // Remove the socket.
+        ctrl.close()
+        throw error
+      }
+      trace.mark("ping test")
+    }
+
+    // Start UI
+    try ctrl.runInputLoop()
+
     // Prepare host list
     if (settings.sortHosts) {
       hosts.sort { $0.hostname < $1.hostname }
@@ -86,19 +117,30 @@ public struct ControllerCommand: ParsableCommand, Sendable {
       hosts = new_hosts
     }
 
-    // Starting all host in //
+    // Starting all hosts through the launch pipeline
+    ctrl.trace = trace
     let group = DispatchGroup()
-    for host in hosts {
-      group.enter()
-      
-      do {
-        try ctrl.add(host: host) { error in
-          group.leave()
-        }
-      } catch {
+    let done = { (host: Target, error: (any Error)?) in
+      if let error {
         logger.error("error while starting host \(host.hostname, privacy: .public): \(error)")
-        group.leave()
       }
+      group.leave()
+    }
+    if settings.relays > 0, settings.sessionBackend == .headless {
+      // Each relay is a single host for the controller.
+      let shards = Relay.shard(hosts, count: settings.relays)
+      logger.info("sharding \(hosts.count) hosts across \(shards.count) relays")
+      if settings.capture {
+        logger.warning("relays do not forward the hosts output. output will not be captured")
+      }
+      shards.forEach { _ in group.enter() }
+      ctrl.add(relays: shards, whenDone: done)
+    } else {
+      if settings.relays > 0 {
+        logger.warning("relays require headless sessions. ignoring relays setting")
+      }
+      hosts.forEach { _ in group.enter() }
+      ctrl.add(hosts: hosts, whenDone: done)
     }
 
     group.notify(queue: .main) {
@@ -108,6 +150,12 @@ public struct ControllerCommand: ParsableCommand, Sendable {
       } catch {
         logger.error("ready failed with error: \(error)")
         ctrl.close()
+        return
+      }
+      if var trace = ctrl.trace {
+        trace.mark("all hosts ready")
+        ctrl.trace = nil
+        Self.print(trace, settings: settings)
       }
     }
 
@@ -117,4 +165,37 @@ public struct ControllerCommand: ParsableCommand, Sendable {
       CFRunLoopRun()
     }
   }
+
+  private static func print(_ trace: StartupTrace, settings: Settings) {
+    for line in trace.lines {
+      logger.info("startup: \(line, privacy: .public)")
+    }
+    guard settings.traceStartup else { return }
+    // The controller terminal is in raw mode.
+    fwrite(str: "Startup:\r\n" + trace.lines.map { "  \($0)\r\n" }.joined(), file: stdout)
+  }
+
+  private static func reachableHosts(_ hosts: [Target], settings: Settings) throws -> [Target] {
+    fwrite(str: "Checking \(hosts.count) host(s)…\r\n", file: stdout)
+    let checker = Reachability(options: Reachability.Options(method: settings.pingMode,
+                                                             timeout: settings.pingTimeout * 1000,
+                                                             concurrency: settings.pingConcurrency))
+    let statuses = checker.check(hosts)
+
+    var reachable = [Target]()
+    for (host, status) in zip(hosts, statuses) {
+      guard status == .reachable else {
+        logger.warning("skipping host \(host.connectionString, privacy: .public): \(status, privacy: .public)")
+        fwrite(str: "\(host.connectionString): \(status)\r\n", file: stdout)
+        continue
+      }
+      reachable.append(host)
+    }
+
+    guard reachable.count <= settings.sessionMax else {
+      logger.warning("too many reachable hosts: \(reachable.count) (max \(settings.sessionMax))")
+      throw POSIXError(.E2BIG)
+    }
+    return reachable
+  }
 }
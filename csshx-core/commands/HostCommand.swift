@@ -11,7 +11,15 @@ import ArgumentParser
 // Host does not try to read or parse settings file.
 // All values must be passed though launching options.
 public struct HostCommand: ParsableCommand, Sendable {
-  
+
+  // How controller input is forwarded to ssh.
+  enum Injection: String, CaseIterable, ExpressibleByArgument, Sendable {
+    // ssh runs on a pty owned by csshx-host, and input is written to the pty master in bulk.
+    case pty
+    // ssh runs on the Terminal tty, and input is pushed byte by byte using the TIOCSTI ioctl.
+    case tiocsti
+  }
+
   struct Options: ParsableArguments, Sendable {
     @Option var ssh: String
     @Option var socket: String
@@ -19,6 +27,14 @@ public struct HostCommand: ParsableCommand, Sendable {
     
     @Option var login: String? = nil
     @Option var port: UInt16? = nil
+
+    @Option var injection: Injection = .pty
+    // Session token, presented to the controller to identify this host.
+    @Option var token: String? = nil
+    // Send the ssh output to the controller (pty injection only).
+    @Flag var capture: Bool = false
+    // Control socket of the pre-warmed ssh master, used if ready.
+    @Option var controlPath: String? = nil
     
     // using opstTerminator and remaining is not supported, as postTerminator is
     // parsed after remaining, all always returns an empty array. Instead, try to detect terminator ourself
@@ -50,18 +66,33 @@ public struct HostCommand: ParsableCommand, Sendable {
       }
     }
 
+    var token = SessionToken.zero
+    if let value = options.token {
+      guard let parsed = SessionToken(value) else {
+        logger.warning("invalid session token: \(value, privacy: .public)")
+        throw POSIXError(.EINVAL)
+      }
+      token = parsed
+    }
+
     // First, connect to the socket (no need to try to launch ssh if connection fails)
     logger.debug("trying to connect socket at path: \(options.socket)")
-    let client = try SSHWrapper(socket: options.socket)
+    let client = try SSHWrapper(socket: options.socket, dummy: dummy, capture: options.capture)
+    client.send(.hello(version: Wire.version, pid: getpid(), token: token))
 
     // Then starts SSH
     if !dummy {
       // controller had time to retreive the pid/tty and match it to the requested host.
       try client.start(options: options)
+      client.send(.status(pid: client.pid, exitCode: nil))
     } else {
       print("hostname: \(options.hostname)")
     }
     
+    if let size = PseudoTerminal.windowSize(of: STDIN_FILENO) {
+      client.send(.resize(rows: size.ws_row, columns: size.ws_col))
+    }
+    
     // Simple timeout
     DispatchQueue.main.asyncAfterUnsafe(deadline: .now() + .seconds(5)) {
       // If handshake still not done -> close the connection.
@@ -71,39 +102,16 @@ public struct HostCommand: ParsableCommand, Sendable {
       }
     }
     
-    // Start listening for incoming data from master
+    // Start listening for incoming frames from master
+    var decoder = FrameDecoder()
     client.connection.read { data in
-      for c in data {
-        if !client.isReady {
-          // Handshake done -> mark the client ready,
-          // close the connection if ssh already failed or if handshake data is not valid (0).
-          if c == 0 && (client.pid > 0 || dummy) {
-            logger.warning("client ready")
-            client.isReady = true
-          } else {
-            if c != 0 {
-              logger.warning("invalid handshake byte")
-            } else {
-              logger.warning("ssh died already. terminating")
-            }
-            client.close()
-            return
-          }
-          continue
-        }
-        
-        withUnsafePointer(to: c) { ptr in
-          do {
-            if !dummy {
-              try Termios.tiocsti(c)
-            } else {
-              // noop
-            }
-          } catch {
-            logger.error("tiocsti failed with error: \(error, privacy: .public)")
-            client.close()
-          }
+      do {
+        try decoder.decode(data) { frame in
+          try client.process(frame)
         }
+      } catch {
+        logger.error("failed to process controller input: \(error, privacy: .public)")
+        client.close()
       }
     } whenDone: { error in
       if let error {
@@ -115,13 +123,17 @@ public struct HostCommand: ParsableCommand, Sendable {
     
     if !dummy {
       // If ssh exit, terminating
-      waitFor(pid: client.pid, queue: DispatchQueue.main) { result in
+      let pid = client.pid
+      waitFor(pid: pid, queue: DispatchQueue.main) { result in
         if result != 0 {
           logger.info("ssh exit with status \(result)")
         } else {
           logger.info("ssh exit")
         }
-        client.close(onlyIfReady: true)
+        // Report the exit status before closing the connection.
+        client.send(.status(pid: pid, exitCode: Int32(truncatingIfNeeded: result))) {
+          client.close(onlyIfReady: true)
+        }
       }
     }
     
@@ -135,9 +147,26 @@ private class SSHWrapper {
   
   var isReady: Bool = false
   
+  let dummy: Bool
+  // Output capture: the ssh output is also sent to the controller. Dummy hosts echo their input instead.
+  let capture: Bool
   let connection: DispatchIO
   
-  init(socket: String) throws {
+  // Pongs waiting for the pty writes queued before the matching ping to complete.
+  private var pendingWrites = 0
+  private var pendingPongs: [Frame] = []
+
+  // pty mode only: ssh pty, and channels relaying it to the Terminal window.
+  private var terminal: PseudoTerminal? = nil
+  private var channel: DispatchIO? = nil
+  private var input: DispatchIO? = nil
+  private var output: DispatchIO? = nil
+  private var winch: (any DispatchSourceSignal)? = nil
+  private var term: termios? = nil
+  
+  init(socket: String, dummy: Bool, capture: Bool) throws {
+    self.dummy = dummy
+    self.capture = capture
     let fd = try Socket.connect(socket)
     self.connection = DispatchIO(type: .stream,
                                  fileDescriptor: fd,
@@ -158,6 +187,15 @@ private class SSHWrapper {
       waitpid(pid, nil, 0)
       pid = 0
     }
+    if let term {
+      // restoring tty state
+      try? stty.set(attr: term)
+      self.term = nil
+    }
+    winch?.cancel()
+    winch = nil
+    input?.close(flags: .stop)
+    channel?.close(flags: .stop)
     if isReady || !onlyIfReady {
       // Terminate master connection
       connection.close(flags: .stop)
@@ -175,11 +213,27 @@ private class SSHWrapper {
       args.append("-p")
       args.append(String(port))
     }
+    if let controlPath = options.controlPath {
+      // Never start a master: connect directly if the pre-warmed master is not ready.
+      args.append(contentsOf: ["-o", "ControlPath=\(controlPath)", "-o", "ControlMaster=no"])
+    }
     args.append(contentsOf: options.sshArgs)
     args.append(options.hostname)
     
     args.append(contentsOf: options.remoteCommand)
 
+    if options.injection == .pty {
+      do {
+        try spawn(pty: args)
+        return
+      } catch {
+        logger.warning("failed to start ssh on a pty, falling back to tiocsti: \(error, privacy: .public)")
+      }
+    }
+    if capture {
+      logger.warning("output capture requires pty injection. output will not be captured")
+    }
+
     // Note: Do not use Process for 2 reasons:
     // - Process does many things under the hood, and end-up freezing the process in a call to tcsetattr().
     // - Process does not support looking for the target process in the PATH, which is something we want to be
@@ -199,4 +253,160 @@ private class SSHWrapper {
     fclose(stdout)
     fclose(stderr)
   }
+  
+  private func spawn(pty args: [String]) throws {
+    let pty = try PseudoTerminal.open()
+    // Make sure ssh sees the Terminal window size on startup.
+    pty.windowSize = PseudoTerminal.windowSize(of: STDIN_FILENO)
+    
+    do {
+      pid = try Termios.spawn(args, tty: pty.slave)
+    } catch {
+      pty.close()
+      throw error
+    }
+    terminal = pty
+    
+    // The Terminal window is now just a view on the ssh pty.
+    // Switch it to raw mode, so the pty line discipline is the only one processing user input.
+    term = try? stty.raw()
+    
+    let channel = DispatchIO(type: .stream,
+                             fileDescriptor: pty.master,
+                             queue: DispatchQueue.main,
+                             cleanupHandler: { error in pty.close() })
+    channel.setLimit(lowWater: 1)
+    self.channel = channel
+    
+    // ssh output -> Terminal window
+    let output = DispatchIO(type: .stream,
+                            fileDescriptor: STDOUT_FILENO,
+                            queue: DispatchQueue.main,
+                            cleanupHandler: { error in })
+    self.output = output
+    channel.read { [self] data in
+      output.write(data) { error in }
+      if capture {
+        send(output: data)
+      }
+    } whenDone: { error in
+      // ssh exit is handled by the process monitor.
+    }
+    
+    // User typing directly in the host window -> ssh
+    let input = DispatchIO(type: .stream,
+                           fileDescriptor: STDIN_FILENO,
+                           queue: DispatchQueue.main,
+                           cleanupHandler: { error in })
+    input.setLimit(lowWater: 1)
+    self.input = input
+    input.read { data in
+      channel.write(data) { error in }
+    } whenDone: { error in }
+    
+    // Forward Terminal window resizing to the ssh pty.
+    let winch = DispatchSource.makeSignalSource(signal: SIGWINCH, queue: DispatchQueue.main)
+    winch.setEventHandler {
+      pty.windowSize = PseudoTerminal.windowSize(of: STDIN_FILENO)
+    }
+    winch.activate()
+    self.winch = winch
+  }
+  
+  func send(_ frame: Frame, whenDone: (() -> Void)? = nil) {
+    connection.write(frame.data()) { error in
+      whenDone?()
+    }
+  }
+  
+  private func send(output data: DispatchData) {
+    for region in data.regions {
+      region.withUnsafeBytes { (ptr: UnsafePointer<UInt8>) in
+        send(output: UnsafeRawBufferPointer(start: ptr, count: region.count))
+      }
+    }
+  }
+  
+  private func send(output bytes: UnsafeRawBufferPointer) {
+    var offset = 0
+    while offset < bytes.count {
+      let chunk = UnsafeRawBufferPointer(rebasing: bytes[offset..<min(bytes.count, offset + Wire.maxPayloadSize)])
+      send(.output(chunk))
+      offset += chunk.count
+    }
+  }
+  
+  func process(_ frame: Frame) throws {
+    switch frame {
+      case .hello(let version, _, _):
+        // Handshake done -> mark the client ready,
+        // close the connection if ssh already failed or if the controller protocol is not supported.
+        guard version == Wire.version else {
+          throw WireError.unsupportedVersion(version)
+        }
+        guard pid > 0 || dummy else {
+          logger.warning("ssh died already. terminating")
+          close()
+          return
+        }
+        logger.warning("client ready")
+        isReady = true
+        
+      case .input(let bytes):
+        guard isReady else {
+          throw WireError.invalidPayload(.input)
+        }
+        if dummy {
+          if capture {
+            send(output: bytes)
+          }
+          send(.credit(UInt32(bytes.count)))
+        } else {
+          try inject(bytes)
+        }
+        
+      case .resize(let rows, let columns):
+        terminal?.windowSize = winsize(ws_row: rows, ws_col: columns, ws_xpixel: 0, ws_ypixel: 0)
+        
+      case .ping(let id, let timestamp):
+        // Reply once all input received before the ping is injected.
+        let pong = Frame.pong(id: id, timestamp: timestamp, received: DispatchTime.now().uptimeNanoseconds)
+        if pendingWrites > 0 {
+          pendingPongs.append(pong)
+        } else {
+          send(pong)
+        }
+        
+      case .pong, .status, .credit, .relayStats, .output, .resume:
+        logger.warning("discarding unexpected frame: \(frame.type.rawValue)")
+    }
+  }
+  
+  private func inject(_ bytes: UnsafeRawBufferPointer) throws {
+    if let channel {
+      // pty mode: the whole chunk is written into the master at once.
+      // The frame payload is only valid while decoding, so it must be copied.
+      let count = bytes.count
+      pendingWrites += 1
+      channel.write(DispatchData(bytes: bytes)) { [self] error in
+        pendingWrites -= 1
+        if let error {
+          logger.error("pty write failed with error: \(error, privacy: .public)")
+          close()
+          return
+        }
+        send(.credit(UInt32(count)))
+        if pendingWrites == 0 {
+          pendingPongs.forEach { send($0) }
+          pendingPongs.removeAll()
+        }
+      }
+      return
+    }
+    
+    if let base = bytes.baseAddress, !bytes.isEmpty {
+      try Termios.tiocsti(base.assumingMemoryBound(to: UInt8.self), length: bytes.count)
+    }
+    send(.credit(UInt32(bytes.count)))
+  }
 }
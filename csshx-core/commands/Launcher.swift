@@ -44,16 +44,28 @@ public struct Launcher: ParsableCommand, Sendable {
   
   public mutating func run() throws {
     logger.info("start launcher")
+    let start = DispatchTime.now().uptimeNanoseconds
     
     let (settings, hostList) = try Settings.load(hosts, options: options, sshOptions: sshOptions, layoutOptions: layoutOptions)
     
-    // resolve host list to make sure it is valid, or failing before launching the master.
-    let _ = try hostList.getHosts(limit: settings.pingTest ? 2048 : settings.sessionMax)
+    // validate the host list, or fail before launching the master. Counting does not need to expand the hosts.
+    let _ = try hostList.count(limit: settings.expansionLimit)
     
-    if (settings.pingTest) {
-      // TODO: ping test support.
-      // ICMP mode: Use SimplePing class to check reachability per host.
-      // TCP mode: Use Network Framework to perform a TCP connect/close per host/port.
+    // Note: the ping test is performed by the controller, which expands the host list,
+    // before any host window is created.
+    
+    if settings.sessionBackend == .headless {
+      // No Terminal window at all: the controller replaces the launcher in the current terminal.
+      let csshx = CommandLine.executableURL()
+      var args = [csshx.path, "--", "controller"]
+      if settings.traceStartup {
+        args.append(contentsOf: ["--launch-time", "\(start)"])
+      }
+      args.append(contentsOf: CommandLine.arguments.dropFirst())
+      _ = args.withCStrings { argv in
+        execv(csshx.path, argv)
+      }
+      throw POSIXError.errno
     }
     
     let tab = try Terminal.Tab.open()
@@ -86,8 +98,13 @@ public struct Launcher: ParsableCommand, Sendable {
       csshx.path, "--", "controller",
       "--launchpid", "\(getpid())",
       "--window-id", "\(tab.windowId)",
-      "--tab-idx", "\(tab.tabIdx)"
+      "--tab-idx", "\(tab.tabIdx)",
+      // The launcher reads Terminal preferences to run the controller: do not read them again in the controller.
+      "--terminal-shell", Terminal.shell
     ]
+    if settings.traceStartup {
+      args.append(contentsOf: ["--launch-time", "\(start)"])
+    }
     // Do not exec in debug mode
     if settings.debug {
       args.remove(at: 2)
@@ -102,8 +119,6 @@ public struct Launcher: ParsableCommand, Sendable {
     logger.debug("waiting master")
     
     // Once master is ready, we are done.
-    // TODO: if implementing ping test, maybe it should be done by the launcher
-    //   and result forwarded to the master though the master socket.
     dispatchMain()
   }
 }
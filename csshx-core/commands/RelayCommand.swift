@@ -0,0 +1,95 @@
+//
+//  RelayCommand.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+import ArgumentParser
+
+// Relay does not try to read or parse settings file.
+// All values must be passed though launching options (see Controller.relayScript()).
+public struct RelayCommand: ParsableCommand, Sendable {
+
+  public static let configuration = CommandConfiguration(
+    commandName: "relay",
+    abstract: "Forward a controller input to a shard of its hosts.")
+
+  @Option var socket: String
+  // Session token, presented to the controller to identify this relay.
+  @Option var token: String
+
+  @Option var ssh: String = "ssh"
+  @Option var injection: HostCommand.Injection = .pty
+  // Passed as is to the hosts command line, and parsed by the session shell.
+  @Option var sshArgs: String? = nil
+  @Option var remoteCommand: String? = nil
+  @Option var sshControlMasterConcurrency: Int? = nil
+  @Option var sshControlPersist: Int = 0
+
+  @Option var probeInterval: Int = 1000
+  @Option var launchTimeout: Int = 5000
+  @Option var sessionBufferSize: Int = 64 * 1024
+
+  @Flag(help: .private) var dummy: Bool = false
+
+  @Argument(help: "The hosts to connect.")
+  var hosts: [String] = []
+
+  public init() {}
+
+  public func run() throws {
+    guard let token = SessionToken(token) else {
+      logger.warning("invalid session token: \(token, privacy: .public)")
+      throw POSIXError(.EINVAL)
+    }
+
+    let targets = try hosts.map { host in
+      let (user, hostname, port) = try host.parseUserHostPort()
+      guard let port else {
+        return Target(user: user, hostname: hostname, port: nil, command: nil)
+      }
+      guard let value = UInt16(port) else { throw POSIXError(.EINVAL) }
+      return Target(user: user, hostname: hostname, port: value, command: nil)
+    }
+
+    var settings = Settings()
+    settings.dummy = dummy
+    settings.ssh = ssh
+    settings.injection = injection
+    settings.sshArgs = sshArgs
+    settings.remoteCommand = remoteCommand
+    if let sshControlMasterConcurrency {
+      settings.sshControlMaster = true
+      settings.sshControlMasterConcurrency = sshControlMasterConcurrency
+      settings.sshControlPersist = sshControlPersist
+    }
+    settings.sessionBackend = .headless
+    // A relay has no UI to re-enable its hosts: lagging hosts are resumed by the controller (see `Relay`).
+    settings.broadcast.policy = .lag
+    settings.sessionBufferSize = sessionBufferSize
+    settings.sessionMax = max(settings.sessionMax, targets.count)
+    settings.latencyProbeInterval = probeInterval
+    settings.launch.timeout = launchTimeout
+    // Recording is done by the controller.
+    settings.record = nil
+
+    signal(SIGPIPE, SIG_IGN)
+
+    // First, connect to the socket (no need to try to launch hosts if connection fails)
+    logger.debug("trying to connect socket at path: \(socket)")
+    let relay = try Relay(socket: socket, settings: settings)
+    try relay.start(targets, token: token)
+
+    // Session hang up: terminate the hosts before exiting.
+    signal(SIGHUP, SIG_IGN)
+    let hangup = DispatchSource.makeSignalSource(signal: SIGHUP, queue: .main)
+    hangup.setEventHandler {
+      relay.close()
+    }
+    hangup.activate()
+
+    dispatchMain()
+  }
+}
@@ -0,0 +1,299 @@
+//
+//  ReplayCommand.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+import ArgumentParser
+
+/// Replay a session recording through a controller into dummy hosts, and report the fan-out performance.
+///
+/// Hosts are headless `--dummy` csshx-host processes, connected to the controller socket as usual, so the whole
+/// controller → host path is exercised, without ssh. With `--relays`, the hosts are sharded across relay processes,
+/// and the throughput is reported for each level of the fan-out tree.
+public struct ReplayCommand: ParsableCommand, Sendable {
+
+  public static let configuration = CommandConfiguration(
+    commandName: "replay",
+    abstract: "Replay a session recording (see --record) against dummy hosts.")
+
+  @Argument(help: "The recording to replay.", completion: .file())
+  var recording: String
+
+  @Option(help: "Count of dummy hosts to start.")
+  var hosts: Int = 16
+
+  @Option(help: "Count of relays the hosts are sharded across (0 to connect the hosts to the controller).")
+  var relays: Int = 0
+
+  @Flag(help: "Replay as fast as possible, instead of at the recording speed.")
+  var fast: Bool = false
+
+  @Option(help: "Interval between latency probes in milliseconds.")
+  var probeInterval: Int = 10
+
+  @Flag(help: "Print the report as JSON.")
+  var json: Bool = false
+
+  public init() {}
+
+  public func run() throws {
+    guard hosts > 0 else { throw ValidationError("hosts must be greater than 0") }
+    guard relays >= 0 else { throw ValidationError("relays must not be negative") }
+    // Relays report their statistics with the probes answers.
+    guard relays == 0 || probeInterval > 0 else { throw ValidationError("relays require latency probes") }
+
+    let recording = try Recording(contentsOf: recording)
+
+    var settings = Settings()
+    settings.dummy = true
+    settings.sessionBackend = .headless
+    settings.sessionMax = max(settings.sessionMax, hosts)
+    settings.latencyProbeInterval = probeInterval
+    // Do not record the replay itself.
+    settings.record = nil
+
+    signal(SIGPIPE, SIG_IGN)
+
+    let socket = FileManager.default.temporaryDirectory.appendingPathComponent("csshx.\(UUID()).sock").path
+    let ctrl = try Controller(tab: nil, socket: socket, settings: settings)
+    try ctrl.listen()
+
+    let targets = (1...hosts).map { Target(user: nil, hostname: "replay-\($0)", port: nil, command: nil) }
+    let group = DispatchGroup()
+    let done = { (host: Target, error: (any Error)?) in
+      if let error {
+        logger.error("error while starting host \(host.hostname, privacy: .public): \(error)")
+      }
+      group.leave()
+    }
+    if relays > 0 {
+      let shards = Relay.shard(targets, count: relays)
+      shards.forEach { _ in group.enter() }
+      ctrl.add(relays: shards, whenDone: done)
+    } else {
+      targets.forEach { _ in group.enter() }
+      ctrl.add(hosts: targets, whenDone: done)
+    }
+
+    let fast = fast, json = json
+    group.notify(queue: .main) {
+      guard !ctrl.hosts.isEmpty else {
+        fwrite(str: "no host started\n", file: stderr)
+        Foundation.exit(1)
+      }
+      ctrl.startProbing()
+      let player = ReplayPlayer(ctrl: ctrl, recording: recording, fast: fast)
+      player.start { report in
+        ctrl.close()
+        unlink(socket)
+        if json {
+          let encoder = JSONEncoder()
+          encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+          encoder.keyEncodingStrategy = .convertToSnakeCase
+          if let data = try? encoder.encode(report) {
+            FileHandle.standardOutput.write(data)
+            fwrite(str: "\n", file: stdout)
+          }
+        } else {
+          fwrite(str: report.description, file: stdout)
+        }
+        Foundation.exit(0)
+      }
+    }
+
+    dispatchMain()
+  }
+}
+
+// MARK: - Player
+private final class ReplayPlayer {
+
+  // relays → hosts level of the fan-out, from the statistics reported by the relays.
+  struct RelayLevel: Encodable {
+    let relays: Int
+    let hosts: Int
+    let forwardedBytes: UInt64
+    let droppedBytes: UInt64
+    // Bytes delivered to all relay hosts per second.
+    let fanoutThroughput: Double
+    // Relay hosts latency (µs). p50 is the median of the relays p50, p99 the worst relay p99.
+    let latencyP50: Double
+    let latencyP99: Double
+  }
+
+  struct Report: Encodable, CustomStringConvertible {
+    // Hosts connected to the controller (relays, if any).
+    let hosts: Int
+    // Replay duration, until all hosts acknowledged all input (ms).
+    let duration: Double
+    let inputBytes: Int
+    let forwardedBytes: UInt64
+    let droppedBytes: UInt64
+    // Input bytes per second.
+    let throughput: Double
+    // Bytes delivered to all hosts per second.
+    let fanoutThroughput: Double
+    let latency: LatencyReport.Summary
+    let latencyP999: Double
+    // Peak resident memory (bytes).
+    let maxResidentSize: Int
+    let relay: RelayLevel?
+
+    var description: String {
+      func mb(_ value: Double) -> String { String(format: "%.2f MB", value / 1_000_000) }
+      var str = """
+        hosts: \(hosts), duration: \(String(format: "%.1f", duration)) ms
+        input: \(inputBytes) bytes, \(mb(throughput))/s
+        fan-out: \(forwardedBytes) bytes, \(mb(fanoutThroughput))/s, dropped: \(droppedBytes) bytes
+        latency (µs): p50 \(latency.p50), p99 \(latency.p99), p99.9 \(latencyP999), max \(latency.max) (\(latency.count) probes)
+
+        """
+      if let relay {
+        str += """
+          relays → hosts: \(relay.relays) relays, \(relay.hosts) hosts
+          relays fan-out: \(relay.forwardedBytes) bytes, \(mb(relay.fanoutThroughput))/s, dropped: \(relay.droppedBytes) bytes
+          relays latency (µs): p50 \(relay.latencyP50), p99 \(relay.latencyP99)
+
+          """
+      }
+      str += "max resident size: \(mb(Double(maxResidentSize)))\n"
+      return str
+    }
+  }
+
+  private let ctrl: Controller
+  private let recording: Recording
+  private let fast: Bool
+
+  private var next = 0
+  // Recorded broadcast targets currently enabled.
+  private var targets: [Int]? = nil
+  private var start = DispatchTime.now()
+  private var completion: ((Report) -> Void)? = nil
+
+  // Entries sent per main loop turn in fast mode, so host credits and probes are still processed.
+  private static let batchSize = 64
+  // Time to wait for the hosts to drain their queues.
+  private static let drainTimeout: UInt64 = 30 * NSEC_PER_SEC
+
+  init(ctrl: Controller, recording: Recording, fast: Bool) {
+    self.ctrl = ctrl
+    self.recording = recording
+    self.fast = fast
+  }
+
+  func start(completion: @escaping (Report) -> Void) {
+    self.completion = completion
+    ctrl.resetStatistics()
+    start = DispatchTime.now()
+    step()
+  }
+
+  private func step() {
+    let elapsed = DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds
+    var sent = 0
+    while next < recording.entries.count {
+      let entry = recording.entries[next]
+      if fast {
+        guard sent < Self.batchSize else { break }
+      } else if entry.time > elapsed {
+        // Wait for the next entry
+        DispatchQueue.main.asyncAfterUnsafe(deadline: start + .nanoseconds(Int(entry.time))) { [self] in step() }
+        return
+      }
+      send(entry)
+      next += 1
+      sent += 1
+    }
+
+    if next < recording.entries.count {
+      DispatchQueue.main.asyncUnsafe { [self] in step() }
+    } else {
+      // Do not wait for the coalescing deadline.
+      ctrl.flushInput()
+      drain()
+    }
+  }
+
+  private func send(_ entry: Recording.Entry) {
+    // Recorded hosts are mapped on the dummy hosts in order of appearance.
+    guard let host = entry.host else {
+      // Only the hosts which received the input are enabled (all of them for recordings without targets).
+      if entry.targets != targets {
+        targets = entry.targets
+        let enabled = targets.map { Set($0.map { $0 % ctrl.hosts.count }) }
+        ctrl.enable(hosts: Set(ctrl.hosts.indices.filter { enabled?.contains($0) ?? true }.map { ctrl.hosts[$0].id }))
+      }
+      ctrl.send(bytes: entry.bytes)
+      return
+    }
+    ctrl.send(bytes: entry.bytes, to: ctrl.hosts[host % ctrl.hosts.count])
+  }
+
+  private func drain() {
+    let pending = ctrl.hosts.contains { host in
+      guard let connection = host.connection else { return false }
+      // Relays acknowledge input on receipt: wait for their own hosts to acknowledge it.
+      if let stats = host.relayStats {
+        return connection.queueDepth > 0 || stats.received < connection.bytesForwarded || stats.queued > 0
+      }
+      return connection.queueDepth > 0
+    }
+    let elapsed = DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds
+    guard !pending || elapsed > recording.duration + Self.drainTimeout else {
+      DispatchQueue.main.asyncAfterUnsafe(deadline: .now() + .milliseconds(1)) { [self] in drain() }
+      return
+    }
+    if pending {
+      logger.warning("replay: some hosts did not acknowledge all input")
+    }
+    completion?(report(duration: elapsed))
+    completion = nil
+  }
+
+  private func report(duration: UInt64) -> Report {
+    let seconds = Double(max(1, duration)) / Double(NSEC_PER_SEC)
+    var latency = Histogram()
+    var forwarded: UInt64 = 0
+    var dropped: UInt64 = 0
+    for host in ctrl.hosts {
+      guard let connection = host.connection else { continue }
+      latency.merge(connection.latency)
+      forwarded += connection.bytesForwarded
+      dropped += connection.bytesDropped
+    }
+
+    var relay: RelayLevel? = nil
+    let relays = ctrl.hosts.compactMap(\.relayStats)
+    if !relays.isEmpty {
+      let p50 = relays.map(\.latencyP50).sorted()
+      relay = RelayLevel(relays: relays.count,
+                         hosts: relays.reduce(0) { $0 + Int($1.hosts) },
+                         forwardedBytes: relays.reduce(0) { $0 + $1.forwarded },
+                         droppedBytes: relays.reduce(0) { $0 + $1.dropped },
+                         fanoutThroughput: Double(relays.reduce(0) { $0 + $1.forwarded }) / seconds,
+                         latencyP50: Double(p50[p50.count / 2]) / 1000,
+                         latencyP99: Double(relays.map(\.latencyP99).max() ?? 0) / 1000)
+    }
+
+    var usage = rusage()
+    getrusage(RUSAGE_SELF, &usage)
+
+    let input = recording.byteCount
+    return Report(hosts: ctrl.hosts.count,
+                  duration: Double(duration) / Double(NSEC_PER_MSEC),
+                  inputBytes: input,
+                  forwardedBytes: forwarded,
+                  droppedBytes: dropped,
+                  throughput: Double(input) / seconds,
+                  fanoutThroughput: Double(forwarded) / seconds,
+                  latency: LatencyReport.Summary(latency),
+                  latencyP999: Double(latency.percentile(99.9)) / 1000,
+                  // bytes on macOS
+                  maxResidentSize: usage.ru_maxrss,
+                  relay: relay)
+  }
+}
@@ -11,6 +11,10 @@ import Foundation
 //private let kk = "\u{001b}[0m"              // Reset
 
 // MARK: -
+/// The controller state is confined to the main queue, except for the broadcast data path (stdin in input mode,
+/// input batching and recording, host sockets), which runs on `ioQueue`, so main queue stalls (Terminal scripting,
+/// window layout…) do not delay the input. The state used by the data path is marked [io], and only accessed on
+/// `ioQueue`: the main queue hands work to it asynchronously, or waits for it (see `flushInput()`).
 class Controller {
   
   let tab: Terminal.Tab?
@@ -21,36 +25,135 @@ class Controller {
   private var term: termios? = nil
   
   var hosts: [HostWindow] = []
+  private var hostsById = [HostWindow.ID: HostWindow]()
   var windowManager: WindowLayoutManager
   
   private var inputMode: any InputModeProtocol = InputMode.Starting()
   
-  private var buffer: [UInt8] = []
+  private var buffer = InputBuffer()
   private var stdin: DispatchIO? = nil
   
+  // Data path queue.
+  let ioQueue = DispatchQueue(label: "com.xenonium.csshx.io", qos: .userInteractive)
+  // [io] Broadcast input bursts are written in batches (see InputCoalescer).
+  private let coalescer: InputCoalescer
+  private var coalescerTimer: DispatchSourceTimer? = nil
+  private var coalescerDeadline: UInt64? = nil
+  // [io] Connections of the enabled hosts, published by the main queue each time they may have changed.
+  private var ioConnections = [HostConnection]()
+  // [io] stdin is forwarded without going through the main queue while in input mode, up to the action key.
+  private var ioForwarding = false
+  // stdin chunks passed to the main queue [io], and processed by it [main]. Forwarding is only resumed
+  // once the main queue caught up, so stdin is never reordered.
+  private var ioPosted: UInt64 = 0
+  private var mainProcessed: UInt64 = 0
+  
   fileprivate var listener: IOListener? = nil
+  // Called once, when the controller is closed.
+  var onClose: (() -> Void)? = nil
+  // Called on main when hosts queues may have drained: a host acknowledged input, or was removed.
+  var onDrain: (() -> Void)? = nil
+  // Startup phases, marked as the controller starts.
+  var trace: StartupTrace? = nil
+  // [io] Records everything sent to the hosts.
+  private let recorder: SessionRecorder?
+  // Hosts output, grouped per command (only if output capture is enabled).
+  let capture: OutputCapture<HostWindow.ID>?
+  // [io] Command line being typed, used to label the captured output.
+  private var captureLine = [UInt8]()
+  // Pre-warmed ssh masters (only if enabled).
+  private let masters: SSHMasters?
+  // File being pushed to the hosts.
+  private(set) var filePush: FilePush? = nil
+  // Last push progress shown (percent).
+  private var filePushProgress = -1
+  
+  // Latency probes
+  private var probeTimer: DispatchSourceTimer? = nil
+  private var probeId: UInt32 = 0
+  // Delay between the probe timer deadline and its handler actually running on the main queue (ns).
+  // This is the delay added by main queue stalls to the control modes, and to the input typed right after them.
+  private(set) var mainQueueDelay = Histogram()
+  var inputStatistics: InputCoalescer.Statistics { ioQueue.sync { coalescer.statistics } }
+  // Broadcast input not written yet.
+  var pendingInput: Int { ioQueue.sync { coalescer.pendingCount } }
+  
+  // Hosts launch
+  let backend: any SessionBackend
+  private struct Launch {
+    let target: Target
+    // Hosts served by a relay (see `Relay`). Empty for a host launch.
+    let shard: [Target]
+    let done: ((any Error)?) -> Void
+    var host: HostWindow? = nil
+  }
+  let launcher: LaunchScheduler
+  private var launches = [LaunchScheduler.ID: Launch]()
+  private var launchId: LaunchScheduler.ID = 0
+  // Single timer driving all launch deadlines. Only active while launching.
+  private var launchTimer: DispatchSourceTimer? = nil
+  // Hosts waiting for their connection, by session token.
+  private var sessions = PendingSessions<HostWindow>()
   
   init(tab: Terminal.Tab?, socket: String, settings: Settings) throws {
     self.tab = tab
     self.socket = socket
     self.settings = settings
-    buffer.reserveCapacity(256)
     
     windowManager = WindowLayoutManager(config: settings.layout)
+    recorder = try settings.record.map { try SessionRecorder(path: $0) }
+    capture = settings.capture ? OutputCapture(sampleSize: settings.captureSampleSize) : nil
+    // Dummy hosts do not run ssh.
+    masters = settings.sshControlMaster && !settings.dummy ? SSHMasters(options: SSHMasters.Options(
+      ssh: settings.ssh, sshArgs: settings.sshArgs,
+      concurrency: settings.sshControlMasterConcurrency, persist: settings.sshControlPersist)) : nil
+    launcher = LaunchScheduler(options: settings.launch)
+    coalescer = InputCoalescer(options: settings.coalescing)
+    switch settings.sessionBackend {
+      case .terminal: backend = TerminalBackend(settings: settings)
+      case .headless: backend = HeadlessBackend(settings: settings)
+    }
     
     setControllerColors()
     layout()
+    
+    coalescer.output = { [self] bytes in broadcast(bytes) }
+    launcher.spawn = { [self] id in try spawn(launch: id) }
+    launcher.completion = { [self] id, error in didLaunch(id, error: error) }
+    launcher.onIdle = { [self] in
+      launchTimer?.cancel()
+      launchTimer = nil
+      let total = launcher.timings.total
+      logger.info("launch pipeline idle: \(total.count) hosts ready (p50: \(total.percentile(50) / NSEC_PER_MSEC)ms, p99: \(total.percentile(99) / NSEC_PER_MSEC)ms)")
+    }
   }
   
   func close() {
+    let onClose = self.onClose
+    self.onClose = nil
+    ioQueue.sync {
+      coalescer.flush()
+      coalescerTimer?.cancel()
+      coalescerTimer = nil
+      ioConnections.removeAll()
+      ioForwarding = false
+      recorder?.close()
+    }
+    masters?.close()
+    probeTimer?.cancel()
+    probeTimer = nil
+    launchTimer?.cancel()
+    launchTimer = nil
     stdin?.close(flags: .stop)
     listener?.close()
     hosts.forEach { $0.terminate() }
+    onClose?()
   }
   
   // MARK: - Socket
   private func onBytesAvailable(_ bytes: DispatchData) {
-    buffer.append(contentsOf: bytes)
+    mainProcessed += 1
+    buffer.append(bytes)
     
     // if mode changed and buffer is not empty -> reparse
     while (!buffer.isEmpty) {
@@ -68,31 +171,253 @@ class Controller {
         return
       }
     }
+    // Modes may have changed the enabled hosts.
+    publishConnections()
+    resumeForwarding()
   }
   
-  func send(bytes: some ContiguousBytes) {
-    let data = bytes.withUnsafeBytes(DispatchData.init(bytes:))
+  // [io] stdin data. Input is forwarded from here when possible, and anything else goes to the main queue.
+  private func onStdinAvailable(_ bytes: DispatchData) {
+    var bytes = bytes
+    if ioForwarding {
+      let action = settings.actionKey.value
+      var count = 0
+      for region in bytes.regions {
+        let forwarded = region.withUnsafeBytes { bytes in
+          let end = bytes.firstIndex(of: action) ?? bytes.count
+          if end > 0 {
+            forward(UnsafeRawBufferPointer(rebasing: bytes[..<end]))
+          }
+          return end
+        }
+        count += forwarded
+        if forwarded < region.count { break }
+      }
+      guard count < bytes.count else { return }
+      // The action key and what follows are handled by the main queue.
+      ioForwarding = false
+      bytes = bytes.subdata(in: count..<bytes.count)
+    }
+    ioPosted += 1
+    DispatchQueue.main.asyncUnsafe { [self] in
+      onBytesAvailable(bytes)
+    }
+  }
+  
+  // Resume forwarding stdin from the io queue, if the main queue has nothing left to process.
+  private func resumeForwarding() {
+    guard stdin != nil, buffer.isEmpty, inputMode.id == InputMode.Input().id else { return }
+    ioQueue.asyncUnsafe { [self, processed = mainProcessed] in
+      // Otherwise, stdin data is on its way to the main queue, which will try again once done.
+      if processed == ioPosted {
+        ioForwarding = true
+      }
+    }
+  }
+  
+  /// Enable the given hosts, and disable all others.
+  func enable(hosts ids: Set<HostWindow.ID>) {
     for host in hosts {
-      send(bytes: data, to: host)
+      host.enabled = ids.contains(host.id)
     }
+    publishConnections()
   }
   
-  func send(bytes: some ContiguousBytes, to host: HostWindow) {
-    let data = bytes.withUnsafeBytes(DispatchData.init(bytes:))
-    send(bytes: data, to: host)
+  // Make the enabled hosts connections available to the data path.
+  private func publishConnections() {
+    let targets = hosts.filter { $0.enabled && $0.connection != nil }
+    let connections = targets.compactMap(\.connection)
+    // The recording tells which hosts received the broadcast input.
+    let names = recorder != nil ? targets.map(\.host.connectionString) : []
+    ioQueue.asyncUnsafe { [self] in
+      ioConnections = connections
+      recorder?.record(targets: names)
+    }
+  }
+  
+  func send(bytes: some ContiguousBytes) {
+    let bytes = bytes.withUnsafeBytes { [UInt8]($0) }
+    ioQueue.asyncUnsafe { [self] in
+      bytes.withUnsafeBytes { forward($0) }
+    }
+  }
+  
+  // [io]
+  private func forward(_ bytes: UnsafeRawBufferPointer) {
+    recorder?.record(bytes, host: nil)
+    coalescer.append(bytes)
+    if capture != nil {
+      track(command: bytes)
+    }
+    scheduleInputFlush()
+  }
+  
+  /// Write the pending broadcast input now. Must be called before sending anything that must follow it.
+  ///
+  /// Waits for the data path, so everything sent to the hosts before this call is written once it returns.
+  func flushInput() {
+    ioQueue.sync {
+      coalescer.flush()
+    }
   }
   
-  private func send(bytes: DispatchData, to host: HostWindow) {
+  // [io]
+  private func broadcast(_ bytes: UnsafeRawBufferPointer) {
+    // Input frames are encoded once, and shared by all host queues.
+    let (data, payload) = Self.encode(input: bytes)
+    for connection in ioConnections {
+      connection.send(input: data, payload: payload)
+    }
+  }
+  
+  private func scheduleInputFlush() {
+    guard let deadline = coalescer.deadline, deadline != coalescerDeadline else { return }
+    if coalescerTimer == nil {
+      let timer = DispatchSource.makeTimerSource(queue: ioQueue)
+      timer.setEventHandler { [self] in
+        coalescerDeadline = nil
+        coalescer.advance()
+        // Fired before the deadline (leeway): try again.
+        scheduleInputFlush()
+      }
+      timer.activate()
+      coalescerTimer = timer
+    }
+    coalescerDeadline = deadline
+    coalescerTimer?.schedule(deadline: DispatchTime(uptimeNanoseconds: deadline), leeway: .microseconds(100))
+  }
+  
+  // [io] Start a new captured command each time Enter is broadcast.
+  private func track(command bytes: UnsafeRawBufferPointer) {
+    for byte in bytes {
+      switch byte {
+        case 0x0d, 0x0a:
+          let command = String(decoding: captureLine, as: UTF8.self)
+          DispatchQueue.main.asyncUnsafe { [self] in
+            capture?.begin(command: command)
+          }
+          captureLine.removeAll(keepingCapacity: true)
+        case 0x08, 0x7f:
+          _ = captureLine.popLast()
+        case 0x20..<0x7f, 0x80...:
+          // The command is only a label.
+          if captureLine.count < 256 {
+            captureLine.append(byte)
+          }
+        default:
+          break
+      }
+    }
+  }
+  
+  func send(bytes: some ContiguousBytes, to host: HostWindow) {
+    let bytes = bytes.withUnsafeBytes { [UInt8]($0) }
     // Skip disabled hosts, and host without valid connection
-    guard host.enabled, let connection = host.connection else { return }
+    let connection = host.enabled ? host.connection : nil
+    let name = host.host.connectionString
+    // Follows the broadcast input sent before it.
+    ioQueue.asyncUnsafe { [self] in
+      coalescer.flush()
+      recorder?.record(bytes, host: name)
+      guard let connection else { return }
+      let (data, payload) = Self.encode(input: bytes)
+      connection.send(input: data, payload: payload)
+    }
+  }
+  
+  // MARK: - File Push
+  /// Stream a file to all enabled hosts. Input is not forwarded until the push is done.
+  func push(file path: String, to destination: FilePush.Destination) throws {
+    guard filePush == nil else { throw POSIXError(.EBUSY) }
+
+    flushInput()
+    let push = try FilePush(contentsOf: path, destination: destination, options: settings.push)
+    let connections = hosts.filter(\.enabled).compactMap(\.connection)
+    logger.info("pushing \(push.name, privacy: .public) (\(push.payloadSize) bytes) to \(connections.count) hosts")
+
+    let start = DispatchTime.now()
+    push.completion = { [self] push in
+      let elapsed = (DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds) / NSEC_PER_MSEC
+      logger.info("push of \(push.name, privacy: .public) done in \(elapsed) ms: \(push.completed) hosts completed, \(push.failed) failed")
+      filePush = nil
+      // May be called while an input mode is parsing (cancel) -> switch mode later.
+      DispatchQueue.main.asyncUnsafe { [self] in
+        if inputMode.id == InputMode.Pushing().id {
+          try? setInputMode(InputMode.Input())
+        }
+      }
+    }
+    filePush = push
+    filePushProgress = -1
+    push.start(connections)
+  }
+
+  func cancelPush() {
+    filePush?.cancel()
+  }
+
+  // Called each time a host acknowledges input.
+  private func resumePush(_ connection: HostConnection) {
+    guard let push = filePush else { return }
+    push.resume(connection)
+
+    let progress = Int(push.progress * 100)
+    if progress != filePushProgress {
+      filePushProgress = progress
+      if inputMode.id == InputMode.Pushing().id {
+        prompt()
+      }
+    }
+  }
+
+  private static func encode(input bytes: some ContiguousBytes) -> (DispatchData, Int) {
+    bytes.withUnsafeBytes { bytes in
+      var data = DispatchData.empty
+      var offset = 0
+      repeat {
+        let chunk = UnsafeRawBufferPointer(rebasing: bytes[offset..<min(bytes.count, offset + Wire.maxPayloadSize)])
+        data.append(Frame.input(chunk).data())
+        offset += chunk.count
+      } while offset < bytes.count
+      return (data, bytes.count)
+    }
+  }
+  
+  // MARK: - Latency Probes
+  func startProbing() {
+    guard probeTimer == nil, settings.latencyProbeInterval > 0 else { return }
     
-    connection.write(bytes) { [self] error in
-      // on error -> remove host from the host list
-      if error != nil {
-        logger.warning("error while forwarding data to host: \(host.host.hostname, privacy: .public)")
-        terminate(host: host)
+    let interval = DispatchTimeInterval.milliseconds(settings.latencyProbeInterval)
+    let timer = DispatchSource.makeTimerSource(queue: .main)
+    var deadline = DispatchTime.now() + interval
+    timer.schedule(deadline: deadline, repeating: interval)
+    timer.setEventHandler { [self] in
+      let now = DispatchTime.now()
+      mainQueueDelay.record(now.uptimeNanoseconds > deadline.uptimeNanoseconds ? now.uptimeNanoseconds - deadline.uptimeNanoseconds : 0)
+      // Missed deadlines are coalesced by the timer.
+      repeat { deadline = deadline + interval } while deadline <= now
+      
+      // Probes must follow the input sent before them.
+      flushInput()
+      probeId &+= 1
+      for host in hosts {
+        host.connection?.ping(id: probeId)
       }
+      // Live refresh of the statistics and captured output
+      if inputMode is InputMode.Stats || inputMode is InputMode.Diff {
+        prompt()
+      }
+    }
+    timer.activate()
+    probeTimer = timer
+  }
+  
+  func resetStatistics() {
+    mainQueueDelay.reset()
+    ioQueue.asyncUnsafe { [self] in
+      coalescer.resetStatistics()
     }
+    hosts.forEach { $0.connection?.resetStatistics() }
   }
   
   // MARK: - Input
@@ -108,6 +433,11 @@ class Controller {
   private func setInputMode(_ mode: some InputModeProtocol) throws {
     guard mode.id != inputMode.id else { return }
     
+    // Input typed before the mode switch (before the action key) is not delayed.
+    ioQueue.sync {
+      coalescer.flush()
+      ioForwarding = false
+    }
     logger.info("Switching input mode")
     inputMode = mode
     
@@ -115,6 +445,7 @@ class Controller {
     // Must enable before prompt
     try inputMode.onEnable(self)
     prompt()
+    resumeForwarding()
   }
   
   private func setRawInputMode(_ value: Bool) throws {
@@ -135,12 +466,14 @@ class Controller {
     
     let input = DispatchIO(type: .stream,
                            fileDescriptor: STDIN_FILENO,
-                           queue: .main, cleanupHandler: { [self] error in
-      do {
-        try setRawInputMode(false)
-        // exit after restoring the input mode
-        Foundation.exit(0)
-      } catch {}
+                           queue: ioQueue, cleanupHandler: { [self] error in
+      DispatchQueue.main.asyncUnsafe { [self] in
+        do {
+          try setRawInputMode(false)
+          // exit after restoring the input mode
+          Foundation.exit(0)
+        } catch {}
+      }
     })
     // disable buffering
     input.setLimit(lowWater: 1)
@@ -158,22 +491,34 @@ class Controller {
     //      }
     //      winch.resume()
     
-    input.read { [self] bytes in
-      onBytesAvailable(bytes)
+    input.read(queue: ioQueue) { [self] bytes in
+      onStdinAvailable(bytes)
     } whenDone: { [self] error in
       // unreachable, as stdin should never be done.
       if let error {
         logger.warning("stdin done with error: \(error, privacy: .public)")
-        close()
+        DispatchQueue.main.asyncUnsafe { [self] in
+          close()
+        }
       }
     }
+    resumeForwarding()
   }
   
   // MARK: - Layout
-  func layout() {
+  func host(id: HostWindow.ID) -> HostWindow? {
+    hostsById[id]
+  }
+  
+  /// Layout host windows. Only windows whose frame changed are updated, unless `force` is set.
+  func layout(force: Bool = false) {
     guard let tab else { return }
     
-    windowManager.layout(controller: tab, hosts: hosts)
+    if force {
+      windowManager.invalidate()
+    }
+    // Headless sessions have no window to layout.
+    windowManager.layout(controller: tab, hosts: hosts.filter { $0.tab != nil })
     // Always make sure the controller window is frontmost window
     tab.window.frontmost = true
   }
@@ -213,24 +558,10 @@ extension Controller {
     let srv = try IOListener.listen(socket: socket)
     listener = srv
     
-    srv.startWaiting { [self] result in
+    srv.startWaiting(queue: ioQueue) { [self] result in
       switch (result) {
         case .success(let fd):
-          let pid = getPeerProcessId(socket: fd)
-          guard pid > 0 else {
-            Darwin.close(fd)
-            return
-          }
-          
-          logger.info("[\(pid)] did open connection")
-          let tty = Termios.getProcessTTY(pid)
-          guard tty > 0 else {
-            logger.warning("[\(pid)] cannot get connected process tty. Rejecting the connection")
-            Darwin.close(fd)
-            return
-          }
-          logger.info("[\(pid)] connection tty: \(tty)")
-          didOpen(socket: fd, tty: tty)
+          didAccept(socket: fd)
         case .failure(let error):
           logger.error("server socket error: \(error, privacy: .public)")
           close()
@@ -242,37 +573,92 @@ extension Controller {
     if inputMode is InputMode.Starting {
       layout()
       try setInputMode(InputMode.Input())
+      startProbing()
     }
   }
   
-  func add(host target: Target, whenDone done: @escaping ((any Error)?) -> Void) throws {
-    let tab = try Terminal.Tab.open()
-    if let profile = settings.hostWindowProfile {
-      if (!tab.setProfile(profile)) {
-        // TODO: print warning ?
-      }
+  /// Queue the host launch. `done` is called once the host is ready, or when the launch failed.
+  func add(host target: Target, whenDone done: @escaping ((any Error)?) -> Void) {
+    add(hosts: [target]) { _, error in done(error) }
+  }
+  
+  /// Queue the hosts launches, in order. `done` is called for each host.
+  func add(hosts targets: [Target], whenDone done: @escaping (Target, (any Error)?) -> Void) {
+    enqueue(targets.map { ($0, []) }, timeout: nil, whenDone: done)
+  }
+  
+  /// Queue relays launches, one per shard. `done` is called for each relay.
+  ///
+  /// A relay is seen as a single host, and is ready once all the hosts of its shard are launched,
+  /// so its launch timeout is extended to cover the relay launch pipeline.
+  func add(relays shards: [[Target]], whenDone done: @escaping (Target, (any Error)?) -> Void) {
+    let relays = shards.enumerated().map { idx, shard in
+      (Target(user: nil, hostname: "relay-\(idx + 1)", port: nil, command: nil), shard)
+    }
+    let largest = shards.map(\.count).max() ?? 0
+    let rounds = (largest + settings.launch.concurrency - 1) / max(1, settings.launch.concurrency)
+    enqueue(relays, timeout: settings.launch.timeout * (1 + rounds), whenDone: done)
+  }
+  
+  private func enqueue(_ targets: [(Target, [Target])], timeout: Int?, whenDone done: @escaping (Target, (any Error)?) -> Void) {
+    let first = launchId + 1
+    for (target, shard) in targets {
+      launchId += 1
+      launches[launchId] = Launch(target: target, shard: shard) { error in done(target, error) }
     }
-    // Get window size ratio for new window and save it into the layout manager
-    // It is more accurate to take it from a new window than trying to infer it from
-    // the tab profile rows/columns count, as the row/columns size ratio depends the used font.
-    windowManager.setDefaultWindowRatio(from: tab)
+    // Masters are started while the windows are opened. Relays have their own.
+    masters?.prewarm(targets.filter { $0.1.isEmpty }.map(\.0))
+    launcher.enqueue(first..<launchId + 1, timeout: timeout)
     
-    let tty = tab.tty
-    guard tty > 0 else {
-      throw ScriptingBridgeError()
+    guard launchTimer == nil, !launcher.isIdle else { return }
+    let tick = DispatchTimeInterval.milliseconds(max(1, settings.launch.tick))
+    let timer = DispatchSource.makeTimerSource(queue: .main)
+    timer.schedule(deadline: .now() + tick, repeating: tick)
+    timer.setEventHandler { [self] in
+      launcher.advance()
     }
-    logger.info("[\(target.hostname, privacy: .public)] opening window: \(tab.windowId)/\(tab.tabIdx) (tty: \(tty))")
+    timer.activate()
+    launchTimer = timer
+  }
+  
+  private func spawn(launch id: LaunchScheduler.ID) throws {
+    guard let launch = launches[id] else { throw POSIXError(.ENOENT) }
+    let target = launch.target
+    // The session is registered once opened, but its token is needed on the command line.
+    let token = SessionToken.random()
     
-    let host = HostWindow(tab: tab, host: target, tty: tty, config: settings.hostWindow)
-    host.whenDone = done
-    hosts.append(host)
+    let script = launch.shard.isEmpty ? hostScript(target, token: token) : relayScript(launch.shard, token: token)
+    
+    // Something went wrong while starting -> the launch is failed by the scheduler.
+    let session = try backend.open(target, script: script)
+    if let tab = session.tab {
+      // Get window size ratio for new window and save it into the layout manager
+      // It is more accurate to take it from a new window than trying to infer it from
+      // the tab profile rows/columns count, as the row/columns size ratio depends the used font.
+      windowManager.setDefaultWindowRatio(from: tab)
+    }
     
+    let host = HostWindow(session: session, host: target, config: settings.hostWindow)
+    host.launchId = id
+    host.token = token
+    host.relay = !launch.shard.isEmpty
+    sessions.insert(host, for: token)
+    launches[id]?.host = host
+    hosts.append(host)
+    hostsById[host.id] = host
+    trace?.mark("first window")
+    logger.info("did start csshx \(target.hostname, privacy: .public)")
+  }
+  
+  private func hostScript(_ target: Target, token: SessionToken) -> String {
     let csshx = CommandLine.executableURL()
     var args = [
       csshx.path, "--", "host",
       "--ssh", settings.ssh,
       "--socket", socket,
       "--hostname", target.hostname,
+      "--injection", settings.injection.rawValue,
+      "--token", token.description,
     ]
     if let user = target.user {
       args.append("--login")
@@ -285,8 +671,15 @@ extension Controller {
     if settings.dummy {
       args.append("--dummy")
     }
+    if settings.capture {
+      args.append("--capture")
+    }
+    if let masters {
+      args.append("--control-path")
+      args.append(masters.controlPath(for: target))
+    }
 
-    // passing ssh args and remote command as raw arguments, and let the Terminal shell parse them
+    // passing ssh args and remote command as raw arguments, and let the session shell parse them
     var script = Shell.quote(args: args)
     if settings.sshArgs != nil || settings.remoteCommand != nil {
       script.append(" --extra-args")
@@ -301,62 +694,167 @@ extension Controller {
         script.append(remoteCommand)
       }
     }
-    
-    do {
-      try tab.run(args: script, clear: true, exec: !settings.debug)
-    } catch {
-      // Something went wrong while starting -> abort now
-      terminate(host: host)
-      done(error)
-      return
+    return script
+  }
+  
+  // The relay passes ssh args and remote command as is to its hosts, so they are quoted here.
+  private func relayScript(_ shard: [Target], token: SessionToken) -> String {
+    let csshx = CommandLine.executableURL()
+    var args = [
+      csshx.path, "--", "relay",
+      "--socket", socket,
+      "--token", token.description,
+      "--ssh", settings.ssh,
+      "--injection", settings.injection.rawValue,
+      "--probe-interval", String(settings.latencyProbeInterval),
+      "--launch-timeout", String(settings.launch.timeout),
+      "--session-buffer-size", String(settings.sessionBufferSize),
+    ]
+    if let sshArgs = settings.sshArgs {
+      args.append("--ssh-args")
+      args.append(sshArgs)
     }
-    logger.info("did start csshx \(target.hostname, privacy: .public)")
-    
-    // Simple timeout scheme. Instead of scheduling a DispatchSourceTimer, and having to manage it
-    // unconditonally schedule a block after delay, and test if the op is done when this block is executed.
-    DispatchQueue.main.asyncAfterUnsafe(deadline: .now() + .seconds(5)) { [weak self] in
-      // if operation not done yet -> cancel it.
-      if let self, let done = host.whenDone {
+    if let remoteCommand = settings.remoteCommand {
+      args.append("--remote-command")
+      args.append(remoteCommand)
+    }
+    if settings.sshControlMaster {
+      args.append(contentsOf: ["--ssh-control-master-concurrency", String(settings.sshControlMasterConcurrency),
+                               "--ssh-control-persist", String(settings.sshControlPersist)])
+    }
+    if settings.dummy {
+      args.append("--dummy")
+    }
+    args.append("--")
+    args.append(contentsOf: shard.map(\.connectionString))
+    return Shell.quote(args: args)
+  }
+  
+  private func didLaunch(_ id: LaunchScheduler.ID, error: (any Error)?) {
+    guard let launch = launches.removeValue(forKey: id) else { return }
+    if let host = launch.host, host.launchId == id {
+      host.launchId = nil
+      if error != nil {
         terminate(host: host)
-        done(POSIXError(.ETIMEDOUT))
       }
     }
+    launch.done(error)
+    // Nothing left to control
+    if error != nil, hosts.isEmpty, launcher.isIdle {
+      close()
+    }
+    // raw input mode do not show user input and can safely reprompt
+    if inputMode.raw {
+      prompt()
+    }
   }
   
-  private func didOpen(socket: Int32, tty: dev_t) {
-    // lookup matching host window and attach the connection
-    guard let host = hosts.first(where: { $0.tty == tty }) else {
-      logger.warning("did not find matching host window for tty: \(tty)")
-      Darwin.close(socket)
-      return
-    }
-    host.connection = DispatchIO(type: .stream,
-                                 fileDescriptor: socket,
-                                 queue: DispatchQueue.main,
-                                 cleanupHandler: { error in Darwin.close(socket) })
+  private func didAccept(socket: Int32) {
+    // The host is only known once its hello is received: the launch connect time is recorded then.
+    let accepted = DispatchTime.now().uptimeNanoseconds
+    // Credits and probes are processed on the data path queue. Other frames are delivered on the main queue.
+    let connection = HostConnection(socket: socket, limits: settings.broadcast, queue: ioQueue)
+    // Set by the first frame, which must be a 'hello' with a pending session token.
+    var host: HostWindow? = nil
     
-    // Notify the host it is connected
-    let handshake: [UInt8] = [ 0 ]
-    handshake.withUnsafeBytes { bytes in
-      send(bytes: DispatchData(bytes: bytes), to: host)
+    // Process host messages. This also let us detect when the connection is closed.
+    connection.receive { [self] frame in
+      guard let host else {
+        do {
+          let matched = try sessions.match(frame)
+          matched.token = nil
+          if case .hello(let version, let pid, _) = frame {
+            logger.info("[\(matched, privacy: .public)] host process \(pid) (protocol version \(version))")
+          }
+          guard verify(connection: socket, host: matched) else {
+            terminate(host: matched)
+            connection.close()
+            return
+          }
+          host = matched
+          didOpen(connection: connection, host: matched, accepted: accepted)
+        } catch {
+          logger.warning("rejecting connection: \(error, privacy: .public)")
+          connection.close()
+        }
+        return
+      }
+      switch frame {
+        case .status(let pid, let exitCode):
+          if let exitCode {
+            logger.info("[\(host, privacy: .public)] ssh (\(pid)) exited with status \(exitCode)")
+          } else {
+            logger.info("[\(host, privacy: .public)] ssh started (\(pid))")
+          }
+        case .resize(let rows, let columns):
+          logger.debug("[\(host, privacy: .public)] window size: \(columns)x\(rows)")
+        case .credit:
+          if let connection = host.connection {
+            resumePush(connection)
+          }
+          onDrain?()
+        case .pong:
+          break
+        case .relayStats(let stats):
+          host.relayStats = stats
+        case .output(let bytes):
+          capture?.append(bytes, from: host.id)
+        case .hello, .input, .ping, .resume:
+          logger.warning("[\(host, privacy: .public)] discarding unexpected frame: \(frame.type.rawValue)")
+      }
+    } whenDone: { [self] error in
+      guard let host else { return }
+      logger.warning("[\(host, privacy: .public)] connection lost")
+      terminate(host: host)
     }
-    
-    if let done = host.whenDone {
-      host.whenDone = nil
-      done(nil)
-      // raw input mode do not show user input and can safely reprompt
+  }
+  
+  /// Optional check that the connected process runs on the host session tty.
+  ///
+  /// The session token is enough to match a connection. This only protects against a token leaked to another process.
+  private func verify(connection socket: Int32, host: HostWindow) -> Bool {
+    guard settings.verifyTTY else { return true }
+    let pid = getPeerProcessId(socket: socket)
+    let tty = pid > 0 ? Termios.getProcessTTY(pid) : 0
+    guard tty > 0, tty == host.tty else {
+      logger.warning("[\(host, privacy: .public)] connection tty mismatch (pid: \(pid), tty: \(tty), expected: \(host.tty))")
+      return false
+    }
+    return true
+  }
+  
+  private func didOpen(connection: HostConnection, host: HostWindow, accepted: UInt64) {
+    connection.onError = { [self] connection, error in
+      // on error -> remove host from the host list
+      logger.warning("error while forwarding data to host: \(host.host.hostname, privacy: .public)")
+      terminate(host: host)
+    }
+    connection.onOverflow = { [self] connection in
+      logger.warning("[\(host, privacy: .public)] host is lagging behind (policy: \(self.settings.broadcast.policy.rawValue, privacy: .public))")
+      if settings.broadcast.policy == .disable {
+        host.enabled = false
+        publishConnections()
+      }
       if inputMode.raw {
         prompt()
       }
     }
+    connection.onRecover = { [self] connection in
+      if inputMode.raw {
+        prompt()
+      }
+    }
+    host.connection = connection
     
-    // Start a monitoring task. An host is not supposed to write in the connection,
-    // but it help us detect when the connection is closed.
-    host.connection?.read { data in
-      logger.warning("[\(host, privacy: .public)] discarding unexpected input: \(data.count) bytes")
-    } whenDone: { [self] error in
-      logger.warning("[\(host, privacy: .public)] connection lost")
-      terminate(host: host)
+    // Notify the host it is connected
+    connection.send(.hello(version: Wire.version, pid: getpid(), token: .zero))
+    // Broadcast input must follow the hello.
+    publishConnections()
+    
+    if let id = host.launchId {
+      // connect: spawn → accepted, handshake: accepted → hello matched.
+      launcher.didConnect(id, at: accepted)
+      launcher.didBecomeReady(id)
     }
   }
   
@@ -364,7 +862,23 @@ extension Controller {
     guard let idx = hosts.firstIndex(of: host) else {
       return
     }
+    if let id = host.launchId {
+      host.launchId = nil
+      launcher.didFail(id, error: POSIXError(.ECONNRESET))
+    }
+    if let token = host.token {
+      host.token = nil
+      sessions.remove(token)
+    }
+    if let connection = host.connection {
+      filePush?.remove(connection)
+    }
+    capture?.remove(host.id)
     hosts.remove(at: idx).terminate()
+    hostsById[host.id] = nil
+    publishConnections()
+    windowManager.invalidate(host: host.id)
+    onDrain?()
     if (hosts.isEmpty) {
       // Terminate input loop if is running
       close()
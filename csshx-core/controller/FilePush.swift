@@ -0,0 +1,179 @@
+//
+//  FilePush.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Stream a local file to hosts, through their controller connection.
+///
+/// The file is read once, and encoded into input frames shared by all hosts (DispatchData is an immutable
+/// ref-counted buffer). Each host has its own position in the frame list, and at most `window` bytes in flight:
+/// the next frames are sent as the host acknowledges the previous ones (credit frames), so a slow host neither
+/// stalls the others nor makes the controller memory grow.
+///
+/// The push does not read the connections itself: the owner must call `resume(_:)` each time a host
+/// acknowledges input, and `remove(_:)` when a connection is lost.
+final class FilePush {
+
+  enum Destination: Equatable, Sendable {
+    // Injected as is, as if typed in the host windows.
+    case input
+    // Written to a file on the remote hosts, by a shell heredoc. The content is base64 encoded, so any file
+    // goes through the remote tty line discipline unaltered.
+    case file(String)
+  }
+
+  struct Options: Sendable {
+    // Size of the frames payload.
+    var chunkSize: Int = 64 * 1024
+    // Max bytes in flight per host.
+    var window: Int = 256 * 1024
+  }
+
+  private struct Stream {
+    let connection: HostConnection
+    // Next frame to send.
+    var next = 0
+    // Bytes sent, acknowledged or not.
+    var sent = 0
+  }
+
+  let name: String
+  let destination: Destination
+  // Bytes sent to each host (including the heredoc wrapping).
+  let payloadSize: Int
+
+  private let window: Int
+  private let frames: [(data: DispatchData, size: Int)]
+  private var streams = [ObjectIdentifier: Stream]()
+  private var cancelled = false
+
+  private(set) var hostCount = 0
+  // Hosts which acknowledged the whole file.
+  private(set) var completed = 0
+  // Hosts whose connection was lost before completion.
+  private(set) var failed = 0
+
+  /// Called once all hosts completed or failed, or once cancelled.
+  var completion: ((FilePush) -> Void)? = nil
+
+  convenience init(contentsOf path: String, destination: Destination = .input, options: Options = Options()) throws {
+    let content = try Data(contentsOf: URL(fileURLWithPath: path))
+    self.init(content, name: (path as NSString).lastPathComponent, destination: destination, options: options)
+  }
+
+  init(_ content: some ContiguousBytes, name: String, destination: Destination = .input, options: Options = Options()) {
+    self.name = name
+    self.destination = destination
+    window = max(1, options.window)
+
+    let payload: [UInt8]
+    switch destination {
+      case .input:
+        payload = content.withUnsafeBytes { Array($0) }
+      case .file(let path):
+        payload = content.withUnsafeBytes { Self.heredoc($0, path: path) }
+    }
+    payloadSize = payload.count
+
+    let chunkSize = max(1, min(options.chunkSize, Wire.maxPayloadSize))
+    frames = payload.withUnsafeBytes { bytes in
+      stride(from: 0, to: bytes.count, by: chunkSize).map { offset in
+        let chunk = UnsafeRawBufferPointer(rebasing: bytes[offset..<min(bytes.count, offset + chunkSize)])
+        return (Frame.input(chunk).data(), chunk.count)
+      }
+    }
+  }
+
+  var isDone: Bool { cancelled || completed + failed == hostCount }
+
+  /// Fraction of the bytes acknowledged by all hosts, in 0...1.
+  var progress: Double {
+    guard hostCount > failed, payloadSize > 0 else { return 1 }
+    let acknowledged = streams.values.reduce(0) { $0 + max(0, $1.sent - $1.connection.queuedBytes) }
+    return Double(completed * payloadSize + acknowledged) / Double((hostCount - failed) * payloadSize)
+  }
+
+  func start(_ connections: [HostConnection]) {
+    hostCount = connections.count
+    for connection in connections {
+      streams[ObjectIdentifier(connection)] = Stream(connection: connection)
+    }
+    for connection in connections {
+      resume(connection)
+    }
+    // Nothing to send
+    finishIfDone()
+  }
+
+  /// Send the next frames to connection, if it has room for them.
+  func resume(_ connection: HostConnection) {
+    let id = ObjectIdentifier(connection)
+    guard !cancelled, var stream = streams[id] else { return }
+
+    // A frame larger than the window is sent alone.
+    while stream.next < frames.count,
+          connection.queuedBytes == 0 || connection.queuedBytes + frames[stream.next].size <= window {
+      let frame = frames[stream.next]
+      connection.send(stream: frame.data, payload: frame.size)
+      stream.next += 1
+      stream.sent += frame.size
+    }
+
+    if stream.next == frames.count, connection.queuedBytes == 0 {
+      streams[id] = nil
+      completed += 1
+      finishIfDone()
+    } else {
+      streams[id] = stream
+    }
+  }
+
+  /// Connection lost.
+  func remove(_ connection: HostConnection) {
+    guard streams.removeValue(forKey: ObjectIdentifier(connection)) != nil else { return }
+    failed += 1
+    finishIfDone()
+  }
+
+  /// Stop sending the file. Frames already queued are still delivered.
+  func cancel() {
+    guard !cancelled, !isDone else { return }
+    cancelled = true
+    if case .file = destination {
+      // Interrupt the heredoc, so the remote shell does not run the truncated command.
+      let interrupt = [UInt8(0x03)].withUnsafeBytes { Frame.input($0).data() }
+      streams.values.forEach { $0.connection.send(stream: interrupt, payload: 1) }
+    }
+    streams.removeAll()
+    completion?(self)
+    completion = nil
+  }
+
+  private func finishIfDone() {
+    guard isDone else { return }
+    completion?(self)
+    completion = nil
+  }
+
+  // MARK: Heredoc
+  // Not part of the base64 alphabet, so it cannot appear in the content.
+  static let heredocDelimiter = "CSSHX_EOF"
+
+  /// Shell command writing content to path on the remote host.
+  static func heredoc(_ content: UnsafeRawBufferPointer, path: String) -> [UInt8] {
+    var command = Array("base64 -d > \(Shell.quote(arg: path)) <<'\(heredocDelimiter)'\n".utf8)
+    let encoded = Data(content).base64EncodedData(options: [.lineLength76Characters, .endLineWithLineFeed])
+    command.reserveCapacity(command.count + encoded.count + heredocDelimiter.utf8.count + 2)
+    command.append(contentsOf: encoded)
+    if !encoded.isEmpty {
+      command.append(UInt8(ascii: "\n"))
+    }
+    command.append(contentsOf: heredocDelimiter.utf8)
+    command.append(UInt8(ascii: "\n"))
+    return command
+  }
+}
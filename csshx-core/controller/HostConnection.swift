@@ -0,0 +1,284 @@
+//
+//  HostConnection.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Socket connection to a csshx-host process.
+///
+/// Broadcast data is shared by all connections (DispatchData is an immutable ref-counted buffer),
+/// and each connection only keeps track of what is still in flight for its host.
+/// The amount of in-flight data is bounded, so a stalled host cannot make the controller memory grow without limit.
+///
+/// The socket is served on `queue`, so credits and probes are processed even while the main queue is busy.
+/// The connection state is protected by a lock, and can be used from any queue. Frames (other than credits and
+/// pongs, which are processed by the connection) and callbacks are always delivered on the main queue.
+final class HostConnection: @unchecked Sendable {
+
+  enum OverflowPolicy: String, Sendable {
+    // Drop input for this host until it is resumed by the user (see `resume()`).
+    // The host stays enabled, and can be resumed as soon as its queue is drained.
+    case lag
+    // Disable input for this host. It must be re-enabled by the user.
+    case disable
+  }
+
+  struct Limits: Sendable {
+    // high-water mark of bytes queued for a single host.
+    var maxBytes: Int = 1024 * 1024
+    // high-water mark of the age of the oldest queued chunk, in milliseconds.
+    var maxLatency: Int = 2000
+    var policy: OverflowPolicy = .disable
+  }
+
+  private let io: DispatchIO
+  private let queue: DispatchQueue
+  private let limits: Limits
+  private let lock = NSLock()
+  // socket frames, decoded on `queue`, and frames passed to the main queue.
+  private var decoder = FrameDecoder()
+  private var mainDecoder = FrameDecoder()
+
+  // FIFO of in-flight input (enqueue time, size). A chunk stays in flight until the host
+  // acknowledges it with a credit frame, which it sends once the input is injected.
+  private var inflight: [(time: DispatchTime, size: Int)] = []
+  private var head = 0
+
+  private var _queuedBytes: Int = 0
+  private var _bytesForwarded: UInt64 = 0
+  private var _bytesDropped: UInt64 = 0
+  // true once data for this host was dropped because the queue reached the high-water mark (both policies).
+  // Input is never resumed automatically, as the host would receive a command with missing bytes.
+  // With the disable policy, this also covers the input sent before the host is disabled.
+  private var _lagging: Bool = false
+
+  // One-way latency (ns) between a probe being queued by the controller and the host processing it,
+  // after all input queued before it has been injected.
+  private var _latency = Histogram()
+  // Outstanding probe. A single probe is in flight at a time, so a stalled host is not flooded with pings.
+  private var probe: UInt32? = nil
+
+  // Called when the queue crosses the high-water mark (and once drained for the lag policy).
+  var onOverflow: ((HostConnection) -> Void)? = nil
+  var onRecover: ((HostConnection) -> Void)? = nil
+  var onError: ((HostConnection, any Error) -> Void)? = nil
+
+  init(socket: Int32, limits: Limits, queue: DispatchQueue = .main) {
+    self.limits = limits
+    self.queue = queue
+    io = DispatchIO(type: .stream,
+                    fileDescriptor: socket,
+                    queue: queue,
+                    cleanupHandler: { error in Darwin.close(socket) })
+  }
+
+  func close() {
+    io.close(flags: .stop)
+  }
+
+  private func locked<R>(_ body: () throws -> R) rethrows -> R {
+    lock.lock()
+    defer { lock.unlock() }
+    return try body()
+  }
+
+  var queuedBytes: Int { locked { _queuedBytes } }
+  var bytesForwarded: UInt64 { locked { _bytesForwarded } }
+  var bytesDropped: UInt64 { locked { _bytesDropped } }
+  var lagging: Bool { locked { _lagging } }
+  var latency: Histogram { locked { _latency } }
+  var probePending: Bool { locked { probe != nil } }
+
+  var queueDepth: Int { locked { inflight.count - head } }
+
+  // Age of the oldest in-flight chunk in milliseconds.
+  var queueLatency: Int { locked { _queueLatency } }
+
+  private var _queueLatency: Int {
+    guard head < inflight.endIndex else { return 0 }
+    return Int((DispatchTime.now().uptimeNanoseconds - inflight[head].time.uptimeNanoseconds) / 1_000_000)
+  }
+
+  /// Send a control frame. Control frames are never dropped.
+  func send(_ frame: Frame) {
+    write(frame.data())
+  }
+
+  /// Enqueue input frames for this host.
+  /// - Parameters:
+  ///   - data: encoded input frames.
+  ///   - payload: total size of the frames payload.
+  /// - Returns: false if the data was dropped because the host is lagging.
+  @discardableResult
+  func send(input data: DispatchData, payload: Int) -> Bool {
+    lock.lock()
+    guard !_lagging else {
+      _bytesDropped += UInt64(payload)
+      lock.unlock()
+      return false
+    }
+
+    if _queuedBytes + payload > limits.maxBytes || _queueLatency > limits.maxLatency {
+      logger.warning("host queue reached high-water mark (\(self._queuedBytes) bytes, \(self._queueLatency) ms)")
+      _bytesDropped += UInt64(payload)
+      _lagging = true
+      lock.unlock()
+      notify { $0.onOverflow?($0) }
+      return false
+    }
+
+    inflight.append((DispatchTime.now(), payload))
+    _queuedBytes += payload
+    lock.unlock()
+
+    write(data)
+    return true
+  }
+
+  /// Enqueue input frames paced by the caller (see `FilePush`), which bypass the queue limits and are never dropped.
+  /// - Parameters:
+  ///   - data: encoded input frames.
+  ///   - payload: total size of the frames payload.
+  func send(stream data: DispatchData, payload: Int) {
+    locked {
+      inflight.append((DispatchTime.now(), payload))
+      _queuedBytes += payload
+    }
+    write(data)
+  }
+
+  /// Send a latency probe, unless the previous one was not answered yet.
+  /// - Returns: false if a probe is still in flight.
+  @discardableResult
+  func ping(id: UInt32) -> Bool {
+    let sent = locked {
+      guard probe == nil else { return false }
+      probe = id
+      return true
+    }
+    if sent {
+      send(.ping(id: id, timestamp: DispatchTime.now().uptimeNanoseconds))
+    }
+    return sent
+  }
+
+  func resetStatistics() {
+    locked {
+      _latency.reset()
+      _bytesForwarded = 0
+      _bytesDropped = 0
+    }
+  }
+
+  private func write(_ data: DispatchData) {
+    io.write(data, queue: queue) { [self] error in
+      if let error {
+        notify { $0.onError?($0, error) }
+      }
+    }
+  }
+
+  // Callbacks are called on the main queue.
+  private func notify(_ callback: @escaping (HostConnection) -> Void) {
+    if Thread.isMainThread {
+      callback(self)
+    } else {
+      DispatchQueue.main.asyncUnsafe { [self] in callback(self) }
+    }
+  }
+
+  private func acknowledge(_ count: Int) {
+    lock.lock()
+    var remaining = count
+    while remaining > 0, head < inflight.endIndex {
+      if inflight[head].size <= remaining {
+        remaining -= inflight[head].size
+        head += 1
+      } else {
+        inflight[head].size -= remaining
+        remaining = 0
+      }
+    }
+    // Compact the FIFO once it is fully drained, or when the consumed prefix gets large.
+    if head == inflight.endIndex {
+      inflight.removeAll(keepingCapacity: true)
+      head = 0
+    } else if head >= 1024 {
+      inflight.removeFirst(head)
+      head = 0
+    }
+
+    let size = min(count, _queuedBytes)
+    _queuedBytes -= size
+    _bytesForwarded += UInt64(size)
+
+    // The host caught up, but input was dropped: it is resumed by the user only.
+    let drained = _lagging && size > 0 && _queuedBytes == 0
+    lock.unlock()
+
+    if drained {
+      logger.info("lagging host queue drained")
+      notify { $0.onRecover?($0) }
+    }
+  }
+
+  /// Forward input again to a host that dropped input. Called when the user enables the host.
+  func resume() {
+    locked {
+      _lagging = false
+    }
+  }
+
+  private func pong(id: UInt32, timestamp: UInt64, received: UInt64) {
+    locked {
+      guard id == probe else { return }
+      probe = nil
+      // controller and hosts run on the same machine, and so share the same monotonic clock.
+      _latency.record(received >= timestamp ? received - timestamp : 0)
+    }
+  }
+
+  /// Start reading frames sent by the host.
+  /// Credit and pong frames are processed by the connection before being passed to the handler.
+  /// The handler and `whenDone` are called on the main queue.
+  func receive(_ handler: @escaping (Frame) -> Void, whenDone: @escaping ((any Error)?) -> Void) {
+    io.read(queue: queue) { [self] data in
+      // Frames are only valid during decoding: they are encoded again to be passed to the main queue.
+      let inline = Thread.isMainThread
+      var forward = DispatchData.empty
+      do {
+        try decoder.decode(data) { frame in
+          switch frame {
+            case .credit(let count):
+              acknowledge(Int(count))
+            case .pong(let id, let timestamp, let received):
+              pong(id: id, timestamp: timestamp, received: received)
+              // Nothing left to do with it.
+              if !inline { return }
+            default:
+              break
+          }
+          if inline {
+            handler(frame)
+          } else {
+            forward.append(frame.data())
+          }
+        }
+      } catch {
+        logger.warning("invalid data received from host: \(error, privacy: .public)")
+        // whenDone is called when the channel is closed.
+        close()
+      }
+      if !forward.isEmpty {
+        DispatchQueue.main.asyncUnsafe { [self] in
+          try? mainDecoder.decode(forward) { handler($0) }
+        }
+      }
+    } whenDone: { [self] error in
+      notify { _ in whenDone(error) }
+    }
+  }
+}
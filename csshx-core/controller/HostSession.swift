@@ -0,0 +1,149 @@
+//
+//  HostSession.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// The terminal a csshx-host process runs on.
+///
+/// The controller matches incoming host connections to their session using the session token passed to the
+/// host command line. The session tty is only used by the optional `verify_tty` check.
+protocol HostSession: AnyObject {
+  var tty: dev_t { get }
+  // Terminal window showing the session, if any.
+  var tab: Terminal.Tab? { get }
+
+  func terminate()
+}
+
+/// Create sessions for hosts.
+protocol SessionBackend {
+  /// Start the host command line `script` (interpreted by a shell) in a new session.
+  func open(_ target: Target, script: String) throws -> any HostSession
+}
+
+enum SessionBackendType: String, CaseIterable, Sendable {
+  // A Terminal.app window per host.
+  case terminal
+  // Hosts run on a pty owned by the controller, without window.
+  case headless
+}
+
+// MARK: - Terminal
+final class TerminalSession: HostSession {
+  let terminal: Terminal.Tab
+  let tty: dev_t
+
+  var tab: Terminal.Tab? { terminal }
+
+  init(tab: Terminal.Tab, tty: dev_t) {
+    terminal = tab
+    self.tty = tty
+  }
+
+  func terminate() {
+    // Closing window in case the profile does not close window automatically
+    // tab.close()
+  }
+}
+
+struct TerminalBackend: SessionBackend {
+  let settings: Settings
+
+  func open(_ target: Target, script: String) throws -> any HostSession {
+    let tab = try Terminal.Tab.open()
+    if let profile = settings.hostWindowProfile {
+      if (!tab.setProfile(profile)) {
+        // TODO: print warning ?
+      }
+    }
+
+    let tty = tab.tty
+    guard tty > 0 else {
+      throw ScriptingBridgeError()
+    }
+    logger.info("[\(target.hostname, privacy: .public)] opening window: \(tab.windowId)/\(tab.tabIdx) (tty: \(tty))")
+
+    try tab.run(args: script, clear: true, exec: !settings.debug)
+    return TerminalSession(tab: tab, tty: tty)
+  }
+}
+
+// MARK: - Headless
+/// Host session running on a pty owned by the controller.
+///
+/// The session output is drained continuously (so the host never blocks on a full pty), and the last
+/// `capacity` bytes are kept in a ring buffer, which can be shown when attaching to the session.
+final class HeadlessSession: HostSession {
+  let tty: dev_t
+  let pid: pid_t
+  var tab: Terminal.Tab? { nil }
+
+  private let channel: DispatchIO
+  private(set) var output: RingBuffer
+  // Attached viewer, receiving live output.
+  var onOutput: ((DispatchData) -> Void)? = nil
+
+  init(script: String, capacity: Int, size: winsize) throws {
+    let pty = try PseudoTerminal.open()
+    pty.windowSize = size
+
+    var info = stat()
+    guard stat(pty.slave, &info) == 0 else {
+      let error = POSIXError.errno
+      pty.close()
+      throw error
+    }
+    tty = info.st_rdev
+
+    do {
+      pid = try Termios.spawn(["/bin/sh", "-c", script], tty: pty.slave)
+    } catch {
+      pty.close()
+      throw error
+    }
+
+    output = RingBuffer(capacity: capacity)
+    channel = DispatchIO(type: .stream, fileDescriptor: pty.master, queue: .main) { _ in
+      pty.close()
+    }
+    channel.setLimit(lowWater: 1)
+    channel.read { [weak self] data in
+      guard let self else { return }
+      output.append(data)
+      onOutput?(data)
+    } whenDone: { error in
+      // EIO once the session process exits.
+      if let error, (error as? POSIXError)?.code != .EIO {
+        logger.info("session output closed with error: \(error, privacy: .public)")
+      }
+    }
+
+    // Reap the session process.
+    let pid = pid
+    waitFor(pid: pid, queue: .main) { status in
+      logger.debug("session process \(pid) exited with status \(status)")
+    }
+  }
+
+  func terminate() {
+    onOutput = nil
+    // SIGHUP the session, as a terminal hang up would.
+    kill(pid, SIGHUP)
+    channel.close(flags: .stop)
+  }
+}
+
+struct HeadlessBackend: SessionBackend {
+  let settings: Settings
+
+  func open(_ target: Target, script: String) throws -> any HostSession {
+    let session = try HeadlessSession(script: script, capacity: settings.sessionBufferSize,
+                                      size: winsize(ws_row: 24, ws_col: 80, ws_xpixel: 0, ws_ypixel: 0))
+    logger.info("[\(target.hostname, privacy: .public)] opening headless session (pid: \(session.pid), tty: \(session.tty))")
+    return session
+  }
+}
@@ -17,20 +17,39 @@ class HostWindow: Equatable {
     var disabledBackgroundColor: Terminal.Color?
   }
   
-  let tab: Terminal.Tab
+  let session: any HostSession
   let config: Config
   let host: Target
-  let tty: dev_t
   
-  // Terminal Tab + Socket Connection
-  var whenDone: (((any Error)?) -> Void)? = nil
-  var connection: DispatchIO? = nil
+  var tab: Terminal.Tab? { session.tab }
+  var tty: dev_t { session.tty }
+  
+  // Session + Socket Connection
+  // Set while the host is launching (see LaunchScheduler).
+  var launchId: LaunchScheduler.ID? = nil
+  // Set until the host connection presents it.
+  var token: SessionToken? = nil
+  var connection: HostConnection? = nil
+  // true for a relay session (see `Relay`).
+  var relay = false
+  // Last statistics reported by a relay (see `Relay`). nil for a host.
+  var relayStats: RelayStats? = nil
+  
+  var lagging: Bool { connection?.lagging ?? false }
   
   var enabled: Bool = true {
     didSet {
       if (oldValue != enabled) {
         setColors()
       }
+      // (Re-)enabling a lagging host is the user resuming its input.
+      // A relay forwards it to its own lagging hosts.
+      if enabled {
+        connection?.resume()
+        if relay {
+          connection?.send(.resume)
+        }
+      }
     }
   }
   
@@ -44,14 +63,14 @@ class HostWindow: Equatable {
     }
   }
   
-  init(tab: Terminal.Tab, host: Target, tty: dev_t, config: Config) {
-    self.tab = tab
+  init(session: any HostSession, host: Target, config: Config) {
+    self.session = session
     self.host = host
-    self.tty = tty
     self.config = config
   }
   
   private func setColors() {
+    guard let tab else { return }
     if selected {
       tab.setTextColor(color: config.selectedTextColor)
       tab.setBackgroundColor(color: config.selectedBackgroundColor)
@@ -65,14 +84,13 @@ class HostWindow: Equatable {
   }
   
   func terminate() {
-    connection?.close(flags: .stop)
+    connection?.close()
     connection = nil
-    // Closing window in case the profile does not close window automatically
-    // tab.close()
+    session.terminate()
   }
   
   static func == (lhs: HostWindow, rhs: HostWindow) -> Bool {
-    return lhs.host == rhs.host && lhs.tab == rhs.tab
+    return lhs.host == rhs.host && lhs.tty == rhs.tty
   }
 }
 
@@ -0,0 +1,107 @@
+//
+//  InputCoalescer.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Batches broadcast input, so a paste or a burst of keystrokes results in a few writes per host.
+///
+/// Input is passed through right away when idle: interactive typing is never delayed. Input received less than
+/// `budget` after the previous write is a burst: it is kept until `budget` after its first byte, or until `maxSize`
+/// bytes are pending. Chunks containing an escape sequence, and any pending input before them, are passed right away.
+/// A chunk is never split.
+///
+/// The coalescer does not own a timer: the owner flushes the pending input at `deadline` (see `advance()`),
+/// and before anything that must be ordered after the broadcast input (mode switch, per host input, probes…).
+final class InputCoalescer {
+
+  struct Options: Sendable {
+    // max delay added to input during bursts, in milliseconds. 0 to disable coalescing.
+    var budget: Int = 2
+    // pending input is written right away once it reaches this size.
+    var maxSize: Int = 16 * 1024
+  }
+
+  struct Statistics {
+    // chunks received, and writes passed to the output.
+    var chunks: UInt64 = 0
+    var writes: UInt64 = 0
+  }
+
+  let options: Options
+  private let clock: () -> UInt64
+
+  /// Write input to the hosts.
+  var output: (UnsafeRawBufferPointer) -> Void = { _ in }
+
+  private var pending = [UInt8]()
+  private var lastWrite: UInt64? = nil
+  /// Pending input must be written at this time (uptime ns). nil if there is no pending input.
+  private(set) var deadline: UInt64? = nil
+
+  private(set) var statistics = Statistics()
+
+  init(options: Options = Options(), clock: @escaping () -> UInt64 = { DispatchTime.now().uptimeNanoseconds }) {
+    self.options = options
+    self.clock = clock
+    pending.reserveCapacity(options.maxSize)
+  }
+
+  var pendingCount: Int { pending.count }
+
+  func append(_ bytes: UnsafeRawBufferPointer) {
+    guard !bytes.isEmpty else { return }
+    statistics.chunks += 1
+    let budget = UInt64(max(0, options.budget)) * NSEC_PER_MSEC
+    let now = clock()
+
+    // Idle: pass through.
+    if pending.isEmpty, budget == 0 || lastWrite.map({ now - $0 >= budget }) ?? true {
+      write(bytes, now: now)
+      return
+    }
+    // Escape sequences (arrows, function keys…) are not delayed.
+    if bytes.contains(0x1b) {
+      pending.append(contentsOf: bytes)
+      flush()
+      return
+    }
+    // Do not exceed the max size with this chunk.
+    if !pending.isEmpty, pending.count + bytes.count > options.maxSize {
+      flush()
+    }
+    pending.append(contentsOf: bytes)
+    if pending.count >= options.maxSize {
+      flush()
+    } else if deadline == nil {
+      deadline = now + budget
+    }
+  }
+
+  /// Write the pending input if its deadline is reached.
+  func advance() {
+    guard let deadline, clock() >= deadline else { return }
+    flush()
+  }
+
+  /// Write the pending input now.
+  func flush() {
+    deadline = nil
+    guard !pending.isEmpty else { return }
+    pending.withUnsafeBytes { write($0, now: clock()) }
+    pending.removeAll(keepingCapacity: true)
+  }
+
+  func resetStatistics() {
+    statistics = Statistics()
+  }
+
+  private func write(_ bytes: UnsafeRawBufferPointer, now: UInt64) {
+    statistics.writes += 1
+    lastWrite = now
+    output(bytes)
+  }
+}
@@ -0,0 +1,103 @@
+//
+//  LatencyReport.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Snapshot of the controller latency statistics.
+///
+/// All durations are in microseconds.
+struct LatencyReport: Encodable {
+
+  struct Summary: Encodable {
+    let count: UInt64
+    let mean: Double
+    let p50: Double
+    let p99: Double
+    let max: Double
+
+    init(_ histogram: Histogram) {
+      count = histogram.count
+      mean = histogram.mean / 1000
+      p50 = Double(histogram.percentile(50)) / 1000
+      p99 = Double(histogram.percentile(99)) / 1000
+      max = Double(histogram.max) / 1000
+    }
+  }
+
+  struct Host: Encodable {
+    let hostname: String
+    let port: UInt16?
+    let enabled: Bool
+    let lagging: Bool
+    let probePending: Bool
+    let latency: Summary
+    let queueDepth: Int
+    let queuedBytes: Int
+    let bytesForwarded: UInt64
+    let bytesDropped: UInt64
+    // Downstream statistics, for a relay.
+    let relay: RelayStats?
+  }
+
+  struct Input: Encodable {
+    // stdin chunks, and writes per host after coalescing.
+    let chunks: UInt64
+    let writes: UInt64
+  }
+
+  struct Launch: Encodable {
+    let spawn: Summary
+    let connect: Summary
+    let handshake: Summary
+    let total: Summary
+  }
+
+  let date: Date
+  let probeInterval: Int
+  let mainQueueDelay: Summary
+  let input: Input
+  let launch: Launch
+  let hosts: [Host]
+
+  init(_ ctrl: Controller) {
+    date = Date()
+    probeInterval = ctrl.settings.latencyProbeInterval
+    mainQueueDelay = Summary(ctrl.mainQueueDelay)
+    input = Input(chunks: ctrl.inputStatistics.chunks, writes: ctrl.inputStatistics.writes)
+    let timings = ctrl.launcher.timings
+    launch = Launch(spawn: Summary(timings.spawn), connect: Summary(timings.connect),
+                    handshake: Summary(timings.handshake), total: Summary(timings.total))
+    hosts = ctrl.hosts.compactMap { host in
+      guard let connection = host.connection else { return nil }
+      return Host(hostname: host.host.hostname,
+                  port: host.host.port,
+                  enabled: host.enabled,
+                  lagging: connection.lagging,
+                  probePending: connection.probePending,
+                  latency: Summary(connection.latency),
+                  queueDepth: connection.queueDepth,
+                  queuedBytes: connection.queuedBytes,
+                  bytesForwarded: connection.bytesForwarded,
+                  bytesDropped: connection.bytesDropped,
+                  relay: host.relayStats)
+    }
+  }
+
+  /// Write the report as JSON in the temporary directory.
+  /// - Returns: the report file URL.
+  func write() throws -> URL {
+    let encoder = JSONEncoder()
+    encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+    encoder.keyEncodingStrategy = .convertToSnakeCase
+    encoder.dateEncodingStrategy = .iso8601
+
+    let url = FileManager.default.temporaryDirectory
+      .appendingPathComponent("csshx-latency-\(getpid())-\(Int(date.timeIntervalSince1970)).json")
+    try encoder.encode(self).write(to: url, options: .atomic)
+    return url
+  }
+}
@@ -0,0 +1,212 @@
+//
+//  LaunchScheduler.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Hosts launch pipeline.
+///
+/// Each launch goes through `pending → spawned → connected → ready`, or ends in `timeout`/`failed`.
+/// At most `concurrency` launches are in flight (spawned but not ready), and at most `batchSize` hosts
+/// are spawned per pump, so the main queue keeps processing events while a large session is starting.
+///
+/// All launch deadlines are managed by a single timer wheel, advanced by the owner (see `advance()`).
+/// The scheduler does not touch windows or sockets itself, so it can be driven headless.
+final class LaunchScheduler {
+
+  typealias ID = Int
+
+  enum State: Equatable {
+    case pending
+    case spawned
+    case connected
+    case ready
+    case timeout
+    case failed
+  }
+
+  struct Options: Sendable {
+    // max launches in flight.
+    var concurrency: Int = 32
+    // max spawns per pump.
+    var batchSize: Int = 8
+    // spawn to ready timeout in milliseconds.
+    var timeout: Int = 5000
+    // timer wheel resolution in milliseconds.
+    var tick: Int = 50
+  }
+
+  /// Launch phases durations (ns).
+  struct Timings {
+    // pending → spawned (queueing + spawn)
+    var spawn = Histogram()
+    // spawned → connected (host connection accepted)
+    var connect = Histogram()
+    // connected → ready (hello received and matched)
+    var handshake = Histogram()
+    // pending → ready
+    var total = Histogram()
+  }
+
+  private struct Entry {
+    var state: State = .pending
+    var queued: UInt64
+    // spawn to ready timeout in milliseconds.
+    var timeout: Int
+    var spawned: UInt64 = 0
+    var connected: UInt64 = 0
+
+    var isDone: Bool {
+      state == .ready || state == .timeout || state == .failed
+    }
+  }
+
+  let options: Options
+  private let clock: () -> UInt64
+
+  /// Start the launch. Errors thrown fail the launch.
+  var spawn: (ID) throws -> Void = { _ in }
+  /// Called once per launch, when it reaches `ready` (nil error), `timeout` or `failed`.
+  var completion: (ID, (any Error)?) -> Void = { _, _ in }
+  /// Called each time the last pending launch is done.
+  var onIdle: () -> Void = {}
+
+  private var entries = [ID: Entry]()
+  private var pending = [ID]()
+  private var pendingHead = 0
+  private(set) var inflight = 0
+  private var wheel: TimerWheel<ID>
+  private var pumping = false
+  // true from enqueue until onIdle is called.
+  private var active = false
+
+  private(set) var timings = Timings()
+
+  var isIdle: Bool { pendingCount == 0 && inflight == 0 }
+  var pendingCount: Int { pending.count - pendingHead }
+
+  init(options: Options = Options(), clock: @escaping () -> UInt64 = { DispatchTime.now().uptimeNanoseconds }) {
+    self.options = options
+    self.clock = clock
+    wheel = TimerWheel(tick: UInt64(max(1, options.tick)) * NSEC_PER_MSEC, now: clock())
+  }
+
+  func state(of id: ID) -> State? {
+    entries[id]?.state
+  }
+
+  /// Queue launches.
+  /// - Parameter timeout: spawn to ready timeout in milliseconds, if not the default one.
+  func enqueue(_ ids: some Sequence<ID>, timeout: Int? = nil) {
+    let now = clock()
+    for id in ids {
+      // already launching
+      if let entry = entries[id], !entry.isDone { continue }
+      entries[id] = Entry(queued: now, timeout: timeout ?? options.timeout)
+      pending.append(id)
+      active = true
+    }
+    pump()
+  }
+
+  // MARK: Events
+  /// - Parameter time: when the host connection was accepted, if not now.
+  func didConnect(_ id: ID, at time: UInt64? = nil) {
+    guard var entry = entries[id], entry.state == .spawned else { return }
+    entry.connected = max(entry.spawned, time ?? clock())
+    entry.state = .connected
+    timings.connect.record(entry.connected - entry.spawned)
+    entries[id] = entry
+  }
+
+  func didBecomeReady(_ id: ID) {
+    guard var entry = entries[id], entry.state == .spawned || entry.state == .connected else { return }
+    let now = clock()
+    if entry.state == .connected {
+      timings.handshake.record(now - entry.connected)
+    }
+    timings.total.record(now - entry.queued)
+    entry.state = .ready
+    entries[id] = entry
+    finish(id, error: nil)
+  }
+
+  func didFail(_ id: ID, error: any Error) {
+    guard var entry = entries[id], !entry.isDone else { return }
+    let wasPending = entry.state == .pending
+    entry.state = .failed
+    entries[id] = entry
+    if wasPending {
+      // removed from the queue lazily by pump().
+      completion(id, error)
+      pump()
+    } else {
+      finish(id, error: error)
+    }
+  }
+
+  /// Process expired deadlines and start pending launches.
+  /// Must be called periodically (every `tick`) while the scheduler is not idle.
+  func advance() {
+    for id in wheel.advance(to: clock()) {
+      guard var entry = entries[id], entry.state == .spawned || entry.state == .connected else { continue }
+      logger.info("launch \(id) timeout (state: \(String(describing: entry.state), privacy: .public))")
+      entry.state = .timeout
+      entries[id] = entry
+      finish(id, error: POSIXError(.ETIMEDOUT))
+    }
+    pump()
+  }
+
+  // MARK: Pipeline
+  private func finish(_ id: ID, error: (any Error)?) {
+    wheel.cancel(id)
+    inflight -= 1
+    completion(id, error)
+    pump()
+  }
+
+  private func pump() {
+    // spawn may fail synchronously, and re-enter pump through didFail.
+    guard !pumping else { return }
+    pumping = true
+    defer {
+      pumping = false
+      if active, isIdle {
+        active = false
+        // Compact the queue storage
+        pending.removeAll(keepingCapacity: false)
+        pendingHead = 0
+        onIdle()
+      }
+    }
+
+    var spawned = 0
+    while spawned < options.batchSize, inflight < options.concurrency, pendingHead < pending.count {
+      let id = pending[pendingHead]
+      pendingHead += 1
+      guard var entry = entries[id], entry.state == .pending else { continue }
+
+      entry.state = .spawned
+      entry.spawned = clock()
+      entries[id] = entry
+      inflight += 1
+      spawned += 1
+      wheel.schedule(id, at: entry.spawned + UInt64(entry.timeout) * NSEC_PER_MSEC)
+      do {
+        try spawn(id)
+        let now = clock()
+        timings.spawn.record(now - entry.queued)
+        // the launch may already have progressed if spawn triggered events synchronously.
+        if entries[id]?.state == .spawned {
+          entries[id]?.spawned = now
+        }
+      } catch {
+        didFail(id, error: error)
+      }
+    }
+  }
+}
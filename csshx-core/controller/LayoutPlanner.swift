@@ -0,0 +1,375 @@
+//
+//  LayoutPlanner.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Pure host windows layout computation.
+///
+/// The planner dispatches hosts on screens, computes each screen grid and the target frame of each window.
+/// It does not touch any window, so it can be run (and tested) without Terminal. Applying a plan is done by the
+/// `WindowLayoutManager`, which uses a `Cache` to only update the windows whose frame actually changed.
+struct LayoutPlanner<ID: Hashable> {
+
+  struct Screen {
+    // Screen layout frame.
+    var frame: CGRect
+    // Space reserved at the bottom of the frame (for the controller window).
+    var reserved: CGFloat = 0
+    // Requested grid size, 0 for automatic. Columns take precedence over rows.
+    var rows: Int = 0
+    var columns: Int = 0
+
+    var hostsFrame: CGRect {
+      guard reserved > 0 else { return frame }
+      // Remove space reserved for controller window from screen frame
+      let (_, bounds) = frame.divided(atDistance: reserved, from: .minYEdge)
+      return bounds
+    }
+
+    var area: CGFloat { frame.width * frame.height }
+  }
+
+  struct Placement: Equatable {
+    let id: ID
+    // Index of the host in the planned hosts list.
+    let host: Int
+    let frame: CGRect
+  }
+
+  struct Plan {
+    var layout = HostLayout<ID>()
+    // Target window frames, screen by screen, from top to bottom.
+    var placements: [Placement] = []
+
+    // Grid of each screen, nil if no host is dispatched on this screen.
+    var grids: [HostGrid<ID>?] { layout.grids }
+  }
+
+  // Host window ratio (width / height), used to compute automatic grids. 0 if unknown.
+  var ratio: Double = 0
+
+  func plan(hosts: [ID], on screens: [Screen]) -> Plan {
+    var plan = Plan()
+    var grids = [HostGrid<ID>?]()
+    grids.reserveCapacity(screens.count)
+    plan.placements.reserveCapacity(hosts.count)
+
+    // compute surface of each screen and split host windows proportionally.
+    var totalArea = screens.reduce(0.0) { $0 + $1.area }
+
+    var dispatched = 0
+    for screen in screens {
+      guard dispatched < hosts.count, totalArea > 0 else {
+        grids.append(nil)
+        continue
+      }
+      // Compute count of hosts proportionally to the screen area.
+      let count = min(hosts.count - dispatched, Int(ceil(CGFloat(hosts.count - dispatched) * (screen.area / totalArea))))
+      let grid = Self.grid(hosts: hosts[dispatched..<(dispatched + count)], screen: screen, ratio: ratio)
+      if let grid {
+        Self.place(grid, offset: dispatched, in: screen.hostsFrame, into: &plan.placements)
+      }
+      grids.append(grid)
+
+      totalArea -= screen.area
+      dispatched += count
+    }
+    plan.layout = HostLayout(grids: grids)
+    return plan
+  }
+
+  static func grid(hosts: ArraySlice<ID>, screen: Screen, ratio: Double) -> HostGrid<ID>? {
+    guard !hosts.isEmpty else { return nil }
+
+    let count = hosts.count
+    if screen.columns > 0 {
+      let columns = min(screen.columns, count)
+      let rows = Int(ceil(Float(count) / Float(columns)))
+      return HostGrid.byRow(hosts: hosts, rows: rows, columns: columns)
+    } else if screen.rows > 0 {
+      let rows = min(screen.rows, count)
+      let columns = Int(ceil(Float(count) / Float(rows)))
+      return HostGrid.byColumns(hosts: hosts, rows: rows, columns: columns)
+    } else if (ratio > 0) {
+      let (rows, columns) = getBestLayout(for: ratio, hosts: count, on: screen.frame.size)
+      return HostGrid.byRow(hosts: hosts, rows: rows, columns: columns)
+    }
+    return nil
+  }
+
+  /// - Parameter offset: index of the first grid host in the planned hosts list.
+  static func place(_ grid: HostGrid<ID>, offset: Int, in bounds: CGRect, into placements: inout [Placement]) {
+    let width = bounds.width / CGFloat(grid.columns)
+    let height = bounds.height / CGFloat(grid.rows)
+
+    // Layout from top to bottom
+    var y = bounds.maxY - height
+    var host = offset
+    for row in 0..<grid.rowCount {
+      var x = bounds.minX
+      for id in grid.row(row) {
+        placements.append(Placement(id: id, host: host, frame: CGRect(x: x, y: y, width: width, height: height)))
+        host += 1
+        x += width
+      }
+      y -= height
+    }
+  }
+}
+
+// MARK: - Cache
+extension LayoutPlanner {
+
+  struct Changes {
+    // Windows not laid out before.
+    var added: [Placement] = []
+    // Windows whose frame changed since the last layout.
+    var moved: [Placement] = []
+
+    var isEmpty: Bool { added.isEmpty && moved.isEmpty }
+    var count: Int { added.count + moved.count }
+  }
+
+  /// Frames applied by the last layout passes.
+  struct Cache {
+    private var frames = [ID: CGRect]()
+
+    var count: Int { frames.count }
+
+    func frame(for id: ID) -> CGRect? {
+      frames[id]
+    }
+
+    /// Compute the changes required to apply `placements`, and record them as applied.
+    ///
+    /// Windows missing from `placements` are forgotten.
+    mutating func diff(_ placements: [Placement]) -> Changes {
+      var changes = Changes()
+      var next = [ID: CGRect](minimumCapacity: placements.count)
+      for placement in placements {
+        switch frames[placement.id] {
+          case nil: changes.added.append(placement)
+          case placement.frame: break
+          default: changes.moved.append(placement)
+        }
+        next[placement.id] = placement.frame
+      }
+      frames = next
+      return changes
+    }
+
+    /// Forget a window, so it is fully laid out on next pass.
+    mutating func invalidate(_ id: ID) {
+      frames[id] = nil
+    }
+
+    mutating func invalidateAll() {
+      frames.removeAll()
+    }
+  }
+}
+
+// MARK: - Grid
+/// Hosts grid of a single screen.
+///
+/// Hosts are stored in a flat row-major array, with an index of each host position, so lookups and neighbour
+/// navigation do not depend on the grid size.
+struct HostGrid<ID: Hashable> {
+  let rows: Int
+  let columns: Int
+
+  // Hosts, row by row.
+  let cells: [ID]
+  // Offset of each row in cells, followed by cells.count.
+  private let rowStarts: [Int]
+  private let positions: [ID: (row: Int, column: Int)]
+
+  var count: Int { cells.count }
+  // Non empty rows count, which may be less than rows.
+  var rowCount: Int { rowStarts.count - 1 }
+
+  // List of rows
+  var grid: [[ID]] { (0..<rowCount).map { Array(row($0)) } }
+
+  private init(rows: Int, columns: Int, cells: [ID], rowLengths: [Int]) {
+    self.rows = rows
+    self.columns = columns
+    self.cells = cells
+
+    var starts = [Int]()
+    starts.reserveCapacity(rowLengths.count + 1)
+    var positions = [ID: (row: Int, column: Int)](minimumCapacity: cells.count)
+    var offset = 0
+    for (row, length) in rowLengths.enumerated() {
+      starts.append(offset)
+      for column in 0..<length {
+        positions[cells[offset + column]] = (row, column)
+      }
+      offset += length
+    }
+    starts.append(offset)
+    rowStarts = starts
+    self.positions = positions
+  }
+
+  subscript(row: Int, column: Int) -> ID? {
+    guard row >= 0, row < rowCount, column >= 0 else { return nil }
+    let offset = rowStarts[row] + column
+    return offset < rowStarts[row + 1] ? cells[offset] : nil
+  }
+
+  func contains(_ host: ID) -> Bool {
+    positions[host] != nil
+  }
+
+  func position(of host: ID) -> (row: Int, column: Int)? {
+    positions[host]
+  }
+
+  func row(_ row: Int) -> ArraySlice<ID> {
+    guard row >= 0, row < rowCount else { return [] }
+    return cells[rowStarts[row]..<rowStarts[row + 1]]
+  }
+
+  func column(_ column: Int) -> [ID] {
+    (0..<rowCount).compactMap { self[$0, column] }
+  }
+
+  // resolve coords in grid (row, column).
+  //   -> compute next/previous by looking in the grid table.
+  func getHostAbove(_ host: ID) -> ID? {
+    // row above should always at least as large as the current row.
+    guard let (row, column) = position(of: host) else { return nil }
+    return self[row - 1, column]
+  }
+
+  func getHostBelow(_ host: ID) -> ID? {
+    guard let (row, column) = position(of: host) else { return nil }
+    return self[row + 1, column]
+  }
+
+  func getHostLeft(of host: ID) -> ID? {
+    guard let (row, column) = position(of: host) else { return nil }
+    return self[row, column - 1]
+  }
+
+  func getHostRight(of host: ID) -> ID? {
+    guard let (row, column) = position(of: host) else { return nil }
+    return self[row, column + 1]
+  }
+
+  // Host Grid factories
+  static func byRow(hosts: ArraySlice<ID>, rows: Int, columns: Int) -> Self {
+    // Simply fill rows until there is no more hosts
+    var lengths = Array(repeating: columns, count: hosts.count / columns)
+    if !hosts.count.isMultiple(of: columns) {
+      lengths.append(hosts.count % columns)
+    }
+    return HostGrid(rows: rows, columns: columns, cells: Array(hosts), rowLengths: lengths)
+  }
+
+  // populate by columns instead of populating by rows if row count requested
+  // i.e. 5 hosts in 4 columns mode will result in 1 full row of 4 hosts, and a second row with one host
+  // in rows mode, it should be 1 row with 2 hosts, and 3 rows with one host.
+  static func byColumns(hosts: ArraySlice<ID>, rows: Int, columns: Int) -> Self {
+    // count of hosts in the last column
+    let fullRows = hosts.count.isMultiple(of: rows) ? rows : hosts.count % rows
+
+    var lengths = [Int]()
+    var remaining = hosts.count
+    while remaining > 0 {
+      let length = min(remaining, lengths.count < fullRows ? columns : columns - 1)
+      lengths.append(length)
+      remaining -= length
+    }
+    return HostGrid(rows: rows, columns: columns, cells: Array(hosts), rowLengths: lengths)
+  }
+}
+
+// MARK: - Layout
+/// Grids of all screens, indexed by host.
+struct HostLayout<ID: Hashable> {
+
+  struct Position: Equatable {
+    let screen: Int
+    let row: Int
+    let column: Int
+  }
+
+  enum Direction {
+    case up, down, left, right
+  }
+
+  // Grid of each screen, nil if the screen has no host.
+  let grids: [HostGrid<ID>?]
+  private let screens: [ID: Int]
+
+  init(grids: [HostGrid<ID>?] = []) {
+    self.grids = grids
+    var screens = [ID: Int]()
+    for (screen, grid) in grids.enumerated() {
+      grid?.cells.forEach { screens[$0] = screen }
+    }
+    self.screens = screens
+  }
+
+  var count: Int { screens.count }
+
+  func position(of host: ID) -> Position? {
+    guard let screen = screens[host], let (row, column) = grids[screen]?.position(of: host) else { return nil }
+    return Position(screen: screen, row: row, column: column)
+  }
+
+  /// Host next to `host` in `direction`.
+  ///
+  /// Moving left (resp. right) from the first (resp. last) column continues on the same row of the previous
+  /// (resp. next) screen with hosts, screens being ordered as passed to the planner.
+  func neighbour(of host: ID, _ direction: Direction) -> ID? {
+    guard let position = position(of: host), let grid = grids[position.screen] else { return nil }
+    switch direction {
+      case .up: return grid.getHostAbove(host)
+      case .down: return grid.getHostBelow(host)
+      case .left:
+        if let next = grid.getHostLeft(of: host) { return next }
+        return screen(before: position.screen).flatMap { grid in
+          grid.row(min(position.row, grid.rowCount - 1)).last
+        }
+      case .right:
+        if let next = grid.getHostRight(of: host) { return next }
+        return screen(after: position.screen).flatMap { grid in
+          grid.row(min(position.row, grid.rowCount - 1)).first
+        }
+    }
+  }
+
+  private func screen(before screen: Int) -> HostGrid<ID>? {
+    grids[..<screen].last { $0 != nil } ?? nil
+  }
+
+  private func screen(after screen: Int) -> HostGrid<ID>? {
+    grids[(screen + 1)...].first { $0 != nil } ?? nil
+  }
+
+  // MARK: Range selection
+  /// Hosts on the same row as `host`.
+  func row(of host: ID) -> [ID] {
+    guard let position = position(of: host) else { return [] }
+    return Array(grids[position.screen]?.row(position.row) ?? [])
+  }
+
+  /// Hosts on the same column as `host`.
+  func column(of host: ID) -> [ID] {
+    guard let position = position(of: host) else { return [] }
+    return grids[position.screen]?.column(position.column) ?? []
+  }
+
+  /// Hosts on the same screen as `host`.
+  func screen(of host: ID) -> [ID] {
+    guard let screen = screens[host] else { return [] }
+    return grids[screen]?.cells ?? []
+  }
+}
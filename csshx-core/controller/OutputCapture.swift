@@ -0,0 +1,199 @@
+//
+//  OutputCapture.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Groups hosts with identical output, for the last command (see `InputMode.Diff`).
+///
+/// The output of each host is hashed as it is received, so grouping hundreds of hosts never requires to keep or
+/// compare their whole output. Only the first `sampleSize` bytes of each host output are kept, to show the variants.
+///
+/// A command starts each time Enter is broadcast. As hosts run an interactive shell, the first line of the command
+/// output (the end of the previous prompt, with the command echo) and its last incomplete line (the next prompt)
+/// are not part of the digest, so prompts including the hostname do not split the groups.
+final class OutputCapture<Key: Hashable> {
+
+  struct Variant {
+    let hosts: [Key]
+    // Output size, without the command echo and the prompt.
+    let size: Int
+    // First bytes of the output.
+    let sample: [UInt8]
+
+    var truncated: Bool { sample.count < size }
+  }
+
+  let sampleSize: Int
+  // Command line, as typed.
+  private(set) var command: String = ""
+  private var digests = [Key: OutputDigest]()
+
+  init(sampleSize: Int) {
+    self.sampleSize = max(0, sampleSize)
+  }
+
+  /// Start a new command. Output received until now is discarded.
+  func begin(command: String) {
+    self.command = command
+    digests.removeAll(keepingCapacity: true)
+  }
+
+  func append(_ bytes: UnsafeRawBufferPointer, from key: Key) {
+    digests[key, default: OutputDigest(sampleSize: sampleSize)].append(bytes)
+  }
+
+  func remove(_ key: Key) {
+    digests[key] = nil
+  }
+
+  /// Group hosts by output, largest group first. Hosts without output are grouped together.
+  func variants(of keys: some Sequence<Key>) -> [Variant] {
+    struct Group {
+      var hosts: [Key]
+      let digest: OutputDigest
+    }
+    let empty = OutputDigest(sampleSize: 0)
+    var groups = [Group]()
+    var index = [OutputDigest.Value: Int]()
+    for key in keys {
+      let digest = digests[key] ?? empty
+      if let idx = index[digest.value] {
+        groups[idx].hosts.append(key)
+      } else {
+        index[digest.value] = groups.count
+        groups.append(Group(hosts: [key], digest: digest))
+      }
+    }
+    // Stable: groups of the same size keep the order of their first host.
+    return groups.enumerated()
+      .sorted { $0.element.hosts.count > $1.element.hosts.count || ($0.element.hosts.count == $1.element.hosts.count && $0.offset < $1.offset) }
+      .map { Variant(hosts: $0.element.hosts, size: $0.element.digest.size, sample: $0.element.digest.sample) }
+  }
+}
+
+/// Incremental digest of a host output, by lines.
+struct OutputDigest {
+
+  struct Value: Hashable {
+    let hash: UInt64
+    let size: Int
+  }
+
+  private let sampleSize: Int
+  // Digest of the complete lines (sequence of lines hashes), and of the current line.
+  private var lines = StreamHasher()
+  private var line = StreamHasher()
+  // true until the end of the first line (command echo).
+  private var echo = true
+  // Bytes of the complete lines.
+  private(set) var size = 0
+  private var kept = [UInt8]()
+
+  init(sampleSize: Int) {
+    self.sampleSize = sampleSize
+  }
+
+  var value: Value { Value(hash: lines.finalize(), size: size) }
+
+  // First bytes of the complete lines.
+  var sample: [UInt8] { Array(kept.prefix(size)) }
+
+  mutating func append(_ bytes: UnsafeRawBufferPointer) {
+    guard let base = bytes.baseAddress else { return }
+    var offset = 0
+    while offset < bytes.count {
+      let newline = memchr(base + offset, 0x0a, bytes.count - offset)
+      let end = newline.map { base.distance(to: UnsafeRawPointer($0)) + 1 } ?? bytes.count
+      defer { offset = end }
+
+      if echo {
+        echo = newline == nil
+        continue
+      }
+      let chunk = UnsafeRawBufferPointer(rebasing: bytes[offset..<end])
+      line.update(chunk)
+      if kept.count < sampleSize {
+        kept.append(contentsOf: chunk.prefix(sampleSize - kept.count))
+      }
+      if newline != nil {
+        size += line.count
+        lines.combine(line.finalize())
+        line = StreamHasher()
+      }
+    }
+  }
+}
+
+/// Incremental 64-bit hash. Not cryptographic.
+///
+/// Input is processed 8 bytes at a time, and the result does not depend on how the input is split across `update` calls.
+struct StreamHasher {
+
+  private static let multiplier: UInt64 = 0x9E37_79B9_7F4A_7C15
+
+  private var state: UInt64 = 0x243F_6A88_85A3_08D3
+  // Bytes not yet mixed (less than a word), little endian.
+  private var tail: UInt64 = 0
+  private var tailCount = 0
+  private(set) var count = 0
+
+  mutating func update(_ bytes: UnsafeRawBufferPointer) {
+    count += bytes.count
+    var offset = 0
+    // Complete the pending word first.
+    if tailCount > 0 {
+      while tailCount < 8, offset < bytes.count {
+        tail |= UInt64(bytes[offset]) << (tailCount * 8)
+        tailCount += 1
+        offset += 1
+      }
+      guard tailCount == 8 else { return }
+      mix(tail)
+      tail = 0
+      tailCount = 0
+    }
+    while offset + 8 <= bytes.count {
+      mix(UInt64(littleEndian: bytes.loadUnaligned(fromByteOffset: offset, as: UInt64.self)))
+      offset += 8
+    }
+    while offset < bytes.count {
+      tail |= UInt64(bytes[offset]) << (tailCount * 8)
+      tailCount += 1
+      offset += 1
+    }
+  }
+
+  /// Mix a whole word, as if it was 8 bytes of input. Only valid on word boundaries.
+  mutating func combine(_ value: UInt64) {
+    precondition(tailCount == 0)
+    count += 8
+    mix(value)
+  }
+
+  func finalize() -> UInt64 {
+    var hash = state
+    if tailCount > 0 {
+      hash = Self.mix(hash, tail)
+    }
+    // murmur3 finalizer, with the input length.
+    hash ^= UInt64(count)
+    hash ^= hash >> 33
+    hash &*= 0xFF51_AFD7_ED55_8CCD
+    hash ^= hash >> 33
+    hash &*= 0xC4CE_B9FE_1A85_EC53
+    hash ^= hash >> 33
+    return hash
+  }
+
+  private mutating func mix(_ word: UInt64) {
+    state = Self.mix(state, word)
+  }
+
+  private static func mix(_ state: UInt64, _ word: UInt64) -> UInt64 {
+    ((state << 23 | state >> 41) ^ word) &* multiplier
+  }
+}
@@ -0,0 +1,198 @@
+//
+//  Relay.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Fan-out relay between a controller and a shard of its hosts (csshx -- relay).
+///
+/// From the controller point of view, a relay is a host: it runs in a session opened by the controller, connects to
+/// the controller socket, and presents its session token. It runs its own headless controller, which launches and
+/// serves the shard hosts on its own socket (launch pipeline, flow control and latency probes), so the fan-out cost
+/// is spread across the relay processes.
+///
+/// Input received from the controller is encoded once, and enqueued for all the shard hosts. It is only acknowledged
+/// once processed by the slowest shard host, so the controller queue for the relay grows with it, and the controller
+/// limits and overflow policy apply to the relay as a whole.
+/// A shard host that overflows its own queue lags (it has no UI to be re-enabled), and no longer holds the relay
+/// credits. It is resumed when the user enables the relay host again in the controller.
+/// Pings are answered right away, followed by the relay statistics.
+final class Relay {
+
+  private let ctrl: Controller
+  private let upstream: DispatchIO
+  private var decoder = FrameDecoder()
+  private var ready = false
+  private var closed = false
+
+  // Input bytes received from the controller, and acknowledged to it.
+  private(set) var received: UInt64 = 0
+  private var credited: UInt64 = 0
+  private var crediting = false
+
+  init(socket: String, settings: Settings) throws {
+    let fd = try Socket.connect(socket)
+    upstream = DispatchIO(type: .stream,
+                          fileDescriptor: fd,
+                          queue: .main,
+                          cleanupHandler: { error in
+      Darwin.close(fd)
+      // terminate the process
+      Foundation.exit(0)
+    })
+    // Forward input in real-time. Do not buffer it.
+    upstream.setLimit(lowWater: 1)
+
+    let path = FileManager.default.temporaryDirectory.appendingPathComponent("csshx.\(UUID()).sock").path
+    ctrl = try Controller(tab: nil, socket: path, settings: settings)
+  }
+
+  /// Launch the shard hosts, and connect to the controller once they are all launched,
+  /// so no input is sent before the hosts are ready to receive it.
+  func start(_ targets: [Target], token: SessionToken) throws {
+    try ctrl.listen()
+    // No host left: the controller will terminate the relay session.
+    ctrl.onClose = { [self] in close() }
+    ctrl.onDrain = { [self] in scheduleCredits() }
+
+    upstream.read { [self] data in
+      do {
+        try decoder.decode(data) { frame in
+          try process(frame)
+        }
+      } catch {
+        logger.error("failed to process controller input: \(error, privacy: .public)")
+        close()
+      }
+    } whenDone: { [self] error in
+      if let error {
+        logger.error("controller socket read failed with error: \(error, privacy: .public)")
+      }
+      close()
+    }
+
+    let group = DispatchGroup()
+    targets.forEach { _ in group.enter() }
+    ctrl.add(hosts: targets) { host, error in
+      if let error {
+        logger.error("error while starting host \(host.hostname, privacy: .public): \(error)")
+      }
+      group.leave()
+    }
+    group.notify(queue: .main) { [self] in
+      logger.info("relay: \(self.ctrl.hosts.count) hosts started -> connecting controller")
+      ctrl.startProbing()
+      send(.hello(version: Wire.version, pid: getpid(), token: token))
+    }
+  }
+
+  func close() {
+    guard !closed else { return }
+    closed = true
+    ctrl.close()
+    upstream.close(flags: .stop)
+  }
+
+  var stats: RelayStats {
+    var stats = RelayStats(received: received)
+    stats.queued = UInt64(ctrl.pendingInput)
+    var latency = Histogram()
+    for host in ctrl.hosts {
+      guard let connection = host.connection else { continue }
+      stats.hosts += 1
+      stats.queued += UInt64(connection.queuedBytes)
+      stats.forwarded += connection.bytesForwarded
+      stats.dropped += connection.bytesDropped
+      latency.merge(connection.latency)
+    }
+    stats.latencyP50 = latency.percentile(50)
+    stats.latencyP99 = latency.percentile(99)
+    return stats
+  }
+
+  private func send(_ frame: Frame) {
+    upstream.write(frame.data()) { error in }
+  }
+
+  // Shard hosts acknowledge input chunk by chunk: coalesce them into a single pass.
+  private func scheduleCredits() {
+    guard !crediting else { return }
+    crediting = true
+    DispatchQueue.main.asyncUnsafe { [self] in
+      crediting = false
+      releaseCredits()
+    }
+  }
+
+  /// Acknowledge the input processed by all the shard hosts that are not lagging.
+  private func releaseCredits() {
+    guard ready, !closed else { return }
+    // Read first: it waits for the input sent before to be enqueued for the hosts.
+    var outstanding = UInt64(ctrl.pendingInput)
+    outstanding += ctrl.hosts.lazy
+      .filter(\.enabled)
+      .compactMap(\.connection)
+      .filter { !$0.lagging }
+      .map { UInt64($0.queuedBytes) }
+      .max() ?? 0
+    let processed = received - min(received, outstanding)
+    guard processed > credited else { return }
+    send(.credit(UInt32(processed - credited)))
+    credited = processed
+  }
+
+  private func process(_ frame: Frame) throws {
+    switch frame {
+      case .hello(let version, _, _):
+        guard version == Wire.version else {
+          throw WireError.unsupportedVersion(version)
+        }
+        logger.info("relay ready")
+        ready = true
+
+      case .input(let bytes):
+        guard ready else {
+          throw WireError.invalidPayload(.input)
+        }
+        received += UInt64(bytes.count)
+        ctrl.send(bytes: bytes)
+        // Acknowledged once processed by the hosts.
+        scheduleCredits()
+
+      case .resize:
+        // Hosts sessions keep their own size.
+        break
+
+      case .ping(let id, let timestamp):
+        send(.pong(id: id, timestamp: timestamp, received: DispatchTime.now().uptimeNanoseconds))
+        send(.relayStats(stats))
+
+      case .resume:
+        logger.info("relay: resuming hosts")
+        ctrl.enable(hosts: Set(ctrl.hosts.map(\.id)))
+
+      case .pong, .status, .credit, .relayStats, .output:
+        logger.warning("discarding unexpected frame: \(frame.type.rawValue)")
+    }
+  }
+
+  /// Split hosts in at most `count` shards of consecutive hosts, of equal size (± 1).
+  static func shard(_ hosts: [Target], count: Int) -> [[Target]] {
+    let count = min(max(1, count), hosts.count)
+    guard count > 0 else { return [] }
+    let size = hosts.count / count
+    let remainder = hosts.count % count
+    var shards = [[Target]]()
+    shards.reserveCapacity(count)
+    var start = 0
+    for idx in 0..<count {
+      let end = start + size + (idx < remainder ? 1 : 0)
+      shards.append(Array(hosts[start..<end]))
+      start = end
+    }
+    return shards
+  }
+}
@@ -14,7 +14,7 @@ protocol InputModeProtocol: Equatable, Identifiable<String> {
   
   mutating func prompt(_ ctrl :Controller) -> String
   mutating func onEnable(_ ctrl :Controller) throws -> Void
-  mutating func parse(input: inout [UInt8], _ ctrl :Controller) throws -> (any InputModeProtocol)?
+  mutating func parse(input: inout InputBuffer, _ ctrl :Controller) throws -> (any InputModeProtocol)?
 }
 
 extension InputModeProtocol {
@@ -46,7 +46,7 @@ extension InputMode {
       // noop
     }
     
-    func parse(input: inout [UInt8], _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
       // Discarding all input until ready.
       input.removeAll()
       return nil
@@ -64,14 +64,16 @@ extension InputMode {
     var raw: Bool { true }
     
     func prompt(_ ctrl: Controller) -> String {
-      "Input to terminal: (Ctrl-\(ctrl.settings.actionKey.ascii) to enter control mode)\r\n"
+      let lagging = ctrl.hosts.count(where: \.lagging)
+      return "Input to terminal: (Ctrl-\(ctrl.settings.actionKey.ascii) to enter control mode)\r\n" +
+      (lagging > 0 ? "\(lagging) host(s) lagging behind, input is dropped for them until enabled again\r\n" : "")
     }
     
     func onEnable(_ ctrl: Controller) throws {
       // noop
     }
     
-    func parse(input: inout [UInt8], _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
       // In input mode, data is always fully consummed.
       let action = ctrl.settings.actionKey
       // Convert CSI to SS3 cursor codes
@@ -83,18 +85,15 @@ extension InputMode {
       if let escape = input.firstIndex(of: action.value) {
         // Send data until escape sequence.
         if (escape > 0) {
-          ctrl.send(bytes: input[0..<escape])
-          // drop sent data + escape sequence
-          input.removeSubrange(0...escape)
-        } else {
-          input.removeFirst()
+          input.consume(escape) { ctrl.send(bytes: $0) }
         }
+        // drop escape sequence
+        input.removeFirst()
         // Switch mode
         return InputMode.Action()
       } else {
         // Forward all
-        ctrl.send(bytes: input)
-        input.removeAll()
+        input.consume(input.count) { ctrl.send(bytes: $0) }
       }
       return nil
     }
@@ -117,15 +116,18 @@ extension InputMode {
       "[c]reate window, [r]etile, s[o]rt, [e]nable/disable input, e[n]able all, " +
       // If there is a single host enabled, add the 'select next' option.
       (ctrl.hosts.count > 1 && ctrl.hosts.count(where: { $0.enabled }) == 1 ? "[Space] Enable next " : "") +
-      "[t]oggle enabled, [m]inimise, [h]ide, [s]end text, change [b]ounds, " +
-      "change [g]rid, e[x]it\r\n";
+      "[t]oggle enabled, [m]inimise, [h]ide, [s]end text, [p]ush file, change [b]ounds, " +
+      "change [g]rid, [l]atency stats, " +
+      (ctrl.capture != nil ? "[d]iff output, " : "") +
+      (ctrl.settings.sessionBackend == .headless ? "[a]ttach to host, " : "") +
+      "e[x]it\r\n";
     }
     
     func onEnable(_ ctrl: Controller) throws {
       // noop
     }
     
-    func parse(input: inout [UInt8], _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
       if ctrl.settings.actionKey.value ~= input {
         ctrl.send(bytes: [ctrl.settings.actionKey.value])
         return InputMode.Input()
@@ -138,7 +140,8 @@ extension InputMode {
       
       // retile
       else if "r" ~= input {
-        ctrl.layout()
+        // windows may have been moved manually
+        ctrl.layout(force: true)
         return InputMode.Input()
       }
       
@@ -155,7 +158,7 @@ extension InputMode {
       // enable all
       else if "n" ~= input {
         ctrl.hosts.forEach {
-          $0.tab.window.zoomed = false
+          $0.tab?.window.zoomed = false
           $0.enabled = true
         }
         return InputMode.Input()
@@ -164,7 +167,7 @@ extension InputMode {
       // toggle enabled
       else if "t" ~= input {
         ctrl.hosts.forEach {
-          $0.tab.window.zoomed = false
+          $0.tab?.window.zoomed = false
           $0.enabled = !$0.enabled
         }
         return InputMode.Input()
@@ -172,13 +175,13 @@ extension InputMode {
       
       // Minimize
       else if "m" ~= input {
-        ctrl.hosts.forEach { $0.tab.miniaturize() }
+        ctrl.hosts.forEach { $0.tab?.miniaturize() }
         return InputMode.Input()
       }
       
       // Hide
       else if "h" ~= input {
-        ctrl.hosts.forEach { $0.tab.hide() }
+        ctrl.hosts.forEach { $0.tab?.hide() }
         return InputMode.Input()
       }
       
@@ -187,6 +190,11 @@ extension InputMode {
         return InputMode.SendString()
       }
       
+      // Push file
+      else if "p" ~= input {
+        return InputMode.PushFile()
+      }
+      
       // Change bounds
       else if "b" ~= input {
         return InputMode.Bounds()
@@ -197,6 +205,21 @@ extension InputMode {
         return InputMode.Grid()
       }
       
+      // Latency statistics
+      else if "l" ~= input {
+        return InputMode.Stats()
+      }
+      
+      // Captured output variants
+      else if ctrl.capture != nil, "d" ~= input {
+        return InputMode.Diff()
+      }
+      
+      // Attach to an headless session
+      else if ctrl.settings.sessionBackend == .headless, "a" ~= input {
+        return InputMode.Attach()
+      }
+      
       else if " " ~= input, ctrl.hosts.count > 1, ctrl.hosts.count(where: { $0.enabled }) == 1 {
         if let idx = ctrl.hosts.firstIndex(where: { $0.enabled }) {
           ctrl.hosts[idx].enabled = false
@@ -245,7 +268,7 @@ extension InputMode {
       
     }
     
-    func parse(input: inout [UInt8], _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
       // hostname
       if "h" ~= input {
         ctrl.hosts.forEach { host in
@@ -273,7 +296,9 @@ extension InputMode {
       // Window ID
       else if "i" ~= input {
         ctrl.hosts.forEach { host in
-          guard let wid = String(host.tab.windowId).data(using: .utf8) else {
+          // headless sessions have no window
+          guard let tab = host.tab else { return }
+          guard let wid = String(tab.windowId).data(using: .utf8) else {
             logger.warning("failed to encode window ID into UTF8 data")
             return
           }
@@ -302,6 +327,98 @@ extension InputMode {
   }
 }
 
+// MARK: -
+extension InputMode {
+
+  /// Push a local file to all active windows. Asks for the local path, then for the remote path.
+  struct PushFile: InputModeProtocol {
+
+    // Local file, once entered.
+    private var path: String? = nil
+
+    var id: String { path == nil ? "push-file" : "push-file-destination" }
+
+    var raw: Bool { false }
+
+    func prompt(_ ctrl: Controller) -> String {
+      guard let path else {
+        return "Push file to all active windows: "
+      }
+      return "Remote path for \((path as NSString).lastPathComponent) (empty to send it as input): "
+    }
+
+    func onEnable(_ ctrl: Controller) throws {
+
+    }
+
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+      // If data contains an escape char -> discard all data
+      if input.contains(27) {
+        input.removeAll()
+        return InputMode.Input()
+      }
+      let line = String(decoding: input.bytes, as: UTF8.self).trimmingCharacters(in: .whitespacesAndNewlines)
+      input.removeAll()
+
+      guard let path else {
+        let local = (line as NSString).expandingTildeInPath
+        guard !line.isEmpty, FileManager.default.isReadableFile(atPath: local) else {
+          beep()
+          return InputMode.Input()
+        }
+        return PushFile(path: local)
+      }
+
+      do {
+        try ctrl.push(file: path, to: line.isEmpty ? .input : .file(line))
+      } catch {
+        logger.warning("failed to push \(path, privacy: .public): \(error, privacy: .public)")
+        beep()
+        return InputMode.Input()
+      }
+      return InputMode.Pushing()
+    }
+  }
+
+  /// File push in progress. Input is discarded, so it cannot be interleaved with the file content.
+  struct Pushing: InputModeProtocol {
+
+    var id: String { "pushing" }
+
+    var raw: Bool { true }
+
+    func prompt(_ ctrl: Controller) -> String {
+      guard let push = ctrl.filePush else { return "" }
+      let target = switch push.destination {
+        case .input: "input"
+        case .file(let path): path
+      }
+      return "Pushing \(push.name) (\(push.payloadSize) bytes) to \(push.hostCount) host(s) as \(target): " +
+      "\(Int(push.progress * 100))% (Esc to cancel)\r\n" +
+      (push.failed > 0 ? "\(push.failed) host(s) lost\r\n" : "")
+    }
+
+    func onEnable(_ ctrl: Controller) throws {
+      // noop
+    }
+
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+      if 0x1b ~= input {
+        // escape (\e)
+        if input.dropEscapeSequence() {
+          beep()
+          return nil
+        }
+        ctrl.cancelPush()
+        return InputMode.Input()
+      }
+      input.removeAll()
+      beep()
+      return nil
+    }
+  }
+}
+
 // MARK: -
 extension InputMode {
   
@@ -320,7 +437,7 @@ extension InputMode {
       
     }
     
-    func parse(input: inout [UInt8], _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
       // hostname
       if "h" ~= input {
         ctrl.hosts.sort { h1, h2 in
@@ -334,7 +451,7 @@ extension InputMode {
       // Window ID (should match original order as window ID are increasing)
       else if "i" ~= input {
         ctrl.hosts.sort { h1, h2 in
-          h1.tab.windowId < h2.tab.windowId
+          (h1.tab?.windowId ?? 0) < (h2.tab?.windowId ?? 0)
         }
         ctrl.layout()
         return InputMode.Input()
@@ -377,14 +494,14 @@ extension InputMode {
 
     }
 
-    func parse(input: inout [UInt8], _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
       // If data contains an escape char -> discard all data
       // This is different from original csshx which only discard data up to the escape char.
       if input.contains(27) {
         input.removeAll()
         return InputMode.Input()
       }
-      guard let hostname = String(bytes: input, encoding: .utf8) else {
+      guard let hostname = String(bytes: input.bytes, encoding: .utf8) else {
         input.removeAll()
         beep()
         return nil
@@ -394,7 +511,7 @@ extension InputMode {
 
       let (user, host, p) = try hostname.trimmingCharacters(in: .whitespacesAndNewlines).parseUserHostPort()
       let target = Target(user: user, hostname: host, port: p.flatMap(UInt16.init), command: nil)
-      try ctrl.add(host: target) { error in
+      ctrl.add(host: target) { error in
         if let error {
           logger.warning("error while starting host \(target.connectionString, privacy: .public): \(error, privacy: .public)")
         } else {
@@ -406,6 +523,152 @@ extension InputMode {
   }
 }
 
+// MARK: - Headless Sessions
+extension InputMode {
+
+  struct Attach: InputModeProtocol {
+
+    var id: String { "attach" }
+
+    var raw: Bool { false }
+
+    func prompt(_ ctrl: Controller) -> String {
+      "Attach to host (1-\(ctrl.hosts.count) or hostname): "
+    }
+
+    func onEnable(_ ctrl: Controller) throws {
+
+    }
+
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+      // If data contains an escape char -> discard all data
+      if input.contains(27) {
+        input.removeAll()
+        return InputMode.Input()
+      }
+      let name = String(decoding: input.bytes, as: UTF8.self).trimmingCharacters(in: .whitespacesAndNewlines)
+      input.removeAll()
+
+      let host: HostWindow?
+      if let idx = Int(name) {
+        host = ctrl.hosts.indices.contains(idx - 1) ? ctrl.hosts[idx - 1] : nil
+      } else {
+        host = ctrl.hosts.first { $0.host.hostname == name || $0.host.connectionString == name }
+      }
+      guard let host, host.session is HeadlessSession else {
+        beep()
+        return InputMode.Input()
+      }
+      return InputMode.Attached(host: host)
+    }
+  }
+
+  /// Show the output of an headless session, and forward input to this session only.
+  struct Attached: InputModeProtocol {
+
+    let host: HostWindow
+
+    var id: String { "attached" }
+
+    var raw: Bool { true }
+
+    private var session: HeadlessSession? { host.session as? HeadlessSession }
+
+    // Prompt clears the screen -> replay the session recent output.
+    func prompt(_ ctrl: Controller) -> String {
+      "Attached to \(host) (Ctrl-\(ctrl.settings.actionKey.ascii) to detach)\r\n" +
+      String(decoding: session?.output.bytes ?? [], as: UTF8.self)
+    }
+
+    func onEnable(_ ctrl: Controller) throws {
+      session?.onOutput = { data in
+        for region in data.regions {
+          region.withUnsafeBytes { bytes in
+            _ = fwrite(bytes.baseAddress, 1, bytes.count, stdout)
+          }
+        }
+        fflush(stdout)
+      }
+    }
+
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+      guard let escape = input.firstIndex(of: ctrl.settings.actionKey.value) else {
+        input.consume(input.count) { ctrl.send(bytes: $0, to: host) }
+        return nil
+      }
+      if escape > 0 {
+        input.consume(escape) { ctrl.send(bytes: $0, to: host) }
+      }
+      input.removeFirst()
+      // Detach
+      session?.onOutput = nil
+      return InputMode.Input()
+    }
+  }
+}
+
+// MARK: -
+// diff mode: hosts grouped by output of the last command, refreshed on each latency probe.
+extension InputMode {
+
+  struct Diff: InputModeProtocol {
+
+    var id: String { "diff" }
+
+    var raw: Bool { true }
+
+    // Max number of variants shown. Largest groups first.
+    private static let maxVariants = 5
+    // Max number of hosts listed, and of output lines shown, per variant.
+    private static let maxHosts = 8
+    private static let maxLines = 20
+
+    func prompt(_ ctrl: Controller) -> String {
+      guard let capture = ctrl.capture else { return "" }
+
+      let hosts = ctrl.hosts.filter { $0.connection != nil }
+      let variants = capture.variants(of: hosts.map(\.id))
+      var str = "Output of '\(capture.command)' on \(hosts.count) host(s): \(variants.count) variant(s) (Esc to exit)\r\n"
+      for variant in variants.prefix(Self.maxVariants) {
+        let names = variant.hosts.prefix(Self.maxHosts).compactMap { ctrl.host(id: $0)?.description }
+        str += "\r\n---------------- \(variant.hosts.count) host(s): \(names.joined(separator: ", "))" +
+        (variant.hosts.count > Self.maxHosts ? ", …" : "") + "\r\n"
+
+        let lines = variant.sample.split(separator: 0x0a, omittingEmptySubsequences: false)
+        for line in lines.prefix(Self.maxLines) where !line.isEmpty {
+          str += String(decoding: line.last == 0x0d ? line.dropLast() : line, as: UTF8.self) + "\r\n"
+        }
+        if lines.count > Self.maxLines || variant.truncated {
+          str += "[… \(variant.size) bytes]\r\n"
+        }
+      }
+      if variants.count > Self.maxVariants {
+        str += "\r\n… \(variants.count - Self.maxVariants) more variant(s)\r\n"
+      }
+      return str
+    }
+
+    func onEnable(_ ctrl: Controller) throws {
+      // noop
+    }
+
+    func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+      if 0x1b ~= input {
+        // escape (\e)
+        if input.dropEscapeSequence() {
+          // if is escape sequence -> delete it and beep.
+          beep()
+          return nil
+        }
+        return InputMode.Input()
+      }
+      input.removeAll()
+      beep()
+      return nil
+    }
+  }
+}
+
 // MARK: - Window Layout Management
 
 // TODO: multi screen support -> add an keystroke to move to the next screen (maybe tab).
@@ -460,96 +723,111 @@ extension InputMode {
 
     private var screen: Screen? = nil
 
-    var selection: HostWindow? = nil {
+    // Host window moved by arrow keys.
+    private var cursor: HostWindow? = nil
+
+    var selection: [HostWindow] = [] {
       didSet {
-        oldValue?.selected = false
-        selection?.selected = true
+        let selected = Set(selection.map(\.id))
+        oldValue.forEach { if !selected.contains($0.id) { $0.selected = false } }
+        selection.forEach { $0.selected = true }
       }
     }
 
     func prompt(_ ctrl: Controller) -> String {
       "Select window with Arrow keys or i,j,k,l: (Esc to exit)\r\n" +
+      "select [r]ow, [c]olumn, [s]creen, [a]ll\r\n" +
       "[e]nable input, [d]isable input, disable [o]thers, disable [O]thers and zoom, [t]oggle input\r\n"
     }
 
     mutating func onEnable(_ ctrl: Controller) throws {
-      ctrl.hosts.forEach { $0.tab.window.zoomed = false }
+      ctrl.hosts.forEach { $0.tab?.window.zoomed = false }
       // select first host window
-      selection = ctrl.hosts.first
+      move(to: ctrl.hosts.first)
 
       // default to controller screen
       screen = ctrl.controllerScreen
     }
 
-    mutating func parse(input: inout [UInt8], _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+    private mutating func move(to host: HostWindow?) {
+      cursor = host
+      selection = host.map { [$0] } ?? []
+    }
+
+    private mutating func move(_ direction: HostLayout<HostWindow.ID>.Direction, _ ctrl: Controller) {
+      guard let cursor else { return }
+      if let next = ctrl.windowManager.grid.neighbour(of: cursor.id, direction).flatMap(ctrl.host(id:)) {
+        move(to: next)
+      } else if selection.count > 1 {
+        // collapse a range selection to the cursor
+        move(to: cursor)
+      }
+    }
+
+    private mutating func select(_ ids: [HostWindow.ID], _ ctrl: Controller) {
+      guard !ids.isEmpty else { return }
+      selection = ids.compactMap(ctrl.host(id:))
+    }
+
+    mutating func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
       // ↑
       if "i" ~= input || "\u{1b}[A" ~= input {
-        if let selected = selection,
-           let next = screen?.getHostAbove(selected.id).flatMap({ hid in
-             ctrl.hosts.first { $0.id == hid }
-           }) {
-          selection = next
-        }
+        move(.up, ctrl)
       }
       // ↓
       else if "k" ~= input || "\u{1b}[B" ~= input {
-        if let selected = selection,
-           let next = screen?.getHostBelow(selected.id).flatMap({ hid in
-             ctrl.hosts.first { $0.id == hid }
-           }) {
-          selection = next
-        }
+        move(.down, ctrl)
       }
       // →
       else if "l" ~= input || "\u{1b}[C" ~= input {
-        if let selected = selection,
-           let next = screen?.getHostRight(of: selected.id).flatMap({ hid in
-             ctrl.hosts.first { $0.id == hid }
-           }) {
-          selection = next
-        }
+        move(.right, ctrl)
       }
       // ←
       else if "j" ~= input || "\u{1b}[D" ~= input {
-        if let selected = selection,
-           let next = screen?.getHostLeft(of: selected.id).flatMap({ hid in
-             ctrl.hosts.first { $0.id == hid }
-           }) {
-          selection = next
-        }
+        move(.left, ctrl)
+      }
+
+      // range selection
+      else if "r" ~= input {
+        if let cursor { select(ctrl.windowManager.grid.row(of: cursor.id), ctrl) }
+      }
+      else if "c" ~= input {
+        if let cursor { select(ctrl.windowManager.grid.column(of: cursor.id), ctrl) }
+      }
+      else if "s" ~= input {
+        if let cursor { select(ctrl.windowManager.grid.screen(of: cursor.id), ctrl) }
+      }
+      else if "a" ~= input {
+        selection = ctrl.hosts
       }
 
       else if "e" ~= input {
-        selection?.enabled = true
+        selection.forEach { $0.enabled = true }
       }
 
       else if "d" ~= input {
-        selection?.enabled = false
+        selection.forEach { $0.enabled = false }
       }
 
       else if "t" ~= input {
-        if let selected = selection {
-          selected.enabled = !selected.enabled
-        }
+        selection.forEach { $0.enabled = !$0.enabled }
       }
 
       // disable others
       else if "o" ~= input {
-        if let selected = selection {
+        if !selection.isEmpty {
+          let selected = Set(selection.map(\.id))
           ctrl.hosts.forEach {
-            if ($0 != selected) {
-              $0.enabled = false
-            }
+            $0.enabled = selected.contains($0.id)
             $0.selected = false
           }
-          selected.enabled = true
           return InputMode.Input()
         }
       }
 
       // disable others and zoom
       else if "O" ~= input {
-        if let selected = selection {
+        if let selected = cursor {
           ctrl.hosts.forEach {
             if ($0 != selected) {
               $0.enabled = false
@@ -558,11 +836,13 @@ extension InputMode {
           }
           // zoom
           if let frame = screen?.hostsFrame {
-            selected.tab.window.frame = frame
+            selected.tab?.window.frame = frame
+            // moved outside of the layout manager
+            ctrl.windowManager.invalidate(host: selected.id)
           }
           selected.enabled = true
           // bring it front
-          selected.tab.window.frontmost = true
+          selected.tab?.window.frontmost = true
           // but still behind controller window
           ctrl.tab?.window.frontmost = true
           return InputMode.Input()
@@ -612,7 +892,7 @@ extension InputMode {
 
     mutating func onEnable(_ ctrl: Controller) throws {
       // hide all host windows
-      ctrl.hosts.forEach { $0.tab.hide() }
+      ctrl.hosts.forEach { $0.tab?.hide() }
 
       // switch master to resizing mode (color, …)
       if let color = ctrl.settings.resizingTextColor {
@@ -629,7 +909,7 @@ extension InputMode {
       }
     }
 
-    mutating func parse(input: inout [UInt8], _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+    mutating func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
       guard let screen = screen else {
         // TODO: exit bounds mode ?
         return nil
@@ -694,7 +974,8 @@ extension InputMode {
           screen.set(frame: frame, isRelative: false)
         }
         ctrl.setControllerColors()
-        ctrl.layout()
+        // host windows were hidden
+        ctrl.layout(force: true)
         return InputMode.Input()
       }
 
@@ -708,7 +989,7 @@ extension InputMode {
         } else {
           // else switch to input mode
           ctrl.setControllerColors()
-          ctrl.layout()
+          ctrl.layout(force: true)
           return InputMode.Input()
         }
       } else {
@@ -744,7 +1025,7 @@ extension InputMode {
       screen = ctrl.controllerScreen
     }
     
-    mutating func parse(input: inout [UInt8], _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+    mutating func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
       // ↑
       if "i" ~= input || "\u{1b}[A" ~= input {
         guard let screen, screen.rows < screen.hostCount else {
@@ -809,50 +1090,153 @@ extension InputMode {
   }
 }
 
+// MARK: -
+// stats mode: live latency and queues statistics, refreshed on each latency probe.
+extension InputMode {
+
+  struct Stats: InputModeProtocol {
+
+    var id: String { "stats" }
+
+    var raw: Bool { true }
+
+    // Max number of hosts listed. Slowest hosts first.
+    private static let maxHosts = 20
+
+    // last JSON dump path
+    private var report: URL? = nil
+
+    private static func ms(_ ns: UInt64) -> String {
+      String(format: "%8.2f", Double(ns) / 1_000_000)
+    }
+
+    func prompt(_ ctrl: Controller) -> String {
+      let interval = ctrl.settings.latencyProbeInterval
+      var str = "Latency statistics (\(interval > 0 ? "probe every \(interval) ms" : "probing disabled")): (Esc to exit)\r\n" +
+      "[r]eset statistics, dump as [j]son\r\n"
+      if let report {
+        str += "statistics written to \(report.path)\r\n"
+      }
+
+      let delay = ctrl.mainQueueDelay
+      str += "\r\nmain queue delay (ms): p50 \(Self.ms(delay.percentile(50))) p99 \(Self.ms(delay.percentile(99))) max \(Self.ms(delay.max))\r\n"
+      let input = ctrl.inputStatistics
+      str += "input: \(input.chunks) chunks read, \(input.writes) writes per host\r\n\r\n"
+
+      let connected = ctrl.hosts.filter { $0.connection != nil }
+      let sorted = connected.sorted { ($0.connection?.latency.percentile(99) ?? 0) > ($1.connection?.latency.percentile(99) ?? 0) }
+      str += "host".padding(toLength: 32, withPad: " ", startingAt: 0) +
+      "  p50 ms   p99 ms   max ms   queue    forwarded     dropped\r\n"
+      for host in sorted.prefix(Self.maxHosts) {
+        guard let connection = host.connection else { continue }
+        let latency = connection.latency
+        let name = (connection.lagging ? "! " : connection.probePending ? "* " : "  ") + host.description
+        str += name.padding(toLength: 32, withPad: " ", startingAt: 0) +
+        " \(Self.ms(latency.percentile(50))) \(Self.ms(latency.percentile(99))) \(Self.ms(latency.max))" +
+        String(format: " %7d %12llu %11llu\r\n", connection.queueDepth, connection.bytesForwarded, connection.bytesDropped)
+      }
+      if sorted.count > Self.maxHosts {
+        str += "… \(sorted.count - Self.maxHosts) more host(s)\r\n"
+      }
+      // Relays hosts, as last reported by the relays.
+      let relays = connected.compactMap(\.relayStats)
+      if !relays.isEmpty {
+        let hosts = relays.reduce(0) { $0 + Int($1.hosts) }
+        let forwarded = relays.reduce(0) { $0 + $1.forwarded }
+        let dropped = relays.reduce(0) { $0 + $1.dropped }
+        let p99 = relays.map(\.latencyP99).max() ?? 0
+        str += "\r\n\(relays.count) relay(s), \(hosts) host(s): p99 ms \(Self.ms(p99))" +
+        String(format: ", forwarded %llu, dropped %llu\r\n", forwarded, dropped)
+      }
+      str += "(! lagging, * probe in flight)\r\n"
+      return str
+    }
+
+    func onEnable(_ ctrl: Controller) throws {
+      // noop
+    }
+
+    mutating func parse(input: inout InputBuffer, _ ctrl: Controller) throws -> (any InputModeProtocol)? {
+      // reset
+      // Note: the prompt cannot be refreshed from here (inputMode exclusive access),
+      // it is refreshed by the next latency probe.
+      if "r" ~= input {
+        ctrl.resetStatistics()
+      }
+
+      // JSON dump
+      else if "j" ~= input {
+        do {
+          report = try LatencyReport(ctrl).write()
+        } catch {
+          logger.warning("failed to write latency report: \(error, privacy: .public)")
+          beep()
+          return nil
+        }
+        if let report {
+          fwrite(str: "statistics written to \(report.path)\r\n", file: stdout)
+        }
+      }
+
+      else if 0x1b ~= input {
+        // escape (\e)
+
+        if input.dropEscapeSequence() {
+          // if is escape sequence -> delete it and beep.
+          beep()
+          return nil
+        } else {
+          // else switch to input mode
+          return InputMode.Input()
+        }
+      } else {
+        input.removeAll()
+        beep()
+      }
+      return nil
+    }
+  }
+}
+
 // MARK: - Utilities
 // Special match operator that consume
-private func ~= (pattern: String, value: inout [UInt8]) -> Bool {
+private func ~= (pattern: String, value: inout InputBuffer) -> Bool {
   guard !value.isEmpty, !pattern.isEmpty else { return false }
 
   if pattern.utf8.count == 1 {
     // Fast path
-    if value[0] == pattern.utf8.first {
+    if value.first == pattern.utf8.first {
       value.removeFirst()
       return true
     }
     return false
   }
 
-  if value.prefix(pattern.utf8.count).elementsEqual(pattern.utf8) {
+  if value.starts(with: pattern.utf8) {
     value.removeFirst(pattern.utf8.count)
     return true
   }
   return false
 }
 
-private func ~= (pattern: UInt8, value: inout [UInt8]) -> Bool {
-  guard !value.isEmpty else { return false }
-
-  if pattern == value[0] {
+private func ~= (pattern: UInt8, value: inout InputBuffer) -> Bool {
+  if pattern == value.first {
     value.removeFirst()
     return true
   }
   return false
 }
 
-extension Array<UInt8> {
+extension InputBuffer {
   // TODO: other escape sequences
   mutating func dropEscapeSequence() -> Bool {
-    guard !isEmpty else { return false }
+    guard first == 0x5B else { return false }
 
-    if self[0] == 0x5B {
-      // CSI escape sequence.
-      removeFirst()
+    // CSI escape sequence.
+    removeFirst()
 
-      // Not sure about how to process it accurately. Dropping everything in range of supported CSI chars.
-      trimPrefix { (0x20...0x7E).contains($0) }
-      return true
-    }
-    return false
+    // Not sure about how to process it accurately. Dropping everything in range of supported CSI chars.
+    trimPrefix { (0x20...0x7E).contains($0) }
+    return true
   }
 }
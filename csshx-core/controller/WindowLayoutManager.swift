@@ -38,9 +38,13 @@ class WindowLayoutManager {
   // array to keep unplug screens configuration
   private var unpluggedScreens = [String:Screen]()
   private(set) var controllerScreen: Screen? = nil
+  // Host windows grids of the last layout pass.
+  private(set) var grid = HostLayout<HostWindow.ID>()
 
   // internal value use by smart layout
   private var defaultWindowRatio: Double = 0
+  // Last applied host windows frames.
+  private var cache = LayoutPlanner<HostWindow.ID>.Cache()
 
   private var dirty: Bool = false
   static let displayReconfigurationCallback: CGDisplayReconfigurationCallBack = { displayId, flags, ctxt in
@@ -136,10 +140,22 @@ class WindowLayoutManager {
       // TODO: check resulting frame to make sure controllerHeight is respected.
     }
 
-    guard !hosts.isEmpty else { return }
+    guard !hosts.isEmpty else {
+      grid = HostLayout()
+      return
+    }
     layout(hosts: hosts)
   }
 
+  /// Forget the frames of all windows, so the next layout pass updates every window.
+  func invalidate() {
+    cache.invalidateAll()
+  }
+
+  func invalidate(host: HostWindow.ID) {
+    cache.invalidate(host)
+  }
+
   private func layout(hosts: [HostWindow]) {
     assert(!hosts.isEmpty)
     let screens = screens.filter(\.active)
@@ -148,61 +164,33 @@ class WindowLayoutManager {
     // Update all screens frames before computing windows layouts
     screens.forEach { if ($0.uuid != controllerScreen?.uuid) { $0.updateFrame(reserved: 0) } }
 
-    // compute surface of each screen and split host windows proportionally.
-    var totalArea = screens.reduce(0.0) { area, screen in
-      return area + screen.area
-    }
-
-    var dispatched = 0
-    for screen in screens {
-      if dispatched < hosts.count {
-        // Compute count of hosts proportionally to the screen area.
-        let count = Int(ceil(CGFloat(hosts.count - dispatched) * (screen.area / totalArea)))
-        // Compute screen frame and grid layout
-        screen.set(hosts: hosts[dispatched..<(dispatched + count)].map(\.id),
-                   ratio: defaultWindowRatio)
-
-        totalArea -= screen.area
-        dispatched += count
-        assert(dispatched <= hosts.count)
-      } else {
-        // Clear screen
-        screen.set(hosts: [], ratio: 1)
-        // disable the screen
+    let planner = LayoutPlanner<HostWindow.ID>(ratio: defaultWindowRatio)
+    let plan = planner.plan(hosts: hosts.map(\.id), on: screens.map(\.layout))
+    self.grid = plan.layout
+    for (screen, grid) in zip(screens, plan.grids) {
+      screen.grid = grid
+      // disable screens without hosts
+      if grid == nil {
         screen.active = false
       }
     }
 
-    var hostsById = [HostWindow.ID:HostWindow]()
-    hosts.forEach { host in hostsById[host.id] = host }
-    for screen in screens {
-      layout(screen: screen, hosts: hostsById)
+    let changes = cache.diff(plan.placements)
+    guard !changes.isEmpty else { return }
+    logger.debug("layout: \(changes.added.count) new windows, \(changes.moved.count) moved (\(plan.placements.count) total)")
+
+    // New windows may have been zoomed or minimized by the user before being laid out.
+    for placement in changes.added {
+      guard let window = hosts[placement.host].tab?.window else { continue }
+      window.zoomed = false
+      window.miniaturized = false
+      window.frame = placement.frame
+      window.frontmost = true
     }
-  }
-
-  private func layout(screen: Screen, hosts: [HostWindow.ID:HostWindow]) {
-    guard let grid = screen.grid else { return }
-
-    let bounds = screen.hostsFrame
-    let width = bounds.width / CGFloat(grid.columns)
-    let height = bounds.height / CGFloat(grid.rows)
-
-    // Layout from top to bottom
-    var y = bounds.maxY - height
-    for row in grid.grid {
-      var x = bounds.minX
-      for hostId in row {
-        guard let tab = hosts[hostId]?.tab else { continue }
-
-        tab.window.zoomed = false
-        // tab.window.visible = false // looks better if hidden while resized
-        tab.window.miniaturized = false
-        // Layout from top to bottom
-        tab.window.frame = CGRect(x: x, y: y, width: width, height: height)
-        tab.window.frontmost = true
-        x += width
-      }
-      y -= height
+    for placement in changes.moved {
+      guard let window = hosts[placement.host].tab?.window else { continue }
+      window.frame = placement.frame
+      window.frontmost = true
     }
   }
 
@@ -240,91 +228,6 @@ class WindowLayoutManager {
 }
 
 // MARK: -
-private struct HostGrid {
-  let rows: Int
-  let columns: Int
-
-  // caching total host count
-  let count: Int
-
-  // List of rows
-  let grid: [[HostWindow.ID]]
-
-  private func getPosition(of host: HostWindow.ID) -> (Int, Int)? {
-    for row in grid.indices {
-      if let column = grid[row].firstIndex(of: host) {
-        return (row, column)
-      }
-    }
-    return nil
-  }
-
-  // resolve coords in grid (row, column).
-  //   -> compute next/previous by looking in the grid table.
-  func getHostAbove(_ host: HostWindow.ID) -> HostWindow.ID? {
-    // row above should always at least as large as the current row.
-    guard let (row, column) = getPosition(of: host),
-          row > 0, grid[row - 1].endIndex > column else { return nil }
-
-    return grid[row - 1][column]
-  }
-
-  func getHostBelow(_ host: HostWindow.ID) -> HostWindow.ID? {
-    guard let (row, column) = getPosition(of: host),
-            row + 1 < grid.endIndex, grid[row + 1].endIndex > column else { return nil }
-
-    return grid[row + 1][column]
-  }
-
-  func getHostLeft(of host: HostWindow.ID) -> HostWindow.ID? {
-    guard let (row, column) = getPosition(of: host), column > 0 else { return nil }
-
-    return grid[row][column - 1]
-  }
-
-  func getHostRight(of host: HostWindow.ID) -> HostWindow.ID? {
-    guard let (row, column) = getPosition(of: host), column + 1 < grid[row].endIndex else { return nil }
-
-    return grid[row][column + 1]
-  }
-
-  // Host Grid factories
-  static func byRow(hosts: [HostWindow.ID], rows: Int, columns: Int) -> Self {
-    var grid = [[HostWindow.ID]]()
-
-    // Simply fill rows until there is no more hosts
-    let end = hosts.endIndex
-    var remainings = hosts.startIndex..<end
-    while (!remainings.isEmpty) {
-      let row = remainings.clamped(to: remainings.startIndex..<remainings.startIndex + columns)
-      grid.append(Array(hosts[row]))
-      remainings = row.endIndex..<end
-    }
-    return HostGrid(rows: rows, columns: columns, count: hosts.count, grid: grid)
-  }
-
-  // populate by columns instead of populating by rows if row count requested
-  // i.e. 5 hosts in 4 columns mode will result in 1 full row of 4 hosts, and a second row with one host
-  // in rows mode, it should be 1 row with 2 hosts, and 3 rows with one host.
-  static func byColumns(hosts: [HostWindow.ID], rows: Int, columns: Int) -> Self {
-    var grid = [[HostWindow.ID]]()
-
-    // count of hosts in the last column
-    let fullRows = hosts.count.isMultiple(of: rows) ? rows : hosts.count % rows
-
-    let end = hosts.endIndex
-    var remainings = hosts.startIndex..<end
-    while (!remainings.isEmpty) {
-      let rowLength = grid.count < fullRows ? columns : columns - 1
-      let row = remainings.startIndex..<min(end, remainings.startIndex + rowLength)
-      grid.append(Array(hosts[row]))
-      remainings = row.endIndex..<end
-    }
-
-    return HostGrid(rows: rows, columns: columns, count: hosts.count, grid: grid)
-  }
-}
-
 class Screen {
   let uuid: String // screen UUID.
 
@@ -342,17 +245,9 @@ class Screen {
   var frame: CGRect = CGRect.zero
   fileprivate var reserved: CGFloat = 0
 
-  var hostsFrame: CGRect {
-    if (reserved > 0) {
-      // Remove space reserved for controller window from screen frame
-      let (_, bounds) = frame.divided(atDistance: reserved, from: .minYEdge)
-      return bounds
-    } else {
-      return frame
-    }
-  }
+  var hostsFrame: CGRect { layout.hostsFrame }
 
-  fileprivate var grid: HostGrid? = nil
+  fileprivate var grid: HostGrid<HostWindow.ID>? = nil
 
   fileprivate init(uuid: String, visibleFrame frame: CGRect) {
     self.uuid = uuid
@@ -396,45 +291,7 @@ class Screen {
     self.reserved = reserved
   }
 
-  fileprivate func set(hosts: [HostWindow.ID], ratio: CGFloat) {
-    guard !hosts.isEmpty else {
-      grid = nil
-      return
-    }
-
-    let count = hosts.count
-    if requestedColumns > 0 {
-      let columns = min(requestedColumns, count)
-      let rows = Int(ceil(Float(count) / Float(columns)))
-      grid = HostGrid.byRow(hosts: hosts, rows: rows, columns: columns)
-    } else if requestedRows > 0 {
-      let rows = min(requestedRows, count)
-      let columns = Int(ceil(Float(count) / Float(rows)))
-      grid = HostGrid.byColumns(hosts: hosts, rows: rows, columns: columns)
-    } else if (ratio > 0) {
-      let (rows, columns) = getBestLayout(for: ratio, hosts: count, on: frame.size)
-      grid = HostGrid.byRow(hosts: hosts, rows: rows, columns: columns)
-    } else {
-      grid = nil
-    }
-  }
-
-  fileprivate var area: CGFloat { frame.width * frame.height }
-
-  func getHostAbove(_ host: HostWindow.ID) -> HostWindow.ID? {
-    return grid?.getHostAbove(host)
-  }
-
-  func getHostBelow(_ host: HostWindow.ID) -> HostWindow.ID? {
-    return grid?.getHostBelow(host)
-  }
-
-  func getHostLeft(of host: HostWindow.ID) -> HostWindow.ID? {
-    return grid?.getHostLeft(of: host)
-  }
-
-  func getHostRight(of host: HostWindow.ID) -> HostWindow.ID? {
-    return grid?.getHostRight(of: host)
+  fileprivate var layout: LayoutPlanner<HostWindow.ID>.Screen {
+    LayoutPlanner.Screen(frame: frame, reserved: reserved, rows: requestedRows, columns: requestedColumns)
   }
 }
-
@@ -0,0 +1,193 @@
+//
+//  ClusterGraph.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+import System
+
+/// Clusters definitions, compiled into flattened member lists.
+///
+/// Clusters may reference other clusters (directly or through a pattern like `workers-[a-b]`), forming a graph.
+/// Compilation walks this graph once, memoizing the flattened members of each cluster, so shared sub-clusters
+/// are expanded only once, and rejects cycles.
+///
+/// The compiled graph can be saved into a cache file, keyed on the definitions sources (file path, modification
+/// date and size, or inline definitions), so large cluster files are not parsed on each invocation.
+struct ClusterGraph {
+
+  /// A flattened cluster member: a host spec that does not reference any cluster.
+  struct Member: Codable, Equatable {
+    let spec: String
+    // repeat count inherited from the referencing specs (workers+2).
+    let multiplier: Int
+  }
+
+  enum Source: Codable, Equatable {
+    // clusters file
+    case file(path: String, modified: Double, size: UInt64)
+    // clusters defined in a csshrc file or added programmatically.
+    case inline([String: [String]])
+  }
+
+  private var sources = [Source]()
+  // Flattened members of each cluster. nil until compiled.
+  private(set) var members: [String: [Member]]? = nil
+
+  var isCompiled: Bool { members != nil }
+
+  // MARK: Definitions
+  mutating func add(file: FilePath) {
+    let path = (file.string as NSString).expandingTildeInPath
+    var info = stat()
+    guard stat(path, &info) == 0 else {
+      logger.debug("\(path, privacy: .public) does not exists. Skipping it.")
+      return
+    }
+    let modified = Double(info.st_mtimespec.tv_sec) + Double(info.st_mtimespec.tv_nsec) / 1e9
+    sources.append(.file(path: path, modified: modified, size: UInt64(info.st_size)))
+    members = nil
+  }
+
+  mutating func add(_ hosts: [String], to cluster: String) {
+    if case .inline(var definitions) = sources.last {
+      definitions[cluster, default: []].append(contentsOf: hosts)
+      sources[sources.count - 1] = .inline(definitions)
+    } else {
+      sources.append(.inline([cluster: hosts]))
+    }
+    members = nil
+  }
+
+  private static func load(file path: String, into definitions: inout [String: [String]]) throws {
+    try FilePath(path).readFields { fields in
+      guard fields.count > 1 else { return }
+
+      // the first entry is a cluster name, following entries are matching hosts
+      definitions[fields.string(at: 0), default: []].append(contentsOf: (1..<fields.count).map(fields.string(at:)))
+    }
+  }
+
+  // MARK: Compilation
+  /// Compile the clusters graph, using the cache file if it matches the current sources.
+  mutating func compile(cache: URL? = nil) throws {
+    guard members == nil else { return }
+
+    if let cache, let cached = Self.load(cache: cache), cached.sources == sources {
+      logger.debug("using clusters cache: \(cache.path, privacy: .public)")
+      members = cached.clusters
+      return
+    }
+
+    var definitions = [String: [String]]()
+    for source in sources {
+      switch source {
+        case .file(let path, _, _):
+          try Self.load(file: path, into: &definitions)
+        case .inline(let inline):
+          definitions.merge(inline) { $0 + $1 }
+      }
+    }
+
+    var flattened = [String: [Member]]()
+    var path = [String]()
+    for cluster in definitions.keys {
+      _ = try Self.flatten(cluster, definitions: definitions, path: &path, into: &flattened)
+    }
+    members = flattened
+
+    // Only worth caching if there is something to parse.
+    if let cache, sources.contains(where: { if case .file = $0 { true } else { false } }) {
+      Self.save(cache: cache, CacheContent(sources: sources, clusters: flattened))
+    }
+  }
+
+  /// Return a compiled graph (self if already compiled).
+  func compiled() throws -> ClusterGraph {
+    guard !isCompiled else { return self }
+    var graph = self
+    try graph.compile()
+    return graph
+  }
+
+  private static func flatten(_ cluster: String, definitions: [String: [String]],
+                              path: inout [String], into flattened: inout [String: [Member]]) throws -> [Member] {
+    if let members = flattened[cluster] {
+      return members
+    }
+    guard !path.contains(cluster) else {
+      logger.warning("cluster cycle detected: \((path + [cluster]).joined(separator: " -> "), privacy: .public)")
+      throw POSIXError(.ELOOP)
+    }
+    path.append(cluster)
+    defer { path.removeLast() }
+
+    var members = [Member]()
+    for spec in definitions[cluster] ?? [] {
+      let host = try HostList.HostSpec(host: spec, command: nil)
+      // Fast path: no generated hostname is a cluster -> keep the spec as is.
+      var hostname = ""
+      let references = (0..<host.pattern.count).contains { idx in
+        host.pattern.hostname(at: idx, into: &hostname)
+        return definitions[hostname] != nil
+      }
+      guard references else {
+        members.append(Member(spec: spec, multiplier: 1))
+        continue
+      }
+
+      for idx in 0..<host.pattern.count {
+        host.pattern.hostname(at: idx, into: &hostname)
+        if definitions[hostname] != nil {
+          // user, port and command of the referencing spec are not inherited.
+          let nested = try flatten(hostname, definitions: definitions, path: &path, into: &flattened)
+          members.append(contentsOf: nested.map { Member(spec: $0.spec, multiplier: $0.multiplier * host.repeatCount) })
+        } else {
+          members.append(Member(spec: host.spec(hostname: hostname), multiplier: host.repeatCount))
+        }
+      }
+    }
+    flattened[cluster] = members
+    return members
+  }
+
+  // MARK: Cache
+  private struct CacheContent: Codable {
+    static let version = 1
+
+    var version = Self.version
+    let sources: [Source]
+    let clusters: [String: [Member]]
+  }
+
+  static var defaultCache: URL? {
+    FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask).first?
+      .appendingPathComponent("com.xenonium.csshx", isDirectory: true)
+      .appendingPathComponent("clusters.plist")
+  }
+
+  private static func load(cache: URL) -> CacheContent? {
+    guard let data = try? Data(contentsOf: cache) else { return nil }
+    do {
+      let content = try PropertyListDecoder().decode(CacheContent.self, from: data)
+      return content.version == CacheContent.version ? content : nil
+    } catch {
+      logger.info("ignoring invalid clusters cache: \(error, privacy: .public)")
+      return nil
+    }
+  }
+
+  private static func save(cache: URL, _ content: CacheContent) {
+    do {
+      let encoder = PropertyListEncoder()
+      encoder.outputFormat = .binary
+      try FileManager.default.createDirectory(at: cache.deletingLastPathComponent(), withIntermediateDirectories: true)
+      try encoder.encode(content).write(to: cache, options: .atomic)
+    } catch {
+      // Not fatal, the clusters will simply be parsed again next time.
+      logger.warning("failed to write clusters cache: \(error, privacy: .public)")
+    }
+  }
+}
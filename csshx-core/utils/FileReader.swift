@@ -8,31 +8,260 @@
 import Foundation
 import System
 
-// When using async, it is easier to simply use URL.lines.
+/// Configuration file error, with its location.
+struct ParseError: Error, CustomStringConvertible, LocalizedError {
+  // Set by the file reader.
+  var file: String? = nil
+  // 1 based line number
+  let line: Int
+  // 1 based byte offset in the line
+  let column: Int
+  let reason: String
+
+  var description: String { "\(file ?? "-"):\(line):\(column): \(reason)" }
+  var errorDescription: String? { description }
+}
+
+extension UInt8 {
+  // ' ', '\t', '\n', '\v', '\f', '\r'
+  var isSpace: Bool { self == UInt8(ascii: " ") || (0x09...0x0d).contains(self) }
+}
+
+/// Whitespace separated fields of a line, with comment (anything after '#') stripped.
+///
+/// Fields are views in the file content, and are only valid during the reader callback.
+struct LineFields: RandomAccessCollection {
+  // 1 based line number
+  let number: Int
+  // line content, without line terminator and comment.
+  let line: UnsafeBufferPointer<UInt8>
+  fileprivate let ranges: [Range<Int>]
+
+  var startIndex: Int { ranges.startIndex }
+  var endIndex: Int { ranges.endIndex }
+
+  subscript(position: Int) -> UnsafeBufferPointer<UInt8> {
+    UnsafeBufferPointer(rebasing: line[ranges[position]])
+  }
+
+  func string(at position: Int) -> String {
+    String(decoding: self[position], as: UTF8.self)
+  }
+
+  /// Content of the line, from the field at `position` to the end of the last field.
+  func remainder(from position: Int) -> String {
+    String(decoding: UnsafeBufferPointer(rebasing: line[ranges[position].lowerBound..<ranges[ranges.endIndex - 1].upperBound]),
+           as: UTF8.self)
+  }
+
+  /// 1 based column of the field at `position`.
+  func column(at position: Int) -> Int {
+    ranges[position].lowerBound + 1
+  }
+
+  func error(_ reason: String, column: Int) -> ParseError {
+    ParseError(line: number, column: column, reason: reason)
+  }
+
+  /// Lex a `key = value` line, the key being a single word.
+  ///
+  /// The value is the rest of the line after '=', without surrounding whitespaces, and may be empty.
+  func assignment() throws(ParseError) -> (key: String, value: String, column: Int) {
+    let start = ranges[0].lowerBound
+    let end = ranges[ranges.endIndex - 1].upperBound
+    guard let eq = line[start..<end].firstIndex(of: UInt8(ascii: "=")) else {
+      throw error("expected '=' after key", column: end + 1)
+    }
+    guard eq > start else {
+      throw error("missing key", column: eq + 1)
+    }
+    // The key is the first field, possibly ending with '='.
+    let keyEnd = min(eq, ranges[0].upperBound)
+    if keyEnd < eq, let extra = line[keyEnd..<eq].firstIndex(where: { !$0.isSpace }) {
+      throw error("unexpected character in key", column: extra + 1)
+    }
+    var valueStart = eq + 1
+    while valueStart < end, line[valueStart].isSpace {
+      valueStart += 1
+    }
+    return (String(decoding: UnsafeBufferPointer(rebasing: line[start..<keyEnd]), as: UTF8.self),
+            String(decoding: UnsafeBufferPointer(rebasing: line[valueStart..<end]), as: UTF8.self),
+            valueStart + 1)
+  }
+}
+
+extension StringProtocol {
+  /// Split on `separator`, trimming whitespaces around items. Empty items are skipped.
+  /// With a nil separator, split on whitespaces.
+  func items(separatedBy separator: UInt8? = nil) -> [String] {
+    var items = [String]()
+    var start: String.Index? = nil
+    var end = utf8.startIndex
+    for idx in utf8.indices {
+      let c = utf8[idx]
+      if c == separator || (separator == nil && c.isSpace) {
+        if let s = start {
+          items.append(String(self[s..<end]))
+          start = nil
+        }
+      } else if !c.isSpace {
+        if start == nil { start = idx }
+        end = utf8.index(after: idx)
+      }
+    }
+    if let s = start {
+      items.append(String(self[s..<end]))
+    }
+    return items
+  }
+}
+
 extension FilePath {
-  func readLines(_ handler: (String) throws -> Void) throws {
-    var err: (any Error)? = nil
-    let content: String
-    do {
-      content = try String(contentsOfFile: (string as NSString).expandingTildeInPath)
-    } catch CocoaError.fileReadNoSuchFile {
-      return
-    } catch {
-      throw error
-    }
-    withoutActuallyEscaping(handler) { escapingClosure in
-      content.enumerateLines { line, stop in
-        do {
-          try escapingClosure(line)
-        } catch {
-          stop = true
-          err = error
+
+  /// Read the file line by line, without loading it in memory.
+  ///
+  /// Regular files are memory mapped. Other files (pipes, devices, '-' for stdin) are read by chunks.
+  /// Lines are passed without their terminator ("\n" or "\r\n"), and are only valid during the callback.
+  /// A file that does not exist is treated as an empty file.
+  func readLines(_ handler: (UnsafeBufferPointer<UInt8>) throws -> Void) throws {
+    let fd: Int32
+    if string == "-" {
+      fd = STDIN_FILENO
+    } else {
+      fd = open((string as NSString).expandingTildeInPath, O_RDONLY | O_CLOEXEC)
+      guard fd >= 0 else {
+        if errno == ENOENT {
+          return
         }
+        throw POSIXError.errno
+      }
+    }
+    defer {
+      if fd != STDIN_FILENO {
+        close(fd)
       }
     }
-    
-    if let err {
-      throw err
+
+    var info = stat()
+    guard fstat(fd, &info) == 0 else {
+      throw POSIXError.errno
+    }
+
+    if (info.st_mode & S_IFMT) == S_IFREG {
+      guard info.st_size > 0 else { return }
+      let size = Int(info.st_size)
+      guard let addr = mmap(nil, size, PROT_READ, MAP_PRIVATE, fd, 0), addr != UnsafeMutableRawPointer(bitPattern: -1) else {
+        throw POSIXError.errno
+      }
+      defer { munmap(addr, size) }
+      // Hint the kernel that the file is read sequentially.
+      _ = madvise(addr, size, MADV_SEQUENTIAL)
+
+      let content = UnsafeBufferPointer(start: addr.assumingMemoryBound(to: UInt8.self), count: size)
+      let rest = try Self.split(lines: content, handler)
+      if !rest.isEmpty {
+        try handler(Self.trimCarriageReturn(rest))
+      }
+    } else {
+      try Self.read(chunks: fd, handler)
+    }
+  }
+
+  /// Read the file line by line, stripping comments and splitting lines on whitespaces in a single scan.
+  /// Lines without fields (blank or comment only lines) are skipped.
+  /// `ParseError` thrown by the handler are completed with the file path.
+  func readFields(_ handler: (LineFields) throws -> Void) throws {
+    var number = 0
+    // reused for all lines.
+    var ranges = [Range<Int>]()
+    try readLines { line in
+      number += 1
+      ranges.removeAll(keepingCapacity: true)
+
+      var end = line.endIndex
+      var start: Int? = nil
+      for idx in line.indices {
+        let c = line[idx]
+        if c == UInt8(ascii: "#") {
+          end = idx
+          break
+        }
+        if c.isSpace {
+          if let s = start {
+            ranges.append(s..<idx)
+            start = nil
+          }
+        } else if start == nil {
+          start = idx
+        }
+      }
+      if let s = start {
+        ranges.append(s..<end)
+      }
+      guard !ranges.isEmpty else { return }
+
+      do {
+        try handler(LineFields(number: number, line: UnsafeBufferPointer(rebasing: line[..<end]), ranges: ranges))
+      } catch var error as ParseError where error.file == nil {
+        error.file = string
+        throw error
+      }
+    }
+  }
+
+  // Call handler for each complete line, and returns the trailing partial line.
+  private static func split(lines content: UnsafeBufferPointer<UInt8>,
+                            _ handler: (UnsafeBufferPointer<UInt8>) throws -> Void) throws -> UnsafeBufferPointer<UInt8> {
+    guard let base = content.baseAddress else { return content }
+    var offset = 0
+    while offset < content.count {
+      guard let nl = memchr(base + offset, Int32(UInt8(ascii: "\n")), content.count - offset) else {
+        break
+      }
+      let end = base.distance(to: nl.assumingMemoryBound(to: UInt8.self))
+      try handler(trimCarriageReturn(UnsafeBufferPointer(rebasing: content[offset..<end])))
+      offset = end + 1
+    }
+    return UnsafeBufferPointer(rebasing: content[offset...])
+  }
+
+  private static func trimCarriageReturn(_ line: UnsafeBufferPointer<UInt8>) -> UnsafeBufferPointer<UInt8> {
+    if line.last == UInt8(ascii: "\r") {
+      return UnsafeBufferPointer(rebasing: line.dropLast())
+    }
+    return line
+  }
+
+  private static func read(chunks fd: Int32, _ handler: (UnsafeBufferPointer<UInt8>) throws -> Void) throws {
+    // Partial lines are moved to the start of the buffer, which grows only for lines longer than the buffer.
+    var buffer = [UInt8](repeating: 0, count: 64 * 1024)
+    var pending = 0
+    while true {
+      if pending == buffer.count {
+        buffer.append(contentsOf: repeatElement(0, count: buffer.count))
+      }
+      let count = buffer.withUnsafeMutableBytes { ptr in
+        Darwin.read(fd, ptr.baseAddress! + pending, ptr.count - pending)
+      }
+      if count < 0 {
+        guard errno == EINTR else { throw POSIXError.errno }
+        continue
+      }
+      if count == 0 {
+        // EOF
+        if pending > 0 {
+          try buffer.withUnsafeBufferPointer { try handler(trimCarriageReturn(UnsafeBufferPointer(rebasing: $0[0..<pending]))) }
+        }
+        return
+      }
+      pending = try buffer.withUnsafeMutableBufferPointer { ptr in
+        let rest = try split(lines: UnsafeBufferPointer(rebasing: ptr[0..<pending + count]), handler)
+        guard let base = ptr.baseAddress, let src = rest.baseAddress else { return 0 }
+        if !rest.isEmpty {
+          memmove(base, src, rest.count)
+        }
+        return rest.count
+      }
     }
   }
 }
@@ -0,0 +1,100 @@
+//
+//  Histogram.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Fixed memory latency histogram, using HDR-style log-linear buckets.
+///
+/// Values are grouped by power of 2, and each power of 2 is split into 64 linear sub-buckets,
+/// so any recorded value is reported with a relative error below 1/64 (~1.6%).
+/// Recording is O(1) and does not allocate.
+struct Histogram: Sendable {
+
+  // Count of significant bits kept for each value.
+  private static let significantBits = 7
+  private static let subBucketCount = 1 << (significantBits - 1)
+  // Values are saturated to 2^36 ns (~68s), which is way above any meaningful latency.
+  private static let maxMagnitude = 36 - significantBits
+  private static let bucketCount = (maxMagnitude + 2) * subBucketCount
+
+  private var counts: [UInt32]
+
+  private(set) var count: UInt64 = 0
+  private(set) var min: UInt64 = .max
+  private(set) var max: UInt64 = 0
+  private var sum: UInt64 = 0
+
+  init() {
+    counts = Array(repeating: 0, count: Self.bucketCount)
+  }
+
+  var isEmpty: Bool { count == 0 }
+
+  var mean: Double {
+    count > 0 ? Double(sum) / Double(count) : 0
+  }
+
+  mutating func record(_ value: UInt64) {
+    counts[Self.index(of: value)] &+= 1
+    count += 1
+    sum &+= value
+    min = Swift.min(min, value)
+    max = Swift.max(max, value)
+  }
+
+  /// Add all values recorded by other.
+  mutating func merge(_ other: Histogram) {
+    guard !other.isEmpty else { return }
+    for idx in counts.indices { counts[idx] &+= other.counts[idx] }
+    count += other.count
+    sum &+= other.sum
+    min = Swift.min(min, other.min)
+    max = Swift.max(max, other.max)
+  }
+
+  mutating func reset() {
+    for idx in counts.indices { counts[idx] = 0 }
+    count = 0
+    sum = 0
+    min = .max
+    max = 0
+  }
+
+  /// Value at the given percentile (0-100).
+  ///
+  /// The result is the highest value of the matching bucket, clamped to the recorded range.
+  func percentile(_ p: Double) -> UInt64 {
+    guard count > 0 else { return 0 }
+
+    let rank = Swift.max(1, UInt64((p / 100 * Double(count)).rounded(.up)))
+    var total: UInt64 = 0
+    for (idx, value) in counts.enumerated() where value > 0 {
+      total += UInt64(value)
+      if total >= rank {
+        return Swift.min(Swift.max(Self.highestValue(at: idx), min), max)
+      }
+    }
+    return max
+  }
+
+  // MARK: Buckets
+  // Values below 2 * subBucketCount are stored as is. For larger values, the magnitude is the
+  // count of low bits dropped so that the value fits on `significantBits`.
+  static func index(of value: UInt64) -> Int {
+    let width = UInt64.bitWidth - value.leadingZeroBitCount
+    let magnitude = Swift.max(0, width - significantBits)
+    guard magnitude <= maxMagnitude else { return bucketCount - 1 }
+    return magnitude * subBucketCount + Int(value >> magnitude)
+  }
+
+  static func highestValue(at index: Int) -> UInt64 {
+    guard index >= 2 * subBucketCount else { return UInt64(index) }
+    let magnitude = index / subBucketCount - 1
+    let sub = UInt64(index - magnitude * subBucketCount)
+    return ((sub + 1) << magnitude) - 1
+  }
+}
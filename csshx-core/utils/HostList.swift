@@ -8,7 +8,6 @@
 import Foundation
 
 import System
-import RegexBuilder
 
 struct Target: Equatable {
   let user: String?
@@ -33,271 +32,235 @@ struct Target: Equatable {
 /// HostList is use to convert clusters/hosts parameters into an actual host list.
 struct HostList {
   
-  private struct HostSpec {
+  // Host specification, compiled once when added.
+  struct HostSpec {
     let user: String?
     let hostname: String
+    let pattern: HostPattern
     let port: String? // may be a port range
+    let ports: HostPattern.Ports?
+    // repeat count (host+3)
+    private(set) var repeatCount: Int
     let command: String?
     
-    init(user: String?, hostname: String, port: String?, command: String?) {
+    init<S: StringProtocol>(host: S, command: String?) throws where S.SubSequence == Substring {
+      let (user, hostname, port) = try host.parseUserHostPort()
       self.user = user
-      self.hostname = hostname
-      self.port = port
       self.command = command
+      self.port = port
+      self.ports = try port.map(HostPattern.Ports.init)
+      
+      // 192.168.0.1+3
+      if let plus = hostname.lastIndex(of: "+"), plus > hostname.startIndex {
+        let count = hostname[hostname.index(after: plus)...]
+        if !count.isEmpty, count.allSatisfy(\.isNumber) {
+          // Ensure repeat count is greater than 1, and that this is not a recursive pattern.
+          guard let value = Int(count), value > 1, !Self.isRepeat(hostname[..<plus]) else {
+            logger.warning("invalid repeat pattern: \(hostname, privacy: .public)")
+            throw POSIXError(.EINVAL)
+          }
+          self.hostname = String(hostname[..<plus])
+          self.repeatCount = value
+          self.pattern = try HostPattern(self.hostname)
+          return
+        }
+      }
+      self.hostname = hostname
+      self.repeatCount = 1
+      self.pattern = try HostPattern(hostname)
     }
     
-    init<S: StringProtocol>(host: S, command: String?) throws where S.SubSequence == Substring {
-      (user, hostname, port) = try host.parseUserHostPort()
-      self.command = command
+    init(member: ClusterGraph.Member) throws {
+      self = try HostSpec(host: member.spec, command: nil)
+      repeatCount *= member.multiplier
+    }
+    
+    /// Spec string of a single hostname generated by this spec (without repeat count).
+    func spec(hostname: String) -> String {
+      var spec = user.map { "\($0)@" } ?? ""
+      spec.append(hostname)
+      if let port {
+        spec.append(":")
+        spec.append(port)
+      }
+      return spec
     }
     
-    func with(hostname: String) -> HostSpec {
-      return HostSpec(user: user, hostname: hostname, port: port, command: command)
+    private static func isRepeat(_ hostname: Substring) -> Bool {
+      guard let plus = hostname.lastIndex(of: "+"), plus > hostname.startIndex else { return false }
+      let count = hostname[hostname.index(after: plus)...]
+      return !count.isEmpty && count.allSatisfy(\.isNumber)
     }
   }
   
   private var hosts = [HostSpec]()
-  private var clusters = [String:[String]]()
+  private var clusters = ClusterGraph()
   
+  /// Resolve all hosts.
+  /// - Parameter limit: max number of hosts. An error is thrown if there is more hosts than that.
   func getHosts(limit: Int = 2048) throws -> [Target] {
     var resolved = [Target]()
-    for host in hosts {
-      try expands(host, limit: limit, into: &resolved)
+    resolved.reserveCapacity(try count(limit: limit))
+    
+    var targets = try makeIterator()
+    while let target = try targets.next() {
+      resolved.append(target)
     }
     return resolved
   }
-
-  nonisolated(unsafe)
-  private static let repeatPattern = Regex {
-    Capture(OneOrMore(.any, .reluctant))
-    "+"
-    Capture {
-      OneOrMore(.digit)
-    } transform: { Int($0)! }
-  }
   
-  // Evaluate "repeat" patterns and fallback to _expand()
-  private func expands(_ host: HostSpec, limit: Int, into: inout [Target]) throws {
-    // 192.168.0.1+3
-    
-    // Then, check for repeat pattern
-    if let match = host.hostname.wholeMatch(of: Self.repeatPattern) {
-      // expand single entry, and then repeat
-      let count = match.output.2
-      
-      // Ensure repeat count is greater than 1, and that this is not a recursive pattern.
-      guard count > 1,
-            match.output.1.wholeMatch(of: Self.repeatPattern) == nil else {
-        logger.warning("invalid repeat pattern: \(host.hostname, privacy: .public)")
-        throw POSIXError(.EINVAL)
-      }
-      
-      var result = [Target]()
-      try _expands(host.with(hostname: String(match.output.1)), limit: (limit - into.count) / count, into: &result)
-      for target in result {
-        into.append(contentsOf: repeatElement(target, count: count))
-      }
-    } else {
-      try _expands(host, limit: limit, into: &into)
+  /// Count the resolved hosts without expanding them.
+  ///
+  /// This is O(number of specs), unless the hostnames have to be generated to check if they match a cluster
+  /// or to expand IP networks, in which case hostnames are generated one at a time into a reused buffer.
+  func count(limit: Int = 2048) throws -> Int {
+    let clusters = try self.clusters.compiled().members ?? [:]
+    var total = 0
+    var buffer = ""
+    for host in hosts {
+      total += try count(host, multiplier: 1, clusters: clusters, limit: limit - total, buffer: &buffer)
     }
+    return total
   }
   
-  private func _expands(_ host: HostSpec, limit: Int, into: inout [Target]) throws {
-    // 192.168.0.0/24
-    // 192.168.0.[0-255]
-    // 192.168.0.[0-20,13]
-    // 192.168.[0-2].[255,254]
-    // 192.168.[0-2].0/24
-    
-    // Try cluster expansion
-    if let clusterHosts = clusters[host.hostname] {
-      logger.debug("Expand cluster: \(host.hostname, privacy: .public) => \(clusterHosts, privacy: .public)\n")
-      // add cluster host (expanding them if needed)
-      for host in clusterHosts {
-        // supports repeat expansion in cluster expansion -> call to expands (and not _expands)
-        try expands(HostSpec(host: host, command: nil), limit: limit, into: &into)
-      }
-      return
-    }
+  // clusters are nil for cluster members, as they are already flattened.
+  private func count(_ host: HostSpec, multiplier: Int, clusters: [String: [ClusterGraph.Member]]?,
+                     limit: Int, buffer: inout String) throws -> Int {
+    let multiplier = multiplier * host.repeatCount
+    let perHost = (host.ports?.count ?? 1) * multiplier
     
-    // Expand all ranges in the hostname.
-    if let match = host.hostname.wholeMatch(of: /(.*)\[(.*)\](.*)/.repetitionBehavior(.reluctant)) {
-      let prefix = match.output.1
-      let suffix = match.output.3
-      guard let values = parse(ranges: String(match.output.2), limit: limit - into.count) else {
-        logger.warning("invalid range definition in: \(host.hostname, privacy: .public)")
-        throw POSIXError(.EINVAL)
-      }
-      for s in values {
-        try _expands(host.with(hostname: "\(prefix)\(s)\(suffix)"), limit: limit, into: &into)
+    var total = 0
+    if clusters?.isEmpty ?? true, !host.pattern.isNetwork {
+      let (result, overflow) = host.pattern.count.multipliedReportingOverflow(by: perHost)
+      total = overflow ? .max : result
+    } else {
+      for idx in 0..<host.pattern.count {
+        host.pattern.hostname(at: idx, into: &buffer)
+        if let members = clusters?[buffer] {
+          for member in members {
+            total += try count(HostSpec(member: member), multiplier: multiplier, clusters: nil, limit: limit - total, buffer: &buffer)
+          }
+        } else if host.pattern.isNetwork {
+          guard let network = HostPattern.Network(buffer) else {
+            logger.warning("invalid IP address: \(buffer, privacy: .public)")
+            throw POSIXError(.EINVAL)
+          }
+          total += network.count * perHost
+        } else {
+          total += perHost
+        }
+        guard total <= limit else { break }
       }
-      return
     }
     
-    // If not range remaining, try to interpret it as an IP network notation.
-    // Loosy regex as '/' is not valid in an hostname.
-    if host.hostname.wholeMatch(of: /(.+)\/(.+)/.repetitionBehavior(.reluctant)) != nil {
-      guard let values = _expand(ip: host.hostname, limit: limit - into.count) else {
-        logger.warning("invalid IP address: \(host.hostname, privacy: .public)")
-        throw POSIXError(.EINVAL)
-      }
-      for s in values {
-        try _expands(host.with(hostname: s), limit: limit, into: &into)
-      }
-      return
+    guard total <= limit else {
+      logger.warning("too many hosts: \(host.hostname, privacy: .public) (limit: \(limit))")
+      throw POSIXError(.E2BIG)
     }
+    return total
+  }
+  
+  func makeIterator() throws -> Iterator {
+    Iterator(hosts: hosts, clusters: try clusters.compiled().members ?? [:])
+  }
+  
+  /// Lazily resolve hosts, one target at a time.
+  ///
+  /// The iterator keeps a cursor per spec being expanded (the hosts specs, and the current cluster members),
+  /// so memory does not depend on the number of generated targets.
+  struct Iterator {
     
-    // Finally, try to expand port range, and create resulting Target.
-    guard let p = host.port else {
-      into.append(Target(user: host.user, hostname: host.hostname, port: nil, command: host.command))
-      return
+    private struct Cursor {
+      let specs: [HostSpec]
+      // repeat count inherited from the parent cluster spec.
+      let multiplier: Int
+      // false for cluster members, which are already flattened.
+      let clusters: Bool
+      var spec = 0
+      
+      // current spec state
+      var host = 0
+      var network: HostPattern.Network? = nil
+      var address = 0
+      var hostname: String? = nil
+      var port = 0
+      var repetition = 0
     }
     
-    let ports: [String]?
-    if p.hasPrefix("[") && p.hasSuffix("]") {
-      ports = parse(ranges: String(p.dropFirst().dropLast()), limit: limit - into.count)
-    } else {
-      ports = [p]
-    }
+    private let clusters: [String: [ClusterGraph.Member]]
+    // compiled cluster members
+    private var members = [String: [HostSpec]]()
+    private var stack: [Cursor]
+    private var buffer = ""
     
-    guard let ports else {
-      logger.warning("invalid port range: \(host.hostname, privacy: .public):\(p, privacy: .public)")
-      throw POSIXError(.EINVAL)
+    fileprivate init(hosts: [HostSpec], clusters: [String: [ClusterGraph.Member]]) {
+      self.clusters = clusters
+      stack = [Cursor(specs: hosts, multiplier: 1, clusters: true)]
     }
     
-    for port in ports {
-      guard let portnum = UInt16(port) else {
-        logger.warning("invalid port: \(port, privacy: .public)")
-        throw POSIXError(.EINVAL)
-      }
-      into.append(Target(user: host.user, hostname: host.hostname, port: portnum, command: host.command))
-    }
-  }
-  
-  private func _expand(ip: String, limit: Int) -> [String]? {
-    var addr = in_addr()
-    let bits = inet_net_pton(AF_INET, ip, &addr, MemoryLayout.size(ofValue: addr))
-    guard bits > 0 else {
-      return nil
-    }
-    let mask: UInt32 = ~(0xffffffff >> bits)
-    let start = UInt32(bigEndian: addr.s_addr)
-    // compute last addr by applying netmask.
-    let end = (start & mask) + ~mask
-    guard start < end else {
-      logger.debug("invalid range. start must be less than end: \(ip, privacy: .public)")
-      return nil
-    }
-    guard (start...end).count <= limit else {
-      logger.debug("range too large (\(end - start) > \(limit): \(ip, privacy: .public)")
-      return nil
-    }
-    var addrs = [String]()
-    for i in start...end {
-      addr.s_addr = i.bigEndian
-      // return addr create using inet_ntoa
-      guard let str = inet_ntoa(addr) else {
-        return nil
-      }
-      addrs.append(String(cString: str))
-    }
-    return addrs
-  }
-  
-  // range:
-  // • [foo,bar,misc]
-  // • [12-24]
-  // • [a-f]
-  // • [foo,1-12,b-g]
-  private func parse(ranges: String, limit: Int) -> [String]? {
-    // split on comma, and then parse individual range if they contains '-'
-    if ranges.contains(",") {
-      var result = [String]()
-      for range in ranges.split(separator: ",") {
-        guard parse(range: String(range), limit: limit, into: &result) else {
-          return nil
+    mutating func next() throws -> Target? {
+      while let cursor = stack.last {
+        let top = stack.count - 1
+        guard cursor.spec < cursor.specs.endIndex else {
+          stack.removeLast()
+          continue
+        }
+        let spec = cursor.specs[cursor.spec]
+        
+        // Emit targets for the current hostname: ports x repeat count.
+        if let hostname = cursor.hostname {
+          let port = spec.ports.map { $0.port(at: cursor.port) }
+          if stack[top].repetition + 1 < spec.repeatCount * cursor.multiplier {
+            stack[top].repetition += 1
+          } else {
+            stack[top].repetition = 0
+            stack[top].port += 1
+            if stack[top].port >= spec.ports?.count ?? 1 {
+              stack[top].port = 0
+              stack[top].hostname = nil
+            }
+          }
+          return Target(user: spec.user, hostname: hostname, port: port, command: spec.command)
+        }
+        
+        // Next address of the current network.
+        if let network = cursor.network {
+          if cursor.address < network.count {
+            stack[top].hostname = network.address(at: cursor.address)
+            stack[top].address += 1
+          } else {
+            stack[top].network = nil
+          }
+          continue
+        }
+        
+        // Next hostname of the current spec.
+        guard cursor.host < spec.pattern.count else {
+          stack[top].spec += 1
+          stack[top].host = 0
+          continue
+        }
+        spec.pattern.hostname(at: cursor.host, into: &buffer)
+        stack[top].host += 1
+        
+        if cursor.clusters, let cluster = clusters[buffer] {
+          // add cluster hosts. user, port and command of the cluster spec are not inherited.
+          let specs = try members[buffer] ?? cluster.map(HostSpec.init(member:))
+          members[buffer] = specs
+          stack.append(Cursor(specs: specs, multiplier: cursor.multiplier * spec.repeatCount, clusters: false))
+        } else if spec.pattern.isNetwork {
+          guard let network = HostPattern.Network(buffer) else {
+            logger.warning("invalid IP address: \(buffer, privacy: .public)")
+            throw POSIXError(.EINVAL)
+          }
+          stack[top].network = network
+          stack[top].address = 0
+        } else {
+          stack[top].hostname = buffer
         }
       }
-      return result
-    }
-    
-    // single range or single value
-    var result = [String]()
-    guard parse(range: ranges, limit: limit, into: &result) else {
       return nil
     }
-    return result
-  }
-
-  nonisolated(unsafe)
-  private static let intRange = Regex {
-    Capture(OneOrMore(.digit)) { Int($0)! }
-    "-"
-    Capture(OneOrMore(.digit)) { Int($0)! }
-  }
-
-  nonisolated(unsafe)
-  private static let alphaRange = Regex {
-    ChoiceOf {
-      Regex {
-        Capture("a"..."z") { $0.first!.asciiValue! }
-        "-"
-        Capture("a"..."z") { $0.first!.asciiValue! }
-      }
-      Regex {
-        Capture("A"..."Z") { $0.first!.asciiValue! }
-        "-"
-        Capture("A"..."Z") { $0.first!.asciiValue! }
-      }
-    }
-  }
-  
-  // start-end
-  private func parse(range: String, limit: Int, into: inout [String]) -> Bool {
-    // single word -> return change unchanged.
-    if range.wholeMatch(of: OneOrMore(.word)) != nil {
-      guard limit >= into.count + 1 else {
-        // limit reached
-        return false
-      }
-      into.append(range)
-      return true
-    } else if let match = range.wholeMatch(of: Self.intRange) {
-      let start = match.output.1
-      let end = match.output.2
-      guard start < end else {
-        logger.debug("invalid range. start must be less than end: \(range, privacy: .public)")
-        return false
-      }
-      guard (start...end).count <= limit else {
-        logger.debug("range too large (\(end - start) > \(limit): \(range, privacy: .public)")
-        return false
-      }
-      for i in start...end {
-        into.append(String(i))
-      }
-      return true
-    } else if let match = range.wholeMatch(of: Self.alphaRange) {
-      // if start and end are lowercase alpha -> return lower char range
-      // if start and end are uppercase alpha -> return upper char range
-      guard let start = match.1 ?? match.3, let end = match.2 ?? match.4 else {
-        fatalError("pattern matches but output is nil ?")
-      }
-      guard start < end else {
-        logger.debug("invalid range. start must be less than end: \(range, privacy: .public)")
-        return false
-      }
-      guard (start...end).count <= limit else {
-        logger.debug("range too large (\(end - start) > \(limit): \(range, privacy: .public)")
-        return false
-      }
-      for i in start...end {
-        into.append(String(UnicodeScalar(i)))
-      }
-      return true
-    }
-    
-    return false
   }
   
   mutating func add(_ host: String, command: String?) throws {
@@ -305,79 +268,34 @@ struct HostList {
   }
   
   mutating func add(_ host: String, to cluster: String) {
-    if (clusters[cluster]?.append(host) == nil) {
-      clusters[cluster] = [host]
-    }
+    clusters.add([host], to: cluster)
   }
   
   mutating func add(_ hosts: [String], to cluster: String) {
-    if (clusters[cluster]?.append(contentsOf: hosts) == nil) {
-      clusters[cluster] = hosts
-    }
-  }
-
-  nonisolated(unsafe)
-  private static let commentExpr = /#.*$/
-
-  nonisolated(unsafe)
-  private static let hostFileLine = Regex {
-    Capture {
-      OneOrMore(.whitespace.inverted)
-    }
-    Optionally {
-      OneOrMore(.whitespace)
-      Capture {
-        ZeroOrMore(.any)
-      }
-    }
+    clusters.add(hosts, to: cluster)
   }
   
+  /// Compile the clusters graph once all definitions are loaded.
+  /// If not called explicitly, the graph is compiled (without cache) each time the hosts are resolved.
+  mutating func compileClusters(cache: URL? = ClusterGraph.defaultCache) throws {
+    try clusters.compile(cache: cache)
+  }
+
   mutating func load(hostFile file: FilePath) throws {
-    // Read each line of the data as it becomes available.
-    try file.readLines { line in
-      // Strip comment (remove anything after '#')
-      guard let match = line.replacing(Self.commentExpr, with: "").wholeMatch(of: Self.hostFileLine) else {
-        return
+    // host [command…]
+    try file.readFields { fields in
+      let host = fields.string(at: 0)
+      do {
+        try add(host, command: fields.count > 1 ? fields.remainder(from: 1) : nil)
+      } catch {
+        throw fields.error("invalid host '\(host)'", column: fields.column(at: 0))
       }
-      try add(String(match.output.1), command: match.output.2.flatMap(String.init))
     }
   }
   
-  mutating func load(clustersFile file: FilePath) throws {
-    // Read each line of the data as it becomes available.
-    try file.readLines { line in
-      // Strip comment (remove anything after '#')
-      let components = line.replacing(Self.commentExpr, with: "")
-      // Split using all whitespaces as delimiter
-        .split(separator: OneOrMore(.whitespace))
-      
-      guard components.count > 1 else { return }
-      
-      // the first entry is a cluster name, following entries are matching hosts
-      let cluster = String(components.first!)
-      let hosts = components.dropFirst()
-      // save cluster into config clusters
-      add(hosts.map(String.init), to: cluster)
-    }
-  }
-}
-
-nonisolated(unsafe)
-private let hostFormat = Regex {
-  Optionally {
-    Regex {
-      Capture(OneOrMore(.any, .reluctant))
-      "@"
-    }
-  }
-  Capture(OneOrMore(.any, .reluctant))
-  Optionally {
-    Regex {
-      ":"
-      Capture {
-        OneOrMore(.any)
-      }
-    }
+  // The file is only parsed when compiling the clusters, and only if the clusters cache is not up to date.
+  mutating func load(clustersFile file: FilePath) {
+    clusters.add(file: file)
   }
 }
 
@@ -388,9 +306,21 @@ extension StringProtocol where Self.SubSequence == Substring {
     //   hostname:port
     //   user@hostname
     //   user@hostname:port
-    guard let result = wholeMatch(of: hostFormat) else {
+    // user ends at the first '@' and hostname at the first ':' (user and hostname can't be empty).
+    var rest = self[...]
+    guard !rest.isEmpty else {
       throw CocoaError(.formatting)
     }
-    return (result.output.1.flatMap(String.init), String(result.output.2), result.output.3.flatMap(String.init));
+    var user: String? = nil
+    if let at = rest.utf8.dropFirst().firstIndex(of: UInt8(ascii: "@")), rest.utf8.index(after: at) < rest.endIndex {
+      user = String(rest[..<at])
+      rest = rest[rest.utf8.index(after: at)...]
+    }
+    var port: String? = nil
+    if let colon = rest.utf8.dropFirst().firstIndex(of: UInt8(ascii: ":")), rest.utf8.index(after: colon) < rest.endIndex {
+      port = String(rest[rest.utf8.index(after: colon)...])
+      rest = rest[..<colon]
+    }
+    return (user, String(rest), port)
   }
 }
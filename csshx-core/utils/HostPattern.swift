@@ -0,0 +1,267 @@
+//
+//  HostPattern.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Compiled hostname pattern.
+///
+/// A pattern like `rack[1-40]-node[001-200].example.com` is tokenized once into a list of segments,
+/// each segment being a literal or a bracket expression. The expanded hostnames are the cartesian product
+/// of all segments, in order, the first segment varying the slowest.
+///
+/// Any hostname can be generated from its index in the product, so the pattern can be counted without
+/// being expanded, and enumerated using constant memory.
+struct HostPattern {
+
+  enum Item {
+    // literal string, or single word in a bracket expression.
+    case word(Substring)
+    // [12-24], [001-200]. width is the zero padding width (0 if not padded).
+    case numbers(ClosedRange<Int>, width: Int)
+    // [a-f], [A-F]
+    case letters(ClosedRange<UInt8>)
+
+    var count: Int {
+      switch self {
+        case .word: 1
+        case .numbers(let range, _): range.count
+        case .letters(let range): range.count
+      }
+    }
+
+    func append(_ index: Int, to string: inout String) {
+      switch self {
+        case .word(let word):
+          string.append(contentsOf: word)
+        case .numbers(let range, let width):
+          let value = String(range.lowerBound + index)
+          if value.utf8.count < width {
+            string.append(contentsOf: repeatElement("0" as Character, count: width - value.utf8.count))
+          }
+          string.append(value)
+        case .letters(let range):
+          string.unicodeScalars.append(UnicodeScalar(range.lowerBound + UInt8(index)))
+      }
+    }
+  }
+
+  // A literal, or a bracket expression: [foo,1-12,b-g]
+  struct Segment {
+    let items: [Item]
+    let count: Int
+
+    init(_ items: [Item]) {
+      self.items = items
+      count = items.reduce(0) { $0 + $1.count }
+    }
+
+    func append(_ index: Int, to string: inout String) {
+      var index = index
+      for item in items {
+        if index < item.count {
+          item.append(index, to: &string)
+          return
+        }
+        index -= item.count
+      }
+    }
+  }
+
+  let segments: [Segment]
+  // Number of hostnames generated by this pattern (saturated to Int.max).
+  let count: Int
+  // true if the generated hostnames are IP networks (192.168.0.0/24), that must be expanded into addresses.
+  let isNetwork: Bool
+
+  init(_ pattern: some StringProtocol) throws {
+    var segments = [Segment]()
+    var literal = pattern.startIndex
+    var idx = pattern.startIndex
+    while idx < pattern.endIndex {
+      guard pattern[idx] == "[" else {
+        idx = pattern.index(after: idx)
+        continue
+      }
+      guard let end = pattern[idx...].firstIndex(of: "]") else {
+        logger.warning("unterminated range definition in: \(String(pattern), privacy: .public)")
+        throw POSIXError(.EINVAL)
+      }
+      if literal < idx {
+        segments.append(Segment([.word(Substring(pattern[literal..<idx]))]))
+      }
+      segments.append(try Self.parse(ranges: Substring(pattern[pattern.index(after: idx)..<end]), in: pattern))
+      idx = pattern.index(after: end)
+      literal = idx
+    }
+    if literal < pattern.endIndex {
+      segments.append(Segment([.word(Substring(pattern[literal...]))]))
+    }
+
+    self.segments = segments
+    count = segments.reduce(1) { count, segment in
+      let (result, overflow) = count.multipliedReportingOverflow(by: segment.count)
+      return overflow ? .max : result
+    }
+    // Loosy test as '/' is not valid in an hostname.
+    isNetwork = pattern.contains("/")
+  }
+
+  /// Generate the hostname at `index` in the product of all segments.
+  func hostname(at index: Int, into string: inout String) {
+    string.removeAll(keepingCapacity: true)
+    // Mixed radix decomposition, the first segment being the most significant digit.
+    var divisor = count
+    var index = index
+    for segment in segments {
+      divisor /= segment.count
+      segment.append(index / divisor, to: &string)
+      index %= divisor
+    }
+  }
+
+  func hostname(at index: Int) -> String {
+    var string = ""
+    hostname(at: index, into: &string)
+    return string
+  }
+
+  // range:
+  // • [foo,bar,misc]
+  // • [12-24]
+  // • [001-200]
+  // • [a-f]
+  // • [foo,1-12,b-g]
+  private static func parse(ranges: Substring, in pattern: some StringProtocol) throws -> Segment {
+    var items = [Item]()
+    for range in ranges.split(separator: ",", omittingEmptySubsequences: false) {
+      guard let item = parse(range: range) else {
+        logger.warning("invalid range definition in: \(String(pattern), privacy: .public)")
+        throw POSIXError(.EINVAL)
+      }
+      items.append(item)
+    }
+    return Segment(items)
+  }
+
+  // start-end or single word
+  static func parse(range: Substring) -> Item? {
+    guard let dash = range.firstIndex(of: "-") else {
+      // single word -> return it unchanged.
+      guard !range.isEmpty, range.allSatisfy({ $0.isLetter || $0.isNumber || $0 == "_" }) else { return nil }
+      return .word(range)
+    }
+
+    let lhs = range[..<dash]
+    let rhs = range[range.index(after: dash)...]
+    if lhs.allSatisfy(\.isASCIIDigit), rhs.allSatisfy(\.isASCIIDigit),
+       let start = Int(lhs), let end = Int(rhs) {
+      guard start < end else {
+        logger.debug("invalid range. start must be less than end: \(String(range), privacy: .public)")
+        return nil
+      }
+      // leading zero -> zero padded range.
+      return .numbers(start...end, width: lhs.count > 1 && lhs.first == "0" ? lhs.count : 0)
+    }
+
+    // if start and end are lowercase alpha -> return lower char range
+    // if start and end are uppercase alpha -> return upper char range
+    if lhs.count == 1, rhs.count == 1, let start = lhs.first?.asciiValue, let end = rhs.first?.asciiValue,
+       (lhs.first!.isLowercase && rhs.first!.isLowercase) || (lhs.first!.isUppercase && rhs.first!.isUppercase),
+       lhs.first!.isLetter, rhs.first!.isLetter {
+      guard start < end else {
+        logger.debug("invalid range. start must be less than end: \(String(range), privacy: .public)")
+        return nil
+      }
+      return .letters(start...end)
+    }
+    return nil
+  }
+}
+
+// MARK: - Networks
+extension HostPattern {
+
+  /// IPv4 network range, from the network notation address to the end of the network.
+  /// 1.2.3.75/28 -> 1.2.3.75 ... 1.2.3.79
+  struct Network {
+    let start: UInt32
+    let end: UInt32
+
+    var count: Int { Int(end - start) + 1 }
+
+    init?(_ ip: String) {
+      var addr = in_addr()
+      let bits = inet_net_pton(AF_INET, ip, &addr, MemoryLayout.size(ofValue: addr))
+      guard bits > 0 else {
+        return nil
+      }
+      let mask: UInt32 = ~(0xffffffff >> bits)
+      start = UInt32(bigEndian: addr.s_addr)
+      // compute last addr by applying netmask.
+      end = (start & mask) + ~mask
+      guard start < end else {
+        logger.debug("invalid range. start must be less than end: \(ip, privacy: .public)")
+        return nil
+      }
+    }
+
+    func address(at index: Int) -> String {
+      let addr = start + UInt32(index)
+      return "\(addr >> 24).\((addr >> 16) & 0xff).\((addr >> 8) & 0xff).\(addr & 0xff)"
+    }
+  }
+}
+
+// MARK: - Ports
+extension HostPattern {
+
+  /// Port or port range (`22`, `[22-24,2222]`).
+  struct Ports {
+    private let segment: Segment
+
+    var count: Int { segment.count }
+
+    init(_ port: String) throws {
+      if port.hasPrefix("[") && port.hasSuffix("]") {
+        segment = try HostPattern.parse(ranges: port.dropFirst().dropLast(), in: port)
+      } else {
+        segment = Segment([.word(Substring(port))])
+      }
+      // Validate all values now, so the iteration cannot fail.
+      for item in segment.items {
+        switch item {
+          case .word(let word) where UInt16(word) != nil:
+            continue
+          case .numbers(let range, _) where range.upperBound <= UInt16.max:
+            continue
+          default:
+            logger.warning("invalid port: \(port, privacy: .public)")
+            throw POSIXError(.EINVAL)
+        }
+      }
+    }
+
+    func port(at index: Int) -> UInt16 {
+      var index = index
+      for item in segment.items {
+        if index < item.count {
+          switch item {
+            case .word(let word): return UInt16(word)!
+            case .numbers(let range, _): return UInt16(range.lowerBound + index)
+            case .letters: fatalError("invalid port item")
+          }
+        }
+        index -= item.count
+      }
+      fatalError("port index out of range")
+    }
+  }
+}
+
+private extension Character {
+  var isASCIIDigit: Bool { isASCII && isNumber }
+}
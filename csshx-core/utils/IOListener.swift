@@ -0,0 +1,74 @@
+//
+//  IOListener.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+class IOListener {
+  
+  private let path: String
+  private let socket: Int32
+  
+  private var listening: (any DispatchSourceRead)? = nil
+  
+  fileprivate init(socket: Int32, path: String) {
+    self.socket = socket
+    self.path = path
+  }
+  
+  private func _close() {
+    Darwin.close(socket)
+    unlink(path)
+  }
+  
+  // Source cancel handler
+  func close() {
+    // If started, the async stream take reponsability for cleanup
+    if let listening {
+      listening.cancel()
+    } else {
+      _close()
+    }
+  }
+  
+  /// Accept connections on `queue`. The handler is always called on the main queue.
+  func startWaiting(queue: DispatchQueue = .main, _ handler: @escaping (Result<Int32, any Error>) -> Void) {
+    guard listening == nil else {
+      return
+    }
+    
+    let source = DispatchSource.makeReadSource(fileDescriptor: socket, queue: queue)
+    listening = source
+    
+    source.setEventHandler { [socket] in
+      var client_addr = sockaddr()
+      var client_addrlen = UInt32(MemoryLayout.size(ofValue: client_addr))
+      let client_fd = Darwin.accept(socket, &client_addr, &client_addrlen)
+      let result: Result<Int32, any Error> = client_fd < 0 ? .failure(POSIXError.errno) : .success(client_fd)
+      if Thread.isMainThread {
+        handler(result)
+      } else {
+        DispatchQueue.main.asyncUnsafe { handler(result) }
+      }
+    }
+    source.setCancelHandler {
+      self._close()
+    }
+    
+    source.activate()
+  }
+}
+
+extension IOListener {
+  static func listen(socket: String) throws -> IOListener {
+    let fd = try Socket.bind(socket, umask: 0o077)
+    if Darwin.listen(fd, 256) != 0 {
+      throw POSIXError.errno
+    }
+    
+    return IOListener(socket: fd, path: socket)
+  }
+}
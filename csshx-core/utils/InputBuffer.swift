@@ -0,0 +1,112 @@
+//
+//  InputBuffer.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Controller input bytes, waiting to be parsed by the input modes.
+///
+/// Consuming bytes only advances a read cursor. The consumed prefix is discarded when new data is appended, and
+/// only the unread bytes are moved (if any), so processing a large paste is linear in its size.
+/// Unread bytes are always contiguous, and can be passed to the broadcast layer without intermediate copy.
+struct InputBuffer {
+
+  private var storage: [UInt8]
+  // Read cursor
+  private var head = 0
+
+  init(capacity: Int = 256) {
+    storage = []
+    storage.reserveCapacity(capacity)
+  }
+
+  init(_ bytes: some Sequence<UInt8>) {
+    storage = Array(bytes)
+  }
+
+  var count: Int { storage.count - head }
+  var isEmpty: Bool { head == storage.count }
+  var first: UInt8? { isEmpty ? nil : storage[head] }
+
+  /// Unread bytes.
+  var bytes: ArraySlice<UInt8> { storage[head...] }
+
+  subscript(offset: Int) -> UInt8 {
+    precondition(offset >= 0 && offset < count)
+    return storage[head + offset]
+  }
+
+  // MARK: Writing
+  mutating func append(_ data: DispatchData) {
+    compact()
+    storage.append(contentsOf: data)
+  }
+
+  mutating func append(_ bytes: some Sequence<UInt8>) {
+    compact()
+    storage.append(contentsOf: bytes)
+  }
+
+  private mutating func compact() {
+    guard head > 0 else { return }
+    if head == storage.count {
+      storage.removeAll(keepingCapacity: true)
+    } else {
+      storage.removeSubrange(..<head)
+    }
+    head = 0
+  }
+
+  // MARK: Reading
+  mutating func removeFirst(_ count: Int = 1) {
+    precondition(count >= 0 && count <= self.count)
+    head += count
+  }
+
+  mutating func removeAll() {
+    head = storage.count
+  }
+
+  /// Remove the leading bytes matching predicate.
+  mutating func trimPrefix(while predicate: (UInt8) throws -> Bool) rethrows {
+    while head < storage.count, try predicate(storage[head]) {
+      head += 1
+    }
+  }
+
+  /// Offset of the first occurrence of byte in the unread bytes.
+  func firstIndex(of byte: UInt8) -> Int? {
+    withUnsafeBytes { bytes in
+      guard let base = bytes.baseAddress, let match = memchr(base, Int32(byte), bytes.count) else { return nil }
+      return base.distance(to: UnsafeRawPointer(match))
+    }
+  }
+
+  func contains(_ byte: UInt8) -> Bool {
+    firstIndex(of: byte) != nil
+  }
+
+  func starts(with prefix: some Sequence<UInt8>) -> Bool {
+    storage[head...].starts(with: prefix)
+  }
+
+  /// Access the unread bytes.
+  func withUnsafeBytes<R>(_ body: (UnsafeRawBufferPointer) throws -> R) rethrows -> R {
+    try storage.withUnsafeBytes { storage in
+      try body(UnsafeRawBufferPointer(rebasing: storage[head...]))
+    }
+  }
+
+  /// Pass the next `count` bytes to body, and consume them.
+  mutating func consume<R>(_ count: Int, _ body: (UnsafeRawBufferPointer) throws -> R) rethrows -> R {
+    precondition(count >= 0 && count <= self.count)
+    let result = try withUnsafeBytes { bytes in
+      try body(UnsafeRawBufferPointer(rebasing: bytes[..<count]))
+    }
+    head += count
+    return result
+  }
+}
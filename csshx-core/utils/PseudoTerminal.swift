@@ -0,0 +1,56 @@
+//
+//  PseudoTerminal.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Master side of a pseudo terminal pair.
+///
+/// Writing into the master is equivalent to typing into the slave terminal,
+/// so a whole chunk of input can be injected using a single write() call.
+struct PseudoTerminal {
+
+  let master: Int32
+  // path of the slave device (/dev/ttysXXX)
+  let slave: String
+
+  static func open() throws -> PseudoTerminal {
+    let fd = posix_openpt(O_RDWR | O_NOCTTY)
+    guard fd >= 0 else {
+      throw POSIXError.errno
+    }
+
+    guard grantpt(fd) == 0, unlockpt(fd) == 0, let name = ptsname(fd) else {
+      let err = POSIXError.errno
+      Darwin.close(fd)
+      throw err
+    }
+    // Do not leak the master into spawned processes.
+    _ = fcntl(fd, F_SETFD, FD_CLOEXEC)
+
+    return PseudoTerminal(master: fd, slave: String(cString: name))
+  }
+
+  func close() {
+    Darwin.close(master)
+  }
+
+  var windowSize: winsize? {
+    get { Self.windowSize(of: master) }
+    nonmutating set {
+      guard var size = newValue else { return }
+      _ = ioctl(master, TIOCSWINSZ, &size)
+    }
+  }
+
+  static func windowSize(of fd: Int32) -> winsize? {
+    var size = winsize()
+    guard ioctl(fd, TIOCGWINSZ, &size) == 0 else {
+      return nil
+    }
+    return size
+  }
+}
@@ -0,0 +1,316 @@
+//
+//  Reachability.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Pre-flight hosts check (ping test).
+///
+/// Hostnames are resolved concurrently with bounded parallelism, each distinct hostname being resolved once
+/// (results are cached for the lifetime of the checker). Resolved hosts are then probed using an ICMP echo
+/// request per address, or a TCP connect per address/port.
+///
+/// ICMP uses an unprivileged datagram socket. When such socket cannot be created (or for IPv6 addresses),
+/// the TCP probe is used instead, on the target ssh port.
+final class Reachability: @unchecked Sendable {
+
+  enum Method: String, CaseIterable, Sendable {
+    case icmp
+    case tcp
+  }
+
+  struct Options: Sendable {
+    var method: Method = .icmp
+    // probe timeout in milliseconds.
+    var timeout: Int = 2000
+    // max number of concurrent lookups/probes.
+    var concurrency: Int = 64
+  }
+
+  enum Status: Equatable, Sendable, CustomStringConvertible {
+    case reachable
+    // getaddrinfo error
+    case unresolved(Int32)
+    case unreachable(POSIXErrorCode)
+
+    var description: String {
+      switch self {
+        case .reachable: "reachable"
+        case .unresolved(let error): "cannot resolve host: \(String(cString: gai_strerror(error)))"
+        case .unreachable(let code): "unreachable: \(String(cString: strerror(code.rawValue)))"
+      }
+    }
+  }
+
+  let options: Options
+
+  private let lock = NSLock()
+  private var cache = [String: Resolution]()
+  // number of getaddrinfo calls, for diagnostic.
+  private(set) var lookups = 0
+
+  private let queue = DispatchQueue(label: "com.xenonium.csshx.reachability", attributes: .concurrent)
+
+  init(options: Options = Options()) {
+    self.options = options
+  }
+
+  /// Check all targets, blocking until done.
+  /// - Returns: the status of each target, in order.
+  func check(_ targets: [Target]) -> [Status] {
+    // 1. resolve distinct hostnames.
+    let hostnames = Array(Set(targets.map(\.hostname)))
+    forEach(hostnames) { [self] hostname in
+      _ = resolve(hostname)
+    }
+
+    // 2. probe distinct address/port pairs. The port is needed by ICMP probes too, for the TCP fallback.
+    let probes = Array(Set(targets.map(Probe.init)))
+    let results = Box<[Probe: Status]>([:])
+    forEach(probes) { [self] probe in
+      let status = self.probe(probe)
+      results.withLock { $0[probe] = status }
+    }
+
+    return results.withLock { results in
+      targets.map { target in
+        results[Probe(target)] ?? .unreachable(.EINVAL)
+      }
+    }
+  }
+
+  // MARK: Parallelism
+  // Run body on at most `concurrency` items at a time, and wait for completion.
+  private func forEach<T: Sendable>(_ items: [T], _ body: @escaping @Sendable (T) -> Void) {
+    let next = Box(0)
+    let group = DispatchGroup()
+    for _ in 0..<min(max(1, options.concurrency), items.count) {
+      queue.async(group: group) {
+        while true {
+          let idx = next.withLock { value in
+            defer { value += 1 }
+            return value
+          }
+          guard idx < items.count else { return }
+          body(items[idx])
+        }
+      }
+    }
+    group.wait()
+  }
+
+  // MARK: DNS
+  private struct Address: Sendable {
+    var storage = sockaddr_storage()
+    var length: socklen_t = 0
+
+    var family: Int32 { Int32(storage.ss_family) }
+
+    func with<R>(port: UInt16?, _ body: (UnsafePointer<sockaddr>, socklen_t) -> R) -> R {
+      var addr = storage
+      if let port {
+        withUnsafeMutablePointer(to: &addr) { ptr in
+          if family == AF_INET {
+            ptr.withMemoryRebound(to: sockaddr_in.self, capacity: 1) { $0.pointee.sin_port = port.bigEndian }
+          } else if family == AF_INET6 {
+            ptr.withMemoryRebound(to: sockaddr_in6.self, capacity: 1) { $0.pointee.sin6_port = port.bigEndian }
+          }
+        }
+      }
+      return withUnsafePointer(to: &addr) { ptr in
+        ptr.withMemoryRebound(to: sockaddr.self, capacity: 1) { body($0, length) }
+      }
+    }
+  }
+
+  private typealias Resolution = Result<Address, GAIError>
+
+  private struct GAIError: Error {
+    let code: Int32
+  }
+
+  private func resolve(_ hostname: String) -> Resolution {
+    if let cached = lock.withLock({ cache[hostname] }) {
+      return cached
+    }
+
+    var hints = addrinfo()
+    hints.ai_family = AF_UNSPEC
+    hints.ai_socktype = SOCK_STREAM
+    var info: UnsafeMutablePointer<addrinfo>? = nil
+    let err = getaddrinfo(hostname, nil, &hints, &info)
+    defer { if let info { freeaddrinfo(info) } }
+
+    var resolution = Resolution.failure(GAIError(code: err == 0 ? EAI_NONAME : err))
+    if err == 0 {
+      // Prefer IPv4, as ICMP is not supported for IPv6.
+      var first: UnsafeMutablePointer<addrinfo>? = nil
+      var cursor = info
+      while let ai = cursor {
+        if first == nil || ai.pointee.ai_family == AF_INET && first?.pointee.ai_family != AF_INET {
+          first = ai
+        }
+        cursor = ai.pointee.ai_next
+      }
+      if let ai = first?.pointee, let addr = ai.ai_addr {
+        var address = Address()
+        address.length = ai.ai_addrlen
+        withUnsafeMutableBytes(of: &address.storage) { storage in
+          storage.copyMemory(from: UnsafeRawBufferPointer(start: addr, count: Int(ai.ai_addrlen)))
+        }
+        resolution = .success(address)
+      }
+    }
+
+    lock.withLock {
+      lookups += 1
+      cache[hostname] = resolution
+    }
+    return resolution
+  }
+
+  // MARK: Probes
+  private struct Probe: Hashable, Sendable {
+    let hostname: String
+    // ssh port
+    let port: UInt16
+
+    init(_ target: Target) {
+      hostname = target.hostname
+      port = target.port ?? 22
+    }
+  }
+
+  private func probe(_ probe: Probe) -> Status {
+    let address: Address
+    switch resolve(probe.hostname) {
+      case .success(let addr): address = addr
+      case .failure(let error): return .unresolved(error.code)
+    }
+
+    if options.method == .icmp, address.family == AF_INET, let status = icmp(address) {
+      return status
+    }
+    return tcp(address, port: probe.port)
+  }
+
+  private func tcp(_ address: Address, port: UInt16) -> Status {
+    let fd = socket(address.family, SOCK_STREAM, IPPROTO_TCP)
+    guard fd >= 0 else { return .unreachable(POSIXError.errno.code) }
+    defer { close(fd) }
+
+    var on: Int32 = 1
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, socklen_t(MemoryLayout<Int32>.size))
+    _ = fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK)
+
+    let result = address.with(port: port) { connect(fd, $0, $1) }
+    if result == 0 {
+      return .reachable
+    }
+    guard errno == EINPROGRESS else {
+      return .unreachable(POSIXError.errno.code)
+    }
+
+    var pfd = pollfd(fd: fd, events: Int16(POLLOUT), revents: 0)
+    let ready = poll(&pfd, 1, Int32(options.timeout))
+    guard ready > 0 else {
+      return .unreachable(ready == 0 ? .ETIMEDOUT : POSIXError.errno.code)
+    }
+    var err: Int32 = 0
+    var len = socklen_t(MemoryLayout<Int32>.size)
+    guard getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 else {
+      return .unreachable(POSIXError.errno.code)
+    }
+    return err == 0 ? .reachable : .unreachable(POSIXErrorCode(rawValue: err) ?? .EHOSTUNREACH)
+  }
+
+  // Sequence number shared by all ICMP probes, so concurrent probes do not steal each other replies.
+  private var sequence: UInt16 = 0
+
+  /// - Returns: nil if ICMP sockets are not permitted.
+  private func icmp(_ address: Address) -> Status? {
+    let fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP)
+    guard fd >= 0 else {
+      logger.info("ICMP socket not permitted (\(POSIXError.errno, privacy: .public)). Using TCP probes")
+      return nil
+    }
+    defer { close(fd) }
+
+    let identifier = UInt16(truncatingIfNeeded: getpid())
+    let seq = lock.withLock {
+      sequence &+= 1
+      return sequence
+    }
+
+    // echo request: type, code, checksum, identifier, sequence + 8 bytes payload.
+    var packet = [UInt8](repeating: 0, count: 16)
+    packet[0] = 8 // ICMP_ECHO
+    packet[4] = UInt8(identifier >> 8)
+    packet[5] = UInt8(identifier & 0xff)
+    packet[6] = UInt8(seq >> 8)
+    packet[7] = UInt8(seq & 0xff)
+    let checksum = Self.checksum(packet)
+    packet[2] = UInt8(checksum >> 8)
+    packet[3] = UInt8(checksum & 0xff)
+
+    let sent = address.with(port: nil) { sendto(fd, packet, packet.count, 0, $0, $1) }
+    guard sent == packet.count else {
+      return .unreachable(POSIXError.errno.code)
+    }
+
+    let deadline = DispatchTime.now() + .milliseconds(options.timeout)
+    var buffer = [UInt8](repeating: 0, count: 1500)
+    while true {
+      let now = DispatchTime.now()
+      guard now < deadline else { return .unreachable(.ETIMEDOUT) }
+      var pfd = pollfd(fd: fd, events: Int16(POLLIN), revents: 0)
+      let remaining = Int32((deadline.uptimeNanoseconds - now.uptimeNanoseconds) / 1_000_000)
+      guard poll(&pfd, 1, max(1, remaining)) > 0 else { continue }
+
+      let count = recv(fd, &buffer, buffer.count, 0)
+      guard count > 0 else { continue }
+      // Replies include the IP header.
+      let offset = Int(buffer[0] & 0x0f) * 4
+      guard count >= offset + 8 else { continue }
+      // echo reply (0) matching our identifier and sequence.
+      if buffer[offset] == 0,
+         UInt16(buffer[offset + 4]) << 8 | UInt16(buffer[offset + 5]) == identifier,
+         UInt16(buffer[offset + 6]) << 8 | UInt16(buffer[offset + 7]) == seq {
+        return .reachable
+      }
+    }
+  }
+
+  static func checksum(_ bytes: [UInt8]) -> UInt16 {
+    var sum: UInt32 = 0
+    var idx = 0
+    while idx + 1 < bytes.count {
+      sum += UInt32(bytes[idx]) << 8 | UInt32(bytes[idx + 1])
+      idx += 2
+    }
+    if idx < bytes.count {
+      sum += UInt32(bytes[idx]) << 8
+    }
+    while sum >> 16 != 0 {
+      sum = (sum & 0xffff) + (sum >> 16)
+    }
+    return ~UInt16(sum)
+  }
+}
+
+// Lock protected value, shared with concurrent work items.
+private final class Box<Value>: @unchecked Sendable {
+  private let lock = NSLock()
+  private var value: Value
+
+  init(_ value: Value) {
+    self.value = value
+  }
+
+  func withLock<R>(_ body: (inout Value) -> R) -> R {
+    lock.withLock { body(&value) }
+  }
+}
@@ -0,0 +1,76 @@
+//
+//  RingBuffer.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Bounded byte buffer keeping the last `capacity` bytes written.
+///
+/// Storage grows with the content up to the capacity, so idle sessions do not pay for the full buffer.
+struct RingBuffer {
+
+  let capacity: Int
+
+  private var storage = [UInt8]()
+  // Oldest byte position, once the buffer is full (0 until then).
+  private var head = 0
+  // Total number of bytes ever appended.
+  private(set) var total: UInt64 = 0
+
+  var count: Int { storage.count }
+  var isEmpty: Bool { storage.isEmpty }
+
+  init(capacity: Int) {
+    self.capacity = Swift.max(0, capacity)
+  }
+
+  mutating func append(_ bytes: UnsafeRawBufferPointer) {
+    total += UInt64(bytes.count)
+    guard capacity > 0, !bytes.isEmpty else { return }
+
+    var bytes = bytes
+    if bytes.count >= capacity {
+      // Only the tail survives.
+      storage = Array(bytes[(bytes.count - capacity)...])
+      head = 0
+      return
+    }
+
+    if storage.count < capacity {
+      let count = Swift.min(capacity - storage.count, bytes.count)
+      storage.append(contentsOf: bytes[..<count])
+      bytes = UnsafeRawBufferPointer(rebasing: bytes[count...])
+    }
+
+    // Full: overwrite the oldest bytes.
+    while !bytes.isEmpty {
+      let start = head
+      let count = Swift.min(capacity - start, bytes.count)
+      let chunk = UnsafeRawBufferPointer(rebasing: bytes[..<count])
+      storage.withUnsafeMutableBytes { storage in
+        UnsafeMutableRawBufferPointer(rebasing: storage[start..<start + count]).copyMemory(from: chunk)
+      }
+      head = (start + count) % capacity
+      bytes = UnsafeRawBufferPointer(rebasing: bytes[count...])
+    }
+  }
+
+  mutating func append(_ data: DispatchData) {
+    for region in data.regions {
+      region.withUnsafeBytes { append($0) }
+    }
+  }
+
+  mutating func removeAll() {
+    storage = []
+    head = 0
+  }
+
+  /// Content, from the oldest to the newest byte.
+  var bytes: [UInt8] {
+    Array(storage[head...] + storage[..<head])
+  }
+}
@@ -0,0 +1,185 @@
+//
+//  SSHMasters.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Pre-warmed ssh master connections (ssh ControlMaster), shared by the hosts sessions.
+///
+/// A master is started in the background for each distinct target (user, hostname and port), with at most
+/// `concurrency` masters starting at a time, while the hosts windows are being created. Hosts ssh use the master of
+/// their target through its control socket once it is ready (with `ControlMaster=no`, they connect directly
+/// otherwise), so a host re-added or launched again does not pay the ssh handshake.
+///
+/// Masters are started through the shell, like the hosts, so `ssh_args` apply to both. They never prompt
+/// (`BatchMode`), and are stopped (`ssh -O exit`) when the controller closes, unless they persist.
+/// Idle masters exit by themselves after `persist` seconds (at least a minute), so they do not outlive
+/// a controller that did not close properly.
+final class SSHMasters {
+
+  struct Options {
+    var ssh: String = "ssh"
+    // Raw ssh arguments, parsed by the shell.
+    var sshArgs: String? = nil
+    // Control sockets directory.
+    var directory: String = FileManager.default.temporaryDirectory.appendingPathComponent("csshx-ssh").path
+    // Max number of masters starting at a time.
+    var concurrency: Int = 16
+    // Seconds a master is kept once idle, after the controller closed. 0 to stop masters on close.
+    var persist: Int = 0
+  }
+
+  enum State: Equatable {
+    case pending
+    case starting
+    case ready
+    case failed
+  }
+
+  private static let minIdleTimeout = 60
+
+  let options: Options
+  // By control path.
+  private(set) var states = [String: State]()
+  private var targets = [String: Target]()
+  private var pending = [(path: String, target: Target)]()
+  private var starting = 0
+  private var closed = false
+  // Called each time no master is left pending or starting.
+  var onIdle: (() -> Void)? = nil
+
+  init(options: Options) {
+    self.options = options
+    if mkdir(options.directory, 0o700) != 0 && errno != EEXIST {
+      logger.warning("failed to create ssh control directory: \(String(cString: strerror(errno)), privacy: .public)")
+    }
+  }
+
+  var isIdle: Bool { pending.isEmpty && starting == 0 }
+
+  /// Control socket of the target master. The path is stable across sessions.
+  func controlPath(for target: Target) -> String {
+    var key = "\(target.user ?? "")@\(target.hostname):\(target.port.map(String.init) ?? "")"
+    let hash = key.withUTF8 { bytes in
+      var hasher = StreamHasher()
+      hasher.update(UnsafeRawBufferPointer(bytes))
+      return hasher.finalize()
+    }
+    return options.directory + "/" + String(hash, radix: 16)
+  }
+
+  /// Start the masters of the targets, in order. Targets sharing a master are started once.
+  func prewarm(_ hosts: [Target]) {
+    guard !closed else { return }
+    for target in hosts {
+      let path = controlPath(for: target)
+      // Failed masters are retried, as the host may be up again.
+      guard states[path] == nil || states[path] == .failed else { continue }
+      states[path] = .pending
+      targets[path] = target
+      pending.append((path, target))
+    }
+    startNext()
+  }
+
+  func close() {
+    guard !closed else { return }
+    closed = true
+    pending.removeAll()
+    guard options.persist == 0 else { return }
+    // Masters still starting are stopped once started (see `startNext()`).
+    for (path, state) in states where state == .ready {
+      stop(path)
+    }
+  }
+
+  private func stop(_ path: String) {
+    guard let target = targets[path] else { return }
+    if let pid = spawn("exec " + Shell.quote(args: [options.ssh, "-O", "exit", "-o", "ControlPath=\(path)", target.hostname])) {
+      waitFor(pid: pid, queue: .main) { _ in }
+    }
+  }
+
+  private func startNext() {
+    while starting < max(1, options.concurrency), !pending.isEmpty, !closed {
+      let (path, target) = pending.removeFirst()
+      guard let pid = spawn(command(target, path: path)) else {
+        states[path] = .failed
+        continue
+      }
+      states[path] = .starting
+      starting += 1
+      // With -f, ssh goes to the background once the connection is established.
+      waitFor(pid: pid, queue: .main) { [self] status in
+        starting -= 1
+        states[path] = status == 0 ? .ready : .failed
+        if status != 0 {
+          logger.info("ssh master for \(target.connectionString, privacy: .public) failed with status \(status)")
+        } else if closed, options.persist == 0 {
+          // Started after the controller closed: must not outlive the session.
+          stop(path)
+        }
+        startNext()
+      }
+    }
+    if isIdle {
+      onIdle?()
+    }
+  }
+
+  private func command(_ target: Target, path: String) -> String {
+    var args = [
+      options.ssh, "-M", "-N", "-f",
+      "-o", "BatchMode=yes",
+      "-o", "ControlPath=\(path)",
+      "-o", "ControlPersist=\(max(options.persist, Self.minIdleTimeout))",
+    ]
+    if let user = target.user {
+      args.append(contentsOf: ["-l", user])
+    }
+    if let port = target.port {
+      args.append(contentsOf: ["-p", String(port)])
+    }
+    var script = "exec " + Shell.quote(args: args)
+    if let sshArgs = options.sshArgs {
+      script.append(" ")
+      script.append(sshArgs)
+    }
+    script.append(" ")
+    script.append(Shell.quote(arg: target.hostname))
+    return script
+  }
+
+  // Run the command through the shell, without terminal (masters must never prompt).
+  private func spawn(_ script: String) -> pid_t? {
+    var actions: posix_spawn_file_actions_t? = nil
+    posix_spawn_file_actions_init(&actions)
+    defer { posix_spawn_file_actions_destroy(&actions) }
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0)
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0)
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0)
+
+    // The controller ignores some signals (SIGINT, SIGPIPE, …). Restore them.
+    var attr: posix_spawnattr_t? = nil
+    posix_spawnattr_init(&attr)
+    defer { posix_spawnattr_destroy(&attr) }
+    var signals = sigset_t()
+    sigfillset(&signals)
+    posix_spawnattr_setsigdefault(&attr, &signals)
+    posix_spawnattr_setflags(&attr, Int16(POSIX_SPAWN_SETSIGDEF))
+
+    var pid: pid_t = 0
+    let args = ["/bin/sh", "-c", script]
+    let err = args.withCStrings { argv in
+      posix_spawn(&pid, args[0], &actions, &attr, argv, environ)
+    }
+    guard err == 0 else {
+      logger.warning("failed to start ssh master: \(String(cString: strerror(err)), privacy: .public)")
+      return nil
+    }
+    return pid
+  }
+}
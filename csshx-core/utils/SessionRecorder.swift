@@ -0,0 +1,212 @@
+//
+//  SessionRecorder.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+// Session recording format.
+//
+// A recording starts with the 'CSXR' magic, followed by the format version (UInt8),
+// then a sequence of records, each starting with its type (UInt8):
+//   - host (1): id: UInt32, length: UInt16, host connection string (UTF-8).
+//     Declares a host, before the first input targeting it.
+//   - input (2): time: UInt64 (ns since the recording start), host: UInt32 (0 for broadcast), length: UInt32, bytes.
+//   - targets (3): time: UInt64, count: UInt32, host: UInt32 × count.
+//     Hosts receiving the broadcast input, recorded each time they change (version 2).
+// All integers are big endian.
+enum SessionRecording {
+  static let magic: [UInt8] = Array("CSXR".utf8)
+  static let version: UInt8 = 2
+
+  enum RecordType: UInt8 {
+    case host = 1
+    case input = 2
+    case targets = 3
+  }
+}
+
+/// Append everything sent to the hosts to a recording file.
+final class SessionRecorder {
+
+  private var fd: Int32
+  private let clock: () -> UInt64
+  private let start: UInt64
+  // Id of each host connection string already declared.
+  private var hosts = [String: UInt32]()
+  // Broadcast targets last recorded.
+  private var targets: [UInt32]? = nil
+  // Encoded records, not written yet.
+  private var pending = [UInt8]()
+
+  private(set) var recordedBytes: UInt64 = 0
+
+  init(path: String, clock: @escaping () -> UInt64 = { DispatchTime.now().uptimeNanoseconds }) throws {
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0o600)
+    guard fd >= 0 else {
+      throw POSIXError.errno
+    }
+    self.clock = clock
+    start = clock()
+
+    pending.append(contentsOf: SessionRecording.magic)
+    pending.append(SessionRecording.version)
+    flush()
+  }
+
+  deinit {
+    close()
+  }
+
+  func close() {
+    guard fd >= 0 else { return }
+    Darwin.close(fd)
+    fd = -1
+  }
+
+  /// Record the hosts (connection strings) receiving the broadcast input from now on.
+  /// Nothing is recorded if they did not change.
+  func record(targets names: [String]) {
+    guard fd >= 0 else { return }
+
+    let ids = names.map(declare)
+    guard ids != targets else { return }
+    targets = ids
+    append(SessionRecording.RecordType.targets.rawValue)
+    append(clock() - start)
+    append(UInt32(ids.count))
+    ids.forEach { append($0) }
+    flush()
+  }
+
+  /// Record input sent to `host` (connection string), or to all hosts if nil.
+  func record(_ bytes: UnsafeRawBufferPointer, host: String?) {
+    guard fd >= 0 else { return }
+
+    let id = host.map(declare) ?? 0
+    append(SessionRecording.RecordType.input.rawValue)
+    append(clock() - start)
+    append(id)
+    append(UInt32(bytes.count))
+    pending.append(contentsOf: bytes)
+    recordedBytes += UInt64(bytes.count)
+    // Written immediately, so the recording is complete even if the controller is killed.
+    flush()
+  }
+
+  // Id of the host, declared on first use.
+  private func declare(_ host: String) -> UInt32 {
+    if let known = hosts[host] {
+      return known
+    }
+    let id = UInt32(hosts.count + 1)
+    hosts[host] = id
+    let name = Array(host.utf8.prefix(Int(UInt16.max)))
+    append(SessionRecording.RecordType.host.rawValue)
+    append(id)
+    append(UInt16(name.count))
+    pending.append(contentsOf: name)
+    return id
+  }
+
+  private func append<T: FixedWidthInteger>(_ value: T) {
+    withUnsafeBytes(of: value.bigEndian) { pending.append(contentsOf: $0) }
+  }
+
+  private func flush() {
+    defer { pending.removeAll(keepingCapacity: true) }
+    let written = pending.withUnsafeBytes { bytes in
+      var offset = 0
+      while offset < bytes.count {
+        let count = Darwin.write(fd, bytes.baseAddress! + offset, bytes.count - offset)
+        if count < 0 {
+          guard errno == EINTR else { return false }
+          continue
+        }
+        offset += count
+      }
+      return true
+    }
+    if !written {
+      logger.error("session recording failed: \(POSIXError.errno, privacy: .public)")
+      close()
+    }
+  }
+}
+
+/// A session recording, loaded in memory.
+struct Recording {
+
+  struct Entry {
+    // ns since the recording start.
+    let time: UInt64
+    // Index of the target host in `hosts`, nil for broadcast.
+    let host: Int?
+    let bytes: [UInt8]
+    // Indices of the hosts receiving a broadcast entry. nil if not recorded (version 1), or for a host entry.
+    var targets: [Int]? = nil
+  }
+
+  // Connection string of each recorded host, in order of appearance.
+  private(set) var hosts = [String]()
+  private(set) var entries = [Entry]()
+
+  var duration: UInt64 { entries.last?.time ?? 0 }
+  var byteCount: Int { entries.reduce(0) { $0 + $1.bytes.count } }
+
+  init(contentsOf path: String) throws {
+    try self.init(data: Data(contentsOf: URL(fileURLWithPath: path)))
+  }
+
+  init(data: Data) throws {
+    var reader = data[...]
+
+    func read<T: FixedWidthInteger>(_ type: T.Type = T.self) throws -> T {
+      guard reader.count >= MemoryLayout<T>.size else { throw POSIXError(.EINVAL) }
+      var value = T.zero
+      withUnsafeMutableBytes(of: &value) { _ = reader.copyBytes(to: $0) }
+      reader = reader.dropFirst(MemoryLayout<T>.size)
+      return T(bigEndian: value)
+    }
+
+    func read(count: Int) throws -> [UInt8] {
+      guard reader.count >= count else { throw POSIXError(.EINVAL) }
+      defer { reader = reader.dropFirst(count) }
+      return Array(reader.prefix(count))
+    }
+
+    guard try read(count: SessionRecording.magic.count) == SessionRecording.magic,
+          (1...SessionRecording.version).contains(try read(UInt8.self)) else {
+      throw POSIXError(.EINVAL)
+    }
+
+    var ids = [UInt32: Int]()
+    var targets: [Int]? = nil
+    while !reader.isEmpty {
+      switch SessionRecording.RecordType(rawValue: try read()) {
+        case .host:
+          let id: UInt32 = try read()
+          let name = try read(count: Int(try read(UInt16.self)))
+          ids[id] = hosts.count
+          hosts.append(String(decoding: name, as: UTF8.self))
+        case .input:
+          let time: UInt64 = try read()
+          let id: UInt32 = try read()
+          let bytes = try read(count: Int(try read(UInt32.self)))
+          guard id == 0 || ids[id] != nil else { throw POSIXError(.EINVAL) }
+          entries.append(Entry(time: time, host: id == 0 ? nil : ids[id], bytes: bytes, targets: id == 0 ? targets : nil))
+        case .targets:
+          _ = try read(UInt64.self)
+          let count: UInt32 = try read()
+          targets = try (0..<count).map { _ in
+            guard let idx = ids[try read(UInt32.self)] else { throw POSIXError(.EINVAL) }
+            return idx
+          }
+        case nil:
+          throw POSIXError(.EINVAL)
+      }
+    }
+  }
+}
@@ -0,0 +1,83 @@
+//
+//  SessionToken.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Random 128 bits token identifying a host session.
+///
+/// The controller passes the token on the csshx-host command line, and the host presents it in its `hello` frame,
+/// so the connection is matched to its session using a single hash lookup.
+struct SessionToken: Hashable, Sendable, CustomStringConvertible {
+  let high: UInt64
+  let low: UInt64
+
+  static let zero = SessionToken(high: 0, low: 0)
+
+  init(high: UInt64, low: UInt64) {
+    self.high = high
+    self.low = low
+  }
+
+  static func random() -> SessionToken {
+    var generator = SystemRandomNumberGenerator()
+    return SessionToken(high: generator.next(), low: generator.next())
+  }
+
+  /// Parse the 32 hex digits representation.
+  init?(_ string: some StringProtocol) {
+    guard string.utf8.count == 32, string.allSatisfy(\.isHexDigit),
+          let high = UInt64(string.prefix(16), radix: 16),
+          let low = UInt64(string.suffix(16), radix: 16) else {
+      return nil
+    }
+    self.init(high: high, low: low)
+  }
+
+  var description: String {
+    func hex(_ value: UInt64) -> String {
+      let digits = String(value, radix: 16)
+      return String(repeating: "0", count: 16 - digits.count) + digits
+    }
+    return hex(high) + hex(low)
+  }
+}
+
+/// Sessions waiting for their host connection, indexed by token.
+struct PendingSessions<Session> {
+
+  private var sessions = [SessionToken: Session]()
+
+  var count: Int { sessions.count }
+  var isEmpty: Bool { sessions.isEmpty }
+
+  /// Register a session, waiting for a connection presenting `token`.
+  mutating func insert(_ session: Session, for token: SessionToken) {
+    precondition(sessions[token] == nil, "duplicated session token")
+    sessions[token] = session
+  }
+
+  @discardableResult
+  mutating func remove(_ token: SessionToken) -> Session? {
+    sessions.removeValue(forKey: token)
+  }
+
+  /// Match a connection using its first frame.
+  ///
+  /// The session is removed on success, so a token can be used only once.
+  mutating func match(_ frame: Frame) throws -> Session {
+    guard case .hello(let version, _, let token) = frame else {
+      throw WireError.unexpectedFrame(frame.type)
+    }
+    guard version == Wire.version else {
+      throw WireError.unsupportedVersion(version)
+    }
+    guard let session = sessions.removeValue(forKey: token) else {
+      throw WireError.unknownSession
+    }
+    return session
+  }
+}
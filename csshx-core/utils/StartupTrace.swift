@@ -0,0 +1,48 @@
+//
+//  StartupTrace.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Startup phases timings (--trace-startup).
+///
+/// Phases are consecutive: each phase starts when the previous one ends (or at the trace origin),
+/// and ends when it is marked. Times are uptime nanoseconds, so the origin may come from the launcher process.
+struct StartupTrace {
+
+  struct Phase {
+    let name: String
+    let duration: UInt64
+    // since origin
+    let end: UInt64
+  }
+
+  let origin: UInt64
+  private var last: UInt64
+  private(set) var phases = [Phase]()
+
+  init(origin: UInt64 = DispatchTime.now().uptimeNanoseconds) {
+    self.origin = origin
+    last = origin
+  }
+
+  /// End the phase `name` now. A phase is recorded only once.
+  mutating func mark(_ name: String) {
+    guard !phases.contains(where: { $0.name == name }) else { return }
+    let now = max(last, DispatchTime.now().uptimeNanoseconds)
+    phases.append(Phase(name: name, duration: now - last, end: now - origin))
+    last = now
+  }
+
+  /// One line per phase, with its duration and the time since origin.
+  var lines: [String] {
+    let width = phases.map(\.name.count).max() ?? 0
+    return phases.map { phase in
+      let name = phase.name.padding(toLength: width, withPad: " ", startingAt: 0)
+      return name + String(format: "  %8.1fms  (%.1fms)", Double(phase.duration) / 1e6, Double(phase.end) / 1e6)
+    }
+  }
+}
@@ -12,7 +12,18 @@ let TerminalBundleId = "com.apple.Terminal"
 
 struct Terminal {
   
-  static let shell: String = getShell()
+  /// Shell run by Terminal. Terminal preferences are read on first access, unless it was set before
+  /// (the launcher passes it to the controller, so the preferences are read once per session).
+  static var shell: String {
+    get {
+      if let _shell { return _shell }
+      let shell = getShell()
+      _shell = shell
+      return shell
+    }
+    set { _shell = newValue }
+  }
+  nonisolated(unsafe) private static var _shell: String? = nil
 
   private static func getShell() -> String {
     var userShell: String? = nil
@@ -0,0 +1,82 @@
+//
+//  TimerWheel.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+/// Hashed timer wheel, used to manage many deadlines with a single timer source.
+///
+/// Deadlines are stored in slots of `tick` nanoseconds. Scheduling and cancelling are O(1), and advancing the wheel
+/// only visits the slots elapsed since the last advance. Deadlines further than a wheel revolution stay in their
+/// slot until their round comes.
+///
+/// The wheel is passive: the owner advances it (usually from a repeating timer) and processes the expired keys.
+struct TimerWheel<Key: Hashable> {
+
+  let tick: UInt64
+
+  private var slots: [[(key: Key, deadline: UInt64)]]
+  // Active deadline of each key. Slot entries not matching it are stale (cancelled or rescheduled).
+  private var deadlines = [Key: UInt64]()
+  // Next tick to process. The slot of the current tick is processed again by the next advance,
+  // as it may hold deadlines later than the last advance.
+  private var current: UInt64
+
+  var count: Int { deadlines.count }
+  var isEmpty: Bool { deadlines.isEmpty }
+
+  /// - Parameters:
+  ///   - tick: slot duration in nanoseconds.
+  ///   - slots: number of slots. Deadlines up to `tick * slots` are processed in a single round.
+  ///   - now: wheel origin.
+  init(tick: UInt64, slots: Int = 256, now: UInt64) {
+    precondition(tick > 0 && slots > 0)
+    self.tick = tick
+    self.slots = Array(repeating: [], count: slots)
+    current = now / tick
+  }
+
+  /// Schedule (or reschedule) a deadline for key.
+  mutating func schedule(_ key: Key, at deadline: UInt64) {
+    deadlines[key] = deadline
+    // Past deadlines expire on next advance.
+    let slot = max(deadline / tick, current)
+    slots[Int(slot % UInt64(slots.count))].append((key, deadline))
+  }
+
+  mutating func cancel(_ key: Key) {
+    // Slot entry is purged lazily.
+    deadlines[key] = nil
+  }
+
+  func deadline(for key: Key) -> UInt64? {
+    deadlines[key]
+  }
+
+  /// Advance the wheel to `now`.
+  /// - Returns: the keys whose deadline is reached, in slot order.
+  mutating func advance(to now: UInt64) -> [Key] {
+    var expired = [Key]()
+    let target = now / tick
+    guard target >= current else { return expired }
+
+    // A full revolution visits all slots.
+    let end = min(target, current + UInt64(slots.count) - 1)
+    for position in current...end {
+      let idx = Int(position % UInt64(slots.count))
+      guard !slots[idx].isEmpty else { continue }
+      slots[idx].removeAll { entry in
+        guard deadlines[entry.key] == entry.deadline else { return true }
+        guard entry.deadline <= now else { return false }
+        deadlines[entry.key] = nil
+        expired.append(entry.key)
+        return true
+      }
+    }
+    current = target
+    return expired
+  }
+}
@@ -0,0 +1,339 @@
+//
+//  WireProtocol.swift
+//  csshx
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import Foundation
+
+// Controller <-> csshx-host wire protocol.
+//
+// The socket carries a stream of frames. Each frame is a 5 bytes header followed by its payload:
+//   - type: UInt8
+//   - length: UInt32 (big endian), length of the payload only.
+// All integers in payloads are big endian.
+//
+// On connection, the host sends a 'hello' frame, with the session token it received on its command line.
+// The controller replies with its own 'hello' once the connection is matched with a host session.
+// The host must not inject anything before that.
+//
+// A relay (csshx relay) connects to the controller as a host does, and serves its own hosts with the same protocol.
+// It answers pings itself, and reports its downstream statistics with a 'relayStats' frame after each pong.
+// Its hosts lag on their own: the controller sends 'resume' when the user enables the relay host again.
+//
+// Hosts started with output capture send the ssh output to the controller in 'output' frames.
+enum Wire {
+  static let version: UInt8 = 5
+
+  static let headerSize = 5
+  // Upper bound of a frame payload. Anything larger is considered as a protocol error.
+  static let maxPayloadSize = 1024 * 1024
+
+  enum FrameType: UInt8, CaseIterable {
+    case hello = 1
+    case input = 2
+    case resize = 3
+    case ping = 4
+    case pong = 5
+    case status = 6
+    case credit = 7
+    case relayStats = 8
+    case output = 9
+    case resume = 10
+  }
+}
+
+enum WireError: Error {
+  case invalidFrameType(UInt8)
+  case invalidLength(Int)
+  case invalidPayload(Wire.FrameType)
+  case unsupportedVersion(UInt8)
+  // handshake: the first frame must be a 'hello' with a known session token.
+  case unexpectedFrame(Wire.FrameType)
+  case unknownSession
+}
+
+/// Downstream statistics of a relay, since it started.
+struct RelayStats: Equatable, Encodable {
+  // connected hosts.
+  var hosts: UInt32 = 0
+  // input bytes received from the controller.
+  var received: UInt64 = 0
+  // input bytes queued for the hosts, not acknowledged yet.
+  var queued: UInt64 = 0
+  // input bytes acknowledged by the hosts, and dropped for lagging hosts.
+  var forwarded: UInt64 = 0
+  var dropped: UInt64 = 0
+  // hosts injection latency (ns).
+  var latencyP50: UInt64 = 0
+  var latencyP99: UInt64 = 0
+}
+
+/// A decoded frame.
+///
+/// Variable length payloads are views in the decoder buffer and are only valid during the decoder callback.
+enum Frame {
+  // version, pid of the sender, and session token.
+  case hello(version: UInt8, pid: Int32, token: SessionToken)
+  // raw input to inject.
+  case input(UnsafeRawBufferPointer)
+  // host -> controller: size of the host window. controller -> host: requested pty size.
+  case resize(rows: UInt16, columns: UInt16)
+  // controller -> host: probe, echoed back by the host using 'pong'.
+  case ping(id: UInt32, timestamp: UInt64)
+  // host -> controller: ping id and timestamp, and host timestamp when the ping was processed.
+  case pong(id: UInt32, timestamp: UInt64, received: UInt64)
+  // host -> controller: ssh process status. exitCode is nil while ssh is running.
+  case status(pid: Int32, exitCode: Int32?)
+  // host -> controller: count of input bytes processed since the last credit frame.
+  case credit(UInt32)
+  // relay -> controller: downstream statistics.
+  case relayStats(RelayStats)
+  // host -> controller: captured ssh output.
+  case output(UnsafeRawBufferPointer)
+  // controller -> relay: the relay host was enabled again, resume its lagging hosts.
+  case resume
+
+  var type: Wire.FrameType {
+    switch self {
+      case .hello: .hello
+      case .input: .input
+      case .resize: .resize
+      case .ping: .ping
+      case .pong: .pong
+      case .status: .status
+      case .credit: .credit
+      case .relayStats: .relayStats
+      case .output: .output
+      case .resume: .resume
+    }
+  }
+
+  var payloadSize: Int {
+    switch self {
+      case .hello: 21
+      case .input(let bytes): bytes.count
+      case .resize: 4
+      case .ping: 12
+      case .pong: 20
+      case .status: 9
+      case .credit: 4
+      case .relayStats: 52
+      case .output(let bytes): bytes.count
+      case .resume: 0
+    }
+  }
+
+  var encodedSize: Int { Wire.headerSize + payloadSize }
+}
+
+// MARK: - Encoding
+extension Frame {
+
+  /// Encode the frame in a caller provided buffer, that must be at least `encodedSize` bytes long.
+  /// - Returns: the number of bytes written.
+  @discardableResult
+  func encode(into buffer: UnsafeMutableRawBufferPointer) -> Int {
+    precondition(buffer.count >= encodedSize)
+    var writer = ByteWriter(buffer: buffer)
+    writer.write(type.rawValue)
+    writer.write(UInt32(payloadSize))
+
+    switch self {
+      case .hello(let version, let pid, let token):
+        writer.write(version)
+        writer.write(UInt32(bitPattern: pid))
+        writer.write(token.high)
+        writer.write(token.low)
+      case .input(let bytes), .output(let bytes):
+        writer.write(bytes: bytes)
+      case .resize(let rows, let columns):
+        writer.write(rows)
+        writer.write(columns)
+      case .ping(let id, let timestamp):
+        writer.write(id)
+        writer.write(timestamp)
+      case .pong(let id, let timestamp, let received):
+        writer.write(id)
+        writer.write(timestamp)
+        writer.write(received)
+      case .status(let pid, let exitCode):
+        writer.write(UInt32(bitPattern: pid))
+        writer.write(UInt8(exitCode == nil ? 0 : 1))
+        writer.write(UInt32(bitPattern: exitCode ?? 0))
+      case .credit(let count):
+        writer.write(count)
+      case .relayStats(let stats):
+        writer.write(stats.hosts)
+        writer.write(stats.received)
+        writer.write(stats.queued)
+        writer.write(stats.forwarded)
+        writer.write(stats.dropped)
+        writer.write(stats.latencyP50)
+        writer.write(stats.latencyP99)
+      case .resume:
+        break
+    }
+    return writer.offset
+  }
+
+  /// Encoded frame, ready to be sent on a DispatchIO channel.
+  /// The result is an immutable ref-counted buffer, that can be shared by many connections.
+  func data() -> DispatchData {
+    withUnsafeTemporaryAllocation(byteCount: encodedSize, alignment: 1) { buffer in
+      let count = encode(into: buffer)
+      return DispatchData(bytes: UnsafeRawBufferPointer(rebasing: buffer[0..<count]))
+    }
+  }
+}
+
+private struct ByteWriter {
+  let buffer: UnsafeMutableRawBufferPointer
+  var offset: Int = 0
+
+  mutating func write<T: FixedWidthInteger>(_ value: T) {
+    buffer.storeBytes(of: value.bigEndian, toByteOffset: offset, as: T.self)
+    offset += MemoryLayout<T>.size
+  }
+
+  mutating func write(bytes: UnsafeRawBufferPointer) {
+    guard !bytes.isEmpty else { return }
+    UnsafeMutableRawBufferPointer(rebasing: buffer[offset...]).copyMemory(from: bytes)
+    offset += bytes.count
+  }
+}
+
+private struct ByteReader {
+  let buffer: UnsafeRawBufferPointer
+  var offset: Int = 0
+
+  mutating func read<T: FixedWidthInteger>(_ type: T.Type = T.self) -> T {
+    let value = buffer.loadUnaligned(fromByteOffset: offset, as: T.self)
+    offset += MemoryLayout<T>.size
+    return T(bigEndian: value)
+  }
+}
+
+// MARK: - Decoding
+/// Incremental frame decoder.
+///
+/// Frames fully contained in the received data are decoded in place. Only a frame split across two reads
+/// is copied into an internal buffer, whose storage is reused for the connection lifetime.
+struct FrameDecoder {
+
+  private var pending: [UInt8] = []
+
+  init() {
+    pending.reserveCapacity(Wire.headerSize + 4096)
+  }
+
+  mutating func decode(_ data: DispatchData, _ handler: (Frame) throws -> Void) throws {
+    for region in data.regions {
+      try region.withUnsafeBytes { (ptr: UnsafePointer<UInt8>) in
+        try decode(UnsafeRawBufferPointer(start: ptr, count: region.count), handler)
+      }
+    }
+  }
+
+  mutating func decode(_ bytes: UnsafeRawBufferPointer, _ handler: (Frame) throws -> Void) throws {
+    var input = bytes[...]
+
+    // First, complete the pending frame if any.
+    if !pending.isEmpty {
+      if pending.count < Wire.headerSize {
+        let count = min(Wire.headerSize - pending.count, input.count)
+        pending.append(contentsOf: input.prefix(count))
+        input = input.dropFirst(count)
+        guard pending.count == Wire.headerSize else { return }
+      }
+
+      let length = try pending.withUnsafeBytes { try Self.payloadLength($0) }
+      let missing = Wire.headerSize + length - pending.count
+      let count = min(missing, input.count)
+      pending.append(contentsOf: input.prefix(count))
+      input = input.dropFirst(count)
+      guard count == missing else { return }
+
+      try pending.withUnsafeBytes { frame in
+        try handler(try Self.frame(UnsafeRawBufferPointer(rebasing: frame[Wire.headerSize...]), type: frame[0]))
+      }
+      pending.removeAll(keepingCapacity: true)
+    }
+
+    // Then, decode all complete frames in place.
+    while input.count >= Wire.headerSize {
+      let header = UnsafeRawBufferPointer(rebasing: input.prefix(Wire.headerSize))
+      let length = try Self.payloadLength(header)
+      guard input.count >= Wire.headerSize + length else { break }
+
+      let payload = input.dropFirst(Wire.headerSize).prefix(length)
+      try handler(try Self.frame(UnsafeRawBufferPointer(rebasing: payload), type: header[0]))
+      input = input.dropFirst(Wire.headerSize + length)
+    }
+
+    // And keep the remaining partial frame.
+    pending.append(contentsOf: input)
+  }
+
+  private static func payloadLength(_ header: UnsafeRawBufferPointer) throws -> Int {
+    var reader = ByteReader(buffer: header, offset: 1)
+    let length = Int(reader.read(UInt32.self))
+    guard length <= Wire.maxPayloadSize else {
+      throw WireError.invalidLength(length)
+    }
+    return length
+  }
+
+  private static func frame(_ payload: UnsafeRawBufferPointer, type value: UInt8) throws -> Frame {
+    guard let type = Wire.FrameType(rawValue: value) else {
+      throw WireError.invalidFrameType(value)
+    }
+
+    // Check fixed size payloads before reading them.
+    let expected: Int? = switch type {
+      case .hello: 21
+      case .input, .output: nil
+      case .resize: 4
+      case .ping: 12
+      case .pong: 20
+      case .status: 9
+      case .credit: 4
+      case .relayStats: 52
+      case .resume: 0
+    }
+    if let expected, payload.count != expected {
+      throw WireError.invalidPayload(type)
+    }
+
+    var reader = ByteReader(buffer: payload)
+    switch type {
+      case .hello:
+        return .hello(version: reader.read(), pid: Int32(bitPattern: reader.read()),
+                      token: SessionToken(high: reader.read(), low: reader.read()))
+      case .input:
+        return .input(payload)
+      case .resize:
+        return .resize(rows: reader.read(), columns: reader.read())
+      case .ping:
+        return .ping(id: reader.read(), timestamp: reader.read())
+      case .pong:
+        return .pong(id: reader.read(), timestamp: reader.read(), received: reader.read())
+      case .status:
+        let pid = Int32(bitPattern: reader.read())
+        let exited: UInt8 = reader.read()
+        let code = Int32(bitPattern: reader.read())
+        return .status(pid: pid, exitCode: exited != 0 ? code : nil)
+      case .credit:
+        return .credit(reader.read())
+      case .relayStats:
+        return .relayStats(RelayStats(hosts: reader.read(), received: reader.read(), queued: reader.read(),
+                                      forwarded: reader.read(), dropped: reader.read(),
+                                      latencyP50: reader.read(), latencyP99: reader.read()))
+      case .output:
+        return .output(payload)
+      case .resume:
+        return .resume
+    }
+  }
+}
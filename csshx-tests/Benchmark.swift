@@ -0,0 +1,119 @@
+//
+//  Benchmark.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+/// Base class of the benchmarks (see csshx-benchmarks.xctestplan).
+///
+/// A benchmark runs its body a fixed number of times, and keeps the median duration.
+/// Results are compared with a baseline file, and the benchmark fails if it is slower than its baseline by more than
+/// the tolerance. Benchmarks without baseline only report their result.
+///
+/// Environment:
+///   - CSSHX_BENCHMARK_BASELINE: baseline file (JSON).
+///   - CSSHX_BENCHMARK_SAVE: if set to 1, write the results to the baseline file instead of comparing them.
+///   - CSSHX_BENCHMARK_TOLERANCE: allowed slowdown, as a fraction of the baseline (default 0.25).
+///
+/// Benchmarks only use the headless parts of csshx (no AppKit, no Terminal), so they can run on CI.
+class Benchmark: XCTestCase {
+
+  struct Result: Codable {
+    // Durations in ns.
+    let median: UInt64
+    let min: UInt64
+    let iterations: Int
+  }
+
+  /// Measure body.
+  /// - Parameters:
+  ///   - name: result name in the baseline file, prefixed by the test class name.
+  ///   - iterations: count of measured runs.
+  ///   - warmup: count of runs before measuring.
+  func benchmark(_ name: String, iterations: Int = 10, warmup: Int = 1, _ body: () throws -> Void) rethrows {
+    for _ in 0..<warmup {
+      try body()
+    }
+
+    var durations = [UInt64]()
+    durations.reserveCapacity(iterations)
+    for _ in 0..<iterations {
+      let start = DispatchTime.now().uptimeNanoseconds
+      try body()
+      durations.append(DispatchTime.now().uptimeNanoseconds - start)
+    }
+    durations.sort()
+
+    let result = Result(median: durations[durations.count / 2], min: durations[0], iterations: iterations)
+    report("\(Self.self).\(name)", result)
+  }
+
+  private func report(_ name: String, _ result: Result) {
+    let store = Baseline.shared
+    let summary = "\(name): " + String(format: "median %.3f ms, min %.3f ms", Double(result.median) / 1e6, Double(result.min) / 1e6)
+
+    if store.save {
+      store.update(name, result)
+      print("[benchmark] \(summary) (saved)")
+      return
+    }
+
+    guard let baseline = store.results[name] else {
+      print("[benchmark] \(summary) (no baseline)")
+      return
+    }
+
+    let ratio = Double(result.median) / Double(max(1, baseline.median))
+    print("[benchmark] \(summary), baseline \(String(format: "%.3f ms (%+.1f%%)", Double(baseline.median) / 1e6, (ratio - 1) * 100))")
+    if ratio > 1 + store.tolerance {
+      XCTFail("\(name) regressed: \(result.median) ns, baseline \(baseline.median) ns")
+    }
+  }
+}
+
+// Results shared by all benchmark classes of the run.
+private final class Baseline: @unchecked Sendable {
+
+  static let shared = Baseline()
+
+  let path: String?
+  let save: Bool
+  let tolerance: Double
+  private(set) var results = [String: Benchmark.Result]()
+
+  private init() {
+    let env = ProcessInfo.processInfo.environment
+    path = env["CSSHX_BENCHMARK_BASELINE"].flatMap { $0.isEmpty ? nil : $0 }
+    save = env["CSSHX_BENCHMARK_SAVE"] == "1"
+    tolerance = env["CSSHX_BENCHMARK_TOLERANCE"].flatMap(Double.init) ?? 0.25
+
+    if let path, let data = FileManager.default.contents(atPath: path) {
+      do {
+        results = try JSONDecoder().decode([String: Benchmark.Result].self, from: data)
+      } catch {
+        print("[benchmark] invalid baseline file \(path): \(error)")
+      }
+    }
+  }
+
+  // Results are written after each benchmark, so running a subset of the benchmarks only updates their results.
+  func update(_ name: String, _ result: Benchmark.Result) {
+    results[name] = result
+    guard let path else { return }
+
+    let encoder = JSONEncoder()
+    encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+    do {
+      let url = URL(fileURLWithPath: path)
+      try FileManager.default.createDirectory(at: url.deletingLastPathComponent(), withIntermediateDirectories: true)
+      try encoder.encode(results).write(to: url, options: .atomic)
+    } catch {
+      print("[benchmark] failed to save baseline \(path): \(error)")
+    }
+  }
+}
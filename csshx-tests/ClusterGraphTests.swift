@@ -0,0 +1,106 @@
+//
+//  ClusterGraphTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+import System
+
+// @testable import CsshxCore
+
+final class ClusterGraphTests: XCTestCase {
+
+  private var directory: URL!
+
+  override func setUpWithError() throws {
+    directory = FileManager.default.temporaryDirectory.appendingPathComponent("csshx-tests-\(UUID())")
+    try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+  }
+
+  override func tearDownWithError() throws {
+    try? FileManager.default.removeItem(at: directory)
+  }
+
+  func testFlattenSharedClusters() throws {
+    var graph = ClusterGraph()
+    graph.add(["db", "web+2"], to: "all")
+    graph.add(["web", "db-[1-2]"], to: "backend")
+    graph.add(["db-[1-2]"], to: "db")
+    graph.add(["root@web-[1-2]:22", "lb"], to: "web")
+    try graph.compile()
+
+    let members = try XCTUnwrap(graph.members)
+    XCTAssertEqual([
+      ClusterGraph.Member(spec: "db-[1-2]", multiplier: 1),
+      ClusterGraph.Member(spec: "root@web-[1-2]:22", multiplier: 2),
+      ClusterGraph.Member(spec: "lb", multiplier: 2),
+    ], members["all"])
+    XCTAssertEqual(members["web"], [
+      ClusterGraph.Member(spec: "root@web-[1-2]:22", multiplier: 1),
+      ClusterGraph.Member(spec: "lb", multiplier: 1),
+    ])
+  }
+
+  func testPatternReferences() throws {
+    var graph = ClusterGraph()
+    graph.add(["user@rack-[a-c]:2222"], to: "all")
+    graph.add(["node-[1-2]"], to: "rack-b")
+    try graph.compile()
+
+    // only the generated hostname matching a cluster is replaced.
+    XCTAssertEqual([
+      ClusterGraph.Member(spec: "user@rack-a:2222", multiplier: 1),
+      ClusterGraph.Member(spec: "node-[1-2]", multiplier: 1),
+      ClusterGraph.Member(spec: "user@rack-c:2222", multiplier: 1),
+    ], graph.members?["all"])
+  }
+
+  func testCycle() throws {
+    var graph = ClusterGraph()
+    graph.add(["b", "host1"], to: "a")
+    graph.add(["c-[1-2]"], to: "b")
+    graph.add(["a"], to: "c-2")
+    XCTAssertThrowsError(try graph.compile()) { error in
+      XCTAssertEqual(POSIXError(.ELOOP), error as? POSIXError)
+    }
+
+    var hosts = HostList()
+    hosts.add(["self+2"], to: "self")
+    try hosts.add("self", command: nil)
+    XCTAssertThrowsError(try hosts.getHosts())
+  }
+
+  func testCache() throws {
+    let clusters = directory.appendingPathComponent("clusters")
+    let cache = directory.appendingPathComponent("cache.plist")
+    try "web web-1 web-2\n".write(to: clusters, atomically: false, encoding: .utf8)
+    let date = Date(timeIntervalSinceNow: -60)
+    try FileManager.default.setAttributes([.modificationDate: date], ofItemAtPath: clusters.path)
+
+    var hosts = HostList()
+    hosts.load(clustersFile: FilePath(clusters.path))
+    try hosts.add("web", command: nil)
+    try hosts.compileClusters(cache: cache)
+    XCTAssertEqual(["web-1", "web-2"], try hosts.getHosts().map(\.hostname))
+    XCTAssertTrue(FileManager.default.fileExists(atPath: cache.path))
+
+    // Same path, size and date -> the file is not parsed again.
+    try "web web-3 web-4\n".write(to: clusters, atomically: false, encoding: .utf8)
+    try FileManager.default.setAttributes([.modificationDate: date], ofItemAtPath: clusters.path)
+    hosts = HostList()
+    hosts.load(clustersFile: FilePath(clusters.path))
+    try hosts.add("web", command: nil)
+    try hosts.compileClusters(cache: cache)
+    XCTAssertEqual(["web-1", "web-2"], try hosts.getHosts().map(\.hostname))
+
+    // Modified file -> cache invalidated.
+    try FileManager.default.setAttributes([.modificationDate: Date()], ofItemAtPath: clusters.path)
+    hosts = HostList()
+    hosts.load(clustersFile: FilePath(clusters.path))
+    try hosts.add("web", command: nil)
+    try hosts.compileClusters(cache: cache)
+    XCTAssertEqual(["web-3", "web-4"], try hosts.getHosts().map(\.hostname))
+  }
+}
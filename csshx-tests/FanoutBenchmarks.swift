@@ -0,0 +1,118 @@
+//
+//  FanoutBenchmarks.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+/// Controller → hosts broadcast, through the actual host connections, over socket pairs.
+///
+/// The host end of each socket pair is a dummy host, that acknowledges input as soon as it is decoded,
+/// so a round is complete once every connection has no input in flight.
+final class FanoutBenchmarks: Benchmark {
+
+  private final class DummyHost {
+    private let io: DispatchIO
+    private var decoder = FrameDecoder()
+
+    init(socket: Int32, queue: DispatchQueue) {
+      io = DispatchIO(type: .stream, fileDescriptor: socket, queue: queue, cleanupHandler: { _ in Darwin.close(socket) })
+      io.setLimit(lowWater: 1)
+      io.read(offset: 0, length: .max, queue: queue) { [self] _, data, _ in
+        guard let data, !data.isEmpty else { return }
+        var received = 0
+        try? decoder.decode(data) { frame in
+          if case .input(let bytes) = frame {
+            received += bytes.count
+          }
+        }
+        if received > 0 {
+          io.write(offset: 0, data: Frame.credit(UInt32(received)).data(), queue: queue) { _, _, _ in }
+        }
+      }
+    }
+
+    func close() {
+      io.close(flags: .stop)
+    }
+  }
+
+  private var connections = [HostConnection]()
+  private var hosts = [DummyHost]()
+  private var remaining = 0
+  private var done: XCTestExpectation? = nil
+
+  override class func setUp() {
+    super.setUp()
+    signal(SIGPIPE, SIG_IGN)
+    // 2 descriptors per host.
+    var limit = rlimit()
+    if getrlimit(RLIMIT_NOFILE, &limit) == 0, limit.rlim_cur < 4096 {
+      limit.rlim_cur = min(limit.rlim_max, 4096)
+      setrlimit(RLIMIT_NOFILE, &limit)
+    }
+  }
+
+  override func tearDown() {
+    connections.forEach { $0.close() }
+    hosts.forEach { $0.close() }
+    connections = []
+    hosts = []
+  }
+
+  private func connect(hosts count: Int) throws {
+    let queue = DispatchQueue(label: "csshx.benchmark.hosts")
+    for _ in 0..<count {
+      var fds: [Int32] = [-1, -1]
+      guard socketpair(AF_UNIX, SOCK_STREAM, 0, &fds) == 0 else {
+        throw POSIXError.errno
+      }
+      let connection = HostConnection(socket: fds[0], limits: HostConnection.Limits(maxBytes: 16 * 1024 * 1024))
+      connection.receive({ [unowned self, unowned connection] frame in
+        guard case .credit = frame, connection.queueDepth == 0 else { return }
+        remaining -= 1
+        if remaining == 0 {
+          done?.fulfill()
+        }
+      }, whenDone: { _ in })
+      connections.append(connection)
+      hosts.append(DummyHost(socket: fds[1], queue: queue))
+    }
+  }
+
+  // Broadcast 64 chunks of 256 bytes (a fast typist, or a small paste), and wait for all hosts to acknowledge them.
+  private func fanout(hosts count: Int, iterations: Int) throws {
+    try connect(hosts: count)
+
+    let chunk = [UInt8](repeating: UInt8(ascii: "x"), count: 256)
+    benchmark("hosts_\(count)", iterations: iterations) {
+      let acknowledged = expectation(description: "acknowledged")
+      done = acknowledged
+      remaining = connections.count
+      for _ in 0..<64 {
+        // Frames are encoded once, and shared by all connections, as done by the controller.
+        let data = chunk.withUnsafeBytes { Frame.input($0).data() }
+        for connection in connections {
+          XCTAssertTrue(connection.send(input: data, payload: chunk.count))
+        }
+      }
+      wait(for: [acknowledged], timeout: 30)
+    }
+  }
+
+  func testFanout10() throws {
+    try fanout(hosts: 10, iterations: 20)
+  }
+
+  func testFanout100() throws {
+    try fanout(hosts: 100, iterations: 10)
+  }
+
+  func testFanout1000() throws {
+    try fanout(hosts: 1000, iterations: 5)
+  }
+}
@@ -0,0 +1,172 @@
+//
+//  FilePushTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class FilePushTests: XCTestCase {
+
+  // Host end of a connection: records the injected input, and acknowledges it.
+  private final class Host {
+    private let io: DispatchIO
+    private let queue: DispatchQueue
+    private var decoder = FrameDecoder()
+    // Input received, only accessed on `queue`.
+    private(set) var received = [UInt8]()
+    // Acknowledge input only while true.
+    var acknowledging = true
+    private var unacknowledged = 0
+
+    init(socket: Int32, queue: DispatchQueue = .main) {
+      self.queue = queue
+      io = DispatchIO(type: .stream, fileDescriptor: socket, queue: queue, cleanupHandler: { _ in Darwin.close(socket) })
+      io.setLimit(lowWater: 1)
+      io.read(offset: 0, length: .max, queue: queue) { [self] _, data, _ in
+        guard let data, !data.isEmpty else { return }
+        try? decoder.decode(data) { frame in
+          if case .input(let bytes) = frame {
+            received.append(contentsOf: bytes)
+            unacknowledged += bytes.count
+          }
+        }
+        acknowledge()
+      }
+    }
+
+    func acknowledge() {
+      guard acknowledging, unacknowledged > 0 else { return }
+      io.write(offset: 0, data: Frame.credit(UInt32(unacknowledged)).data(), queue: queue) { _, _, _ in }
+      unacknowledged = 0
+    }
+
+    func close() {
+      io.close(flags: .stop)
+    }
+  }
+
+  private var connections = [HostConnection]()
+  private var hosts = [Host]()
+
+  override func tearDown() {
+    connections.forEach { $0.close() }
+    hosts.forEach { $0.close() }
+  }
+
+  // Connect hosts, and resume the push on each acknowledgment, as the controller does.
+  private func connect(_ count: Int, push: @escaping () -> FilePush?) throws {
+    for _ in 0..<count {
+      var fds: [Int32] = [-1, -1]
+      guard socketpair(AF_UNIX, SOCK_STREAM, 0, &fds) == 0 else {
+        throw POSIXError.errno
+      }
+      let connection = HostConnection(socket: fds[0], limits: HostConnection.Limits(maxBytes: 1024))
+      connection.receive({ [unowned connection] frame in
+        if case .credit = frame {
+          push()?.resume(connection)
+        }
+      }, whenDone: { _ in })
+      connections.append(connection)
+      hosts.append(Host(socket: fds[1]))
+    }
+  }
+
+  func testPushToAllHosts() throws {
+    // Larger than the broadcast limits: push frames are paced by the window, and never dropped.
+    let content = (0..<100_000).map { UInt8(truncatingIfNeeded: $0 &* 31) }
+    let push = FilePush(content, name: "data", options: FilePush.Options(chunkSize: 4096, window: 16 * 1024))
+    try connect(8) { push }
+
+    let done = expectation(description: "push done")
+    push.completion = { _ in done.fulfill() }
+    push.start(connections)
+    // The first window is sent right away.
+    XCTAssertEqual(connections[0].queuedBytes, 16 * 1024)
+    wait(for: [done], timeout: 10)
+
+    XCTAssertEqual(push.completed, 8)
+    XCTAssertEqual(push.progress, 1)
+    for host in hosts {
+      XCTAssertEqual(host.received, content)
+    }
+    XCTAssertTrue(connections.allSatisfy { $0.bytesDropped == 0 && $0.queuedBytes == 0 })
+  }
+
+  func testConnectionQueue() throws {
+    var fds: [Int32] = [-1, -1]
+    guard socketpair(AF_UNIX, SOCK_STREAM, 0, &fds) == 0 else {
+      throw POSIXError.errno
+    }
+    // Connection and host served on their own queues, as the controller does.
+    let connection = HostConnection(socket: fds[0], limits: HostConnection.Limits(), queue: DispatchQueue(label: "io"))
+    let credited = expectation(description: "credit delivered")
+    credited.assertForOverFulfill = false
+    connection.receive({ frame in
+      // Frames are delivered on the main queue, whatever the connection queue.
+      XCTAssertTrue(Thread.isMainThread)
+      if case .credit = frame {
+        credited.fulfill()
+      }
+    }, whenDone: { _ in })
+    connections.append(connection)
+    hosts.append(Host(socket: fds[1], queue: DispatchQueue(label: "host")))
+
+    let content = [UInt8](repeating: 0x41, count: 4096)
+    let (data, payload) = content.withUnsafeBytes { (Frame.input($0).data(), $0.count) }
+    XCTAssertTrue(connection.send(input: data, payload: payload))
+
+    // Block the main queue: credits are still accounted by the connection queue.
+    let deadline = Date() + 10
+    while connection.queuedBytes > 0, Date() < deadline {
+      usleep(1000)
+    }
+    XCTAssertEqual(connection.queuedBytes, 0)
+    XCTAssertEqual(connection.bytesForwarded, 4096)
+
+    // And delivered once the main queue runs.
+    wait(for: [credited], timeout: 10)
+  }
+
+  func testStalledHost() throws {
+    let content = [UInt8](repeating: 0x41, count: 64 * 1024)
+    let push = FilePush(content, name: "data", options: FilePush.Options(chunkSize: 1024, window: 4096))
+    try connect(2) { push }
+    hosts[1].acknowledging = false
+
+    let progress = expectation(description: "first host done")
+    push.completion = { _ in XCTFail("push should not complete") }
+    push.start(connections)
+    DispatchQueue.main.asyncAfterUnsafe(deadline: .now() + .milliseconds(500)) { progress.fulfill() }
+    wait(for: [progress], timeout: 10)
+
+    // The stalled host does not hold the others back, and has at most a window in flight.
+    XCTAssertEqual(push.completed, 1)
+    XCTAssertEqual(hosts[0].received.count, content.count)
+    XCTAssertLessThanOrEqual(connections[1].queuedBytes, 4096)
+    XCTAssertEqual(hosts[1].received.count, 4096)
+
+    // Losing the host completes the push.
+    let done = expectation(description: "push done")
+    push.completion = { _ in done.fulfill() }
+    push.remove(connections[1])
+    wait(for: [done], timeout: 1)
+    XCTAssertEqual(push.failed, 1)
+  }
+
+  func testHeredoc() {
+    let command = Array("hello\u{3}\n".utf8).withUnsafeBytes { FilePush.heredoc($0, path: "/tmp/it's here") }
+    XCTAssertEqual(String(decoding: command, as: UTF8.self), """
+      base64 -d > '/tmp/it'"'"'s here' <<'CSSHX_EOF'
+      aGVsbG8DCg==
+      CSSHX_EOF
+
+      """)
+
+    let empty = [UInt8]().withUnsafeBytes { FilePush.heredoc($0, path: "empty") }
+    XCTAssertEqual(String(decoding: empty, as: UTF8.self), "base64 -d > empty <<'CSSHX_EOF'\nCSSHX_EOF\n")
+  }
+}
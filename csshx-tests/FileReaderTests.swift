@@ -0,0 +1,161 @@
+//
+//  FileReaderTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+import System
+
+// @testable import CsshxCore
+
+final class FileReaderTests: XCTestCase {
+
+  private var directory: URL!
+
+  override func setUpWithError() throws {
+    directory = FileManager.default.temporaryDirectory.appendingPathComponent("csshx-tests-\(UUID())")
+    try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+  }
+
+  override func tearDownWithError() throws {
+    try? FileManager.default.removeItem(at: directory)
+  }
+
+  private func file(_ content: String) throws -> FilePath {
+    let url = directory.appendingPathComponent(UUID().uuidString)
+    try content.write(to: url, atomically: false, encoding: .utf8)
+    return FilePath(url.path)
+  }
+
+  // Read the content through a pipe, to test the chunked reader.
+  private func pipe(_ content: String) -> (FilePath, FileHandle) {
+    let pipe = Pipe()
+    let data = Data(content.utf8)
+    let writer = pipe.fileHandleForWriting
+    Thread.detachNewThread {
+      writer.write(data)
+      try? writer.close()
+    }
+    return (FilePath("/dev/fd/\(pipe.fileHandleForReading.fileDescriptor)"), pipe.fileHandleForReading)
+  }
+
+  private func lines(_ path: FilePath) throws -> [String] {
+    var lines = [String]()
+    try path.readLines { lines.append(String(decoding: $0, as: UTF8.self)) }
+    return lines
+  }
+
+  func testReadLines() throws {
+    let content = "first\r\n\nsecond line\nlast"
+    let expected = ["first", "", "second line", "last"]
+    XCTAssertEqual(expected, try lines(file(content)))
+
+    let (path, handle) = pipe(content)
+    defer { try? handle.close() }
+    XCTAssertEqual(expected, try lines(path))
+  }
+
+  func testEmptyAndMissingFiles() throws {
+    XCTAssertEqual([], try lines(file("")))
+    XCTAssertEqual([], try lines(FilePath(directory.appendingPathComponent("missing").path)))
+  }
+
+  func testLongLinesThroughPipe() throws {
+    // Lines larger than the read buffer.
+    let long = String(repeating: "x", count: 200_000)
+    let (path, handle) = pipe("a\n\(long)\nb\n")
+    defer { try? handle.close() }
+    XCTAssertEqual(["a", long, "b"], try lines(path))
+  }
+
+  func testReadFields() throws {
+    let path = try file("""
+    # comment only
+    host1    uptime   -a   # trailing comment
+    \thost2#no space before comment
+
+    user@host3:22
+    """)
+
+    var fields = [[String]]()
+    var remainders = [String]()
+    var numbers = [Int]()
+    try path.readFields { line in
+      fields.append((0..<line.count).map(line.string(at:)))
+      remainders.append(line.remainder(from: 0))
+      numbers.append(line.number)
+    }
+    XCTAssertEqual([["host1", "uptime", "-a"], ["host2"], ["user@host3:22"]], fields)
+    XCTAssertEqual(["host1    uptime   -a", "host2", "user@host3:22"], remainders)
+    XCTAssertEqual([2, 3, 5], numbers)
+  }
+
+  func testAssignments() throws {
+    let path = try file("""
+    key = value
+    key2=a, b ,c   # comment
+    key3 =
+    key4 x = 1
+    = 2
+    key5
+    """)
+
+    var assignments = [[String]]()
+    var errors = [String]()
+    try path.readFields { line in
+      do throws(ParseError) {
+        let (key, value, column) = try line.assignment()
+        assignments.append([key, value, String(column)])
+      } catch {
+        errors.append("\(error.line):\(error.column)")
+      }
+    }
+    XCTAssertEqual([["key", "value", "7"], ["key2", "a, b ,c", "6"], ["key3", "", "7"]], assignments)
+    XCTAssertEqual(["4:6", "5:1", "6:5"], errors)
+
+    XCTAssertEqual(["a", "b", "c"], "a, b ,c".items(separatedBy: UInt8(ascii: ",")))
+    XCTAssertEqual(["a b", "c"], " a b,,c ".items(separatedBy: UInt8(ascii: ",")))
+    XCTAssertEqual(["a", "b", "c"], "a \tb  c".items())
+  }
+
+  func testParseErrorLocation() throws {
+    let path = try file("""
+    host1
+      host[3-1] uptime
+    """)
+    var hosts = HostList()
+    XCTAssertThrowsError(try hosts.load(hostFile: path)) { error in
+      guard let error = error as? ParseError else { return XCTFail("unexpected error: \(error)") }
+      XCTAssertEqual(path.string, error.file)
+      XCTAssertEqual(2, error.line)
+      XCTAssertEqual(3, error.column)
+    }
+  }
+
+  func testLoadHostFile() throws {
+    let path = try file("""
+    host1 uptime -a
+    host[2-3]   # no command
+    """)
+    var hosts = HostList()
+    try hosts.load(hostFile: path)
+    let targets = try hosts.getHosts()
+    XCTAssertEqual(["host1", "host2", "host3"], targets.map(\.hostname))
+    XCTAssertEqual(["uptime -a", nil, nil], targets.map(\.command))
+  }
+
+  func testReadFieldsPerformance() throws {
+    var content = ""
+    for idx in 0..<200_000 {
+      content.append("user@host-\(idx).example.com:22   # host \(idx)\n")
+    }
+    let path = try file(content)
+    measure {
+      var count = 0
+      try? path.readFields { fields in count += fields.count }
+      XCTAssertEqual(200_000, count)
+    }
+  }
+}
@@ -0,0 +1,97 @@
+//
+//  HistogramTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class HistogramTests: XCTestCase {
+
+  func testEmpty() throws {
+    let histogram = Histogram()
+    XCTAssertTrue(histogram.isEmpty)
+    XCTAssertEqual(0, histogram.percentile(50))
+    XCTAssertEqual(0, histogram.percentile(99))
+    XCTAssertEqual(0, histogram.max)
+  }
+
+  func testBuckets() throws {
+    // Small values are exact.
+    for value: UInt64 in 0..<128 {
+      XCTAssertEqual(value, Histogram.highestValue(at: Histogram.index(of: value)))
+    }
+    // Buckets are contiguous, and the relative error is bounded.
+    var previous = Histogram.index(of: 127)
+    for value: UInt64 in stride(from: 128, to: 1 << 24, by: 97) {
+      let idx = Histogram.index(of: value)
+      XCTAssertGreaterThanOrEqual(idx, previous)
+      previous = idx
+      let highest = Histogram.highestValue(at: idx)
+      XCTAssertGreaterThanOrEqual(highest, value)
+      XCTAssertLessThan(Double(highest - value) / Double(value), 1.0 / 64)
+    }
+    // Huge values are saturated instead of overflowing.
+    XCTAssertEqual(Histogram.index(of: .max), Histogram.index(of: 1 << 40))
+  }
+
+  func testPercentiles() throws {
+    var histogram = Histogram()
+    // 1µs ... 10ms
+    for value: UInt64 in 1...10_000 {
+      histogram.record(value * 1000)
+    }
+    XCTAssertEqual(10_000, histogram.count)
+    XCTAssertEqual(1000, histogram.min)
+    XCTAssertEqual(10_000_000, histogram.max)
+    XCTAssertEqual(10_000_000, histogram.percentile(100))
+
+    let p50 = Double(histogram.percentile(50))
+    XCTAssertEqual(5_000_000, p50, accuracy: 5_000_000 / 64)
+    let p99 = Double(histogram.percentile(99))
+    XCTAssertEqual(9_900_000, p99, accuracy: 9_900_000 / 64)
+    XCTAssertEqual(5_000_500, histogram.mean, accuracy: 1)
+
+    histogram.reset()
+    XCTAssertTrue(histogram.isEmpty)
+    XCTAssertEqual(0, histogram.percentile(99))
+  }
+
+  func testOutlier() throws {
+    var histogram = Histogram()
+    for _ in 0..<999 {
+      histogram.record(200_000)
+    }
+    histogram.record(2_000_000_000)
+    XCTAssertEqual(Double(histogram.percentile(99)), 200_000, accuracy: 200_000 / 64)
+    XCTAssertEqual(2_000_000_000, histogram.percentile(99.99))
+    XCTAssertEqual(2_000_000_000, histogram.max)
+  }
+
+  func testRecordPerformance() throws {
+    var histogram = Histogram()
+    measure {
+      for value: UInt64 in 0..<1_000_000 {
+        histogram.record(value &* 2654435761 % 50_000_000)
+      }
+    }
+    XCTAssertGreaterThan(histogram.count, 0)
+  }
+
+  func testMerge() throws {
+    var first = Histogram()
+    var second = Histogram()
+    for value: UInt64 in 1...100 { first.record(value) }
+    for value: UInt64 in 101...200 { second.record(value) }
+    first.merge(second)
+    first.merge(Histogram())
+    XCTAssertEqual(200, first.count)
+    XCTAssertEqual(1, first.min)
+    XCTAssertEqual(200, first.max)
+    XCTAssertEqual(100.5, first.mean)
+    XCTAssertEqual(100, first.percentile(50))
+  }
+}
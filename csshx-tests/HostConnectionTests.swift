@@ -0,0 +1,110 @@
+//
+//  HostConnectionTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class HostConnectionTests: XCTestCase {
+
+  // Host end of a connection: acknowledges the input it receives, once `acknowledging` is set.
+  private final class Host {
+    private let io: DispatchIO
+    private var decoder = FrameDecoder()
+    private var unacknowledged = 0
+    var acknowledging = false {
+      didSet { acknowledge() }
+    }
+
+    init(socket: Int32) {
+      io = DispatchIO(type: .stream, fileDescriptor: socket, queue: .main, cleanupHandler: { _ in Darwin.close(socket) })
+      io.setLimit(lowWater: 1)
+      io.read(offset: 0, length: .max, queue: .main) { [self] _, data, _ in
+        guard let data, !data.isEmpty else { return }
+        try? decoder.decode(data) { frame in
+          if case .input(let bytes) = frame {
+            unacknowledged += bytes.count
+          }
+        }
+        acknowledge()
+      }
+    }
+
+    private func acknowledge() {
+      guard acknowledging, unacknowledged > 0 else { return }
+      io.write(offset: 0, data: Frame.credit(UInt32(unacknowledged)).data(), queue: .main) { _, _, _ in }
+      unacknowledged = 0
+    }
+
+    func close() {
+      io.close(flags: .stop)
+    }
+  }
+
+  private var connection: HostConnection!
+  private var host: Host!
+
+  override func tearDown() {
+    connection?.close()
+    host?.close()
+  }
+
+  private func connect(policy: HostConnection.OverflowPolicy) throws {
+    var fds: [Int32] = [-1, -1]
+    guard socketpair(AF_UNIX, SOCK_STREAM, 0, &fds) == 0 else {
+      throw POSIXError.errno
+    }
+    connection = HostConnection(socket: fds[0], limits: HostConnection.Limits(maxBytes: 1024, policy: policy))
+    connection.receive({ _ in }, whenDone: { _ in })
+    host = Host(socket: fds[1])
+  }
+
+  private func send(_ count: Int) -> Bool {
+    let (data, payload) = [UInt8](repeating: 0x41, count: count).withUnsafeBytes { (Frame.input($0).data(), $0.count) }
+    return connection.send(input: data, payload: payload)
+  }
+
+  func testDisabledHostDropsInputUntilResumed() throws {
+    try connect(policy: .disable)
+    var overflows = 0
+    connection.onOverflow = { _ in overflows += 1 }
+
+    XCTAssertTrue(send(600))
+    XCTAssertFalse(send(600))
+    // The host is disabled by the controller on overflow, later, on the main queue.
+    // A smaller chunk fitting under the mark must not be forwarded in the meantime.
+    XCTAssertFalse(send(10))
+    XCTAssertTrue(connection.lagging)
+    XCTAssertEqual(connection.bytesDropped, 610)
+    XCTAssertEqual(overflows, 1)
+
+    // Enabling the host again resumes it.
+    connection.resume()
+    XCTAssertFalse(connection.lagging)
+    XCTAssertTrue(send(10))
+  }
+
+  func testLaggingHostIsNotResumed() throws {
+    try connect(policy: .lag)
+
+    XCTAssertTrue(send(600))
+    XCTAssertFalse(send(600))
+    XCTAssertTrue(connection.lagging)
+
+    let drained = expectation(description: "queue drained")
+    connection.onRecover = { _ in drained.fulfill() }
+    host.acknowledging = true
+    wait(for: [drained], timeout: 10)
+
+    // Input was dropped: the host must be resumed explicitly.
+    XCTAssertEqual(connection.queuedBytes, 0)
+    XCTAssertTrue(connection.lagging)
+    XCTAssertFalse(send(600))
+    connection.resume()
+    XCTAssertTrue(send(600))
+  }
+}
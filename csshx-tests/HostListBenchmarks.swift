@@ -0,0 +1,82 @@
+//
+//  HostListBenchmarks.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+import System
+
+// @testable import CsshxCore
+
+final class HostListBenchmarks: Benchmark {
+
+  private var directory: URL!
+
+  override func setUpWithError() throws {
+    directory = FileManager.default.temporaryDirectory.appendingPathComponent("csshx-benchmarks-\(UUID())")
+    try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+  }
+
+  override func tearDownWithError() throws {
+    try? FileManager.default.removeItem(at: directory)
+  }
+
+  private func write(_ lines: [String], to name: String) throws -> FilePath {
+    let url = directory.appendingPathComponent(name)
+    try lines.joined(separator: "\n").write(to: url, atomically: false, encoding: .utf8)
+    return FilePath(url.path)
+  }
+
+  func testRanges() throws {
+    try benchmark("ranges") {
+      var hosts = HostList()
+      try hosts.add("web-[a-d][1-250].example.com", command: nil)
+      try hosts.add("db-[1-9][0-9]:[22,2222]", command: nil)
+      XCTAssertEqual(try hosts.getHosts().count, 1000 + 180)
+    }
+  }
+
+  func testNetworks() throws {
+    try benchmark("networks") {
+      var hosts = HostList()
+      try hosts.add("10.0.0.0/22", command: nil)
+      try hosts.add("root@192.168.[0-3].[1-200]", command: nil)
+      XCTAssertEqual(try hosts.getHosts().count, 1024 + 800)
+    }
+  }
+
+  // 200 racks of 8 nodes, grouped by rows and zones, all referenced through the top level cluster.
+  func testClustersFile() throws {
+    var lines = [String]()
+    for rack in 0..<200 {
+      lines.append("rack-\(rack) " + (0..<8).map { "node-\(rack)-\($0)" }.joined(separator: " "))
+    }
+    for row in 0..<20 {
+      lines.append("row-\(row) " + (0..<10).map { "rack-\(row * 10 + $0)" }.joined(separator: " "))
+    }
+    lines.append("zone-a " + (0..<10).map { "row-\($0)" }.joined(separator: " "))
+    lines.append("zone-b " + (10..<20).map { "row-\($0)" }.joined(separator: " "))
+    lines.append("all zone-a zone-b")
+    let file = try write(lines, to: "clusters")
+
+    try benchmark("clusters_file") {
+      var hosts = HostList()
+      hosts.load(clustersFile: file)
+      try hosts.add("all", command: nil)
+      try hosts.compileClusters(cache: nil)
+      XCTAssertEqual(try hosts.getHosts().count, 1600)
+    }
+  }
+
+  func testHostFile() throws {
+    let file = try write((0..<2000).map { "admin@host-\($0).example.com:22 uptime" }, to: "hosts")
+
+    try benchmark("host_file") {
+      var hosts = HostList()
+      try hosts.load(hostFile: file)
+      XCTAssertEqual(try hosts.count(limit: 4096), 2000)
+    }
+  }
+}
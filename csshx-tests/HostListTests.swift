@@ -127,6 +127,80 @@ final class HostListTests: XCTestCase {
       XCTAssertEqual(2, targets.count(for: "worker-\(idx).cluster"))
     }
   }
+
+  func testZeroPaddedRange() throws {
+    var hosts = HostList()
+    try hosts.add("rack[1-2]-node[008-011]", command: nil)
+
+    let targets = try hosts.getHosts().map { $0.hostname }
+    XCTAssertEqual(["rack1-node008", "rack1-node009", "rack1-node010", "rack1-node011",
+                    "rack2-node008", "rack2-node009", "rack2-node010", "rack2-node011"], targets)
+  }
+
+  func testCount() throws {
+    var hosts = HostList()
+    try hosts.add("rack[1-40]-node[001-200]", command: nil)
+    try hosts.add("10.0.0.0/16", command: nil)
+    try hosts.add("db-[a-c]+2:[22,2222]", command: nil)
+
+    XCTAssertEqual(8000 + 65536 + 12, try hosts.count(limit: .max))
+    XCTAssertThrowsError(try hosts.count(limit: 8000))
+
+    // ranges are not expanded to count them.
+    var huge = HostList()
+    try huge.add("host[0-999999][0-999999]", command: nil)
+    XCTAssertThrowsError(try huge.count())
+    XCTAssertEqual(1_000_000 * 1_000_000, try huge.count(limit: .max))
+  }
+
+  func testIterator() throws {
+    var hosts = HostList()
+    try hosts.add("host[1-3].example.com:[22-23]", command: nil)
+    try hosts.add("user@1.2.3.4/31", command: "uptime")
+
+    var targets = try hosts.makeIterator()
+    var resolved = [Target]()
+    while let target = try targets.next() {
+      resolved.append(target)
+    }
+    XCTAssertEqual(try hosts.getHosts(), resolved)
+    XCTAssertEqual(resolved.map(\.connectionString), [
+      "host1.example.com:22", "host1.example.com:23",
+      "host2.example.com:22", "host2.example.com:23",
+      "host3.example.com:22", "host3.example.com:23",
+      "user@1.2.3.4", "user@1.2.3.5",
+    ])
+    XCTAssertEqual("uptime", resolved.last?.command)
+  }
+
+  func testNetworkInRange() throws {
+    var hosts = HostList()
+    try hosts.add("10.0.[1-2].0/30", command: nil)
+
+    let targets = try hosts.getHosts().map { $0.hostname }
+    XCTAssertEqual(["10.0.1.0", "10.0.1.1", "10.0.1.2", "10.0.1.3",
+                    "10.0.2.0", "10.0.2.1", "10.0.2.2", "10.0.2.3"], targets)
+  }
+
+  func testInvalidPatterns() throws {
+    var hosts = HostList()
+    XCTAssertThrowsError(try hosts.add("host[1-3", command: nil))
+    XCTAssertThrowsError(try hosts.add("host[]", command: nil))
+    XCTAssertThrowsError(try hosts.add("host[3-1]", command: nil))
+    XCTAssertThrowsError(try hosts.add("host[a-Z]", command: nil))
+    XCTAssertThrowsError(try hosts.add("host+1", command: nil))
+    XCTAssertThrowsError(try hosts.add("host+2+3", command: nil))
+    XCTAssertThrowsError(try hosts.add("host:[1-70000]", command: nil))
+    XCTAssertThrowsError(try hosts.add("host:ssh", command: nil))
+  }
+
+  func testExpansionPerformance() throws {
+    var hosts = HostList()
+    try hosts.add("rack[1-40]-node[001-200]", command: nil)
+    measure {
+      XCTAssertEqual(8000, try? hosts.getHosts(limit: 10_000).count)
+    }
+  }
 }
 
 private extension Array<Target> {
@@ -0,0 +1,70 @@
+//
+//  InputBenchmarks.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class InputBenchmarks: Benchmark {
+
+  // 4 MB paste of shell commands, with cursor keys, and a few round trips to the action mode (Ctrl-A, Esc).
+  private static let paste: [UInt8] = {
+    var paste = [UInt8]()
+    paste.reserveCapacity(4 * 1024 * 1024)
+    var line = 0
+    while paste.count < 4 * 1024 * 1024 {
+      paste.append(contentsOf: "echo \"line \(line)\" >> /tmp/csshx-paste.txt\r".utf8)
+      if line.isMultiple(of: 64) {
+        paste.append(contentsOf: "\u{1b}[A\u{1b}[B".utf8)
+      }
+      if line.isMultiple(of: 1024) {
+        paste.append(contentsOf: [0x01, 0x1b])
+      }
+      line += 1
+    }
+    return paste
+  }()
+
+  // Input is read from stdin by 4 KB chunks, and parsed as the controller input modes do:
+  // the input mode forwards everything up to the action key, and the action mode consumes the next key.
+  func testPaste() {
+    let chunks = stride(from: 0, to: Self.paste.count, by: 4096).map { offset in
+      Self.paste[offset..<min(Self.paste.count, offset + 4096)].withUnsafeBytes { DispatchData(bytes: $0) }
+    }
+
+    benchmark("paste_4mb") {
+      var buffer = InputBuffer()
+      var action = false
+      var forwarded = 0
+      var frames = DispatchData.empty
+
+      for chunk in chunks {
+        buffer.append(chunk)
+        while !buffer.isEmpty {
+          if action {
+            // Esc
+            buffer.removeFirst()
+            action = false
+          } else if let idx = buffer.firstIndex(of: 0x01) {
+            if idx > 0 {
+              buffer.consume(idx) { frames.append(Frame.input($0).data()) }
+            }
+            buffer.removeFirst()
+            forwarded += idx
+            action = true
+          } else {
+            forwarded += buffer.count
+            buffer.consume(buffer.count) { frames.append(Frame.input($0).data()) }
+          }
+        }
+        // Frames are handed to the host connections.
+        frames = .empty
+      }
+      XCTAssertGreaterThan(forwarded, 4_000_000)
+    }
+  }
+}
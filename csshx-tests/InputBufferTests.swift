@@ -0,0 +1,78 @@
+//
+//  InputBufferTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class InputBufferTests: XCTestCase {
+
+  func testConsume() {
+    var buffer = InputBuffer()
+    XCTAssertTrue(buffer.isEmpty)
+    XCTAssertNil(buffer.first)
+
+    buffer.append(Array("hello\u{1}world".utf8))
+    XCTAssertEqual(buffer.count, 11)
+    XCTAssertEqual(buffer.firstIndex(of: 1), 5)
+    XCTAssertNil(buffer.firstIndex(of: 0))
+
+    let head = buffer.consume(5) { String(decoding: $0, as: UTF8.self) }
+    XCTAssertEqual(head, "hello")
+    XCTAssertEqual(buffer.first, 1)
+    buffer.removeFirst()
+    XCTAssertEqual(buffer.firstIndex(of: 1), nil)
+    XCTAssertTrue(buffer.starts(with: "wor".utf8))
+    XCTAssertEqual(String(decoding: buffer.bytes, as: UTF8.self), "world")
+    XCTAssertEqual(buffer[4], UInt8(ascii: "d"))
+
+    buffer.removeAll()
+    XCTAssertTrue(buffer.isEmpty)
+  }
+
+  func testAppendAfterConsume() {
+    var buffer = InputBuffer()
+    buffer.append(Array("abcdef".utf8))
+    buffer.removeFirst(4)
+    // unread bytes are kept, and stay contiguous with the new ones.
+    buffer.append(Array("gh".utf8))
+    XCTAssertEqual(String(decoding: buffer.bytes, as: UTF8.self), "efgh")
+    XCTAssertEqual(buffer.firstIndex(of: UInt8(ascii: "h")), 3)
+
+    var data = DispatchData.empty
+    Array("ij".utf8).withUnsafeBytes { data.append($0) }
+    buffer.append(data)
+    XCTAssertEqual(buffer.consume(buffer.count) { Array($0) }, Array("efghij".utf8))
+    XCTAssertTrue(buffer.isEmpty)
+  }
+
+  func testTrimPrefix() {
+    var buffer = InputBuffer("[1;2A\u{1}".utf8)
+    buffer.removeFirst()
+    buffer.trimPrefix { (0x20...0x7E).contains($0) }
+    XCTAssertEqual(buffer.count, 1)
+    XCTAssertEqual(buffer.first, 1)
+  }
+
+  // A large paste, consumed in small chunks as the input modes do.
+  func testLargePastePerformance() {
+    let chunk = [UInt8](repeating: UInt8(ascii: "x"), count: 4096)
+    measure {
+      var buffer = InputBuffer()
+      for _ in 0..<256 {
+        buffer.append(chunk)
+        while !buffer.isEmpty {
+          if let idx = buffer.firstIndex(of: 1) {
+            buffer.removeFirst(idx + 1)
+          } else {
+            buffer.consume(min(buffer.count, 16)) { _ in }
+          }
+        }
+      }
+    }
+  }
+}
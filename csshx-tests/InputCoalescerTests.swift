@@ -0,0 +1,101 @@
+//
+//  InputCoalescerTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class InputCoalescerTests: XCTestCase {
+
+  // Manual clock (ns)
+  private var now: UInt64 = 0
+  private var writes = [String]()
+
+  private func coalescer(budget: Int = 2, maxSize: Int = 16) -> InputCoalescer {
+    let coalescer = InputCoalescer(options: .init(budget: budget, maxSize: maxSize)) { [unowned self] in self.now }
+    coalescer.output = { [unowned self] in writes.append(String(decoding: $0, as: UTF8.self)) }
+    return coalescer
+  }
+
+  private func append(_ coalescer: InputCoalescer, _ str: String) {
+    Array(str.utf8).withUnsafeBytes { coalescer.append($0) }
+  }
+
+  private func advance(_ coalescer: InputCoalescer, us: UInt64) {
+    now += us * NSEC_PER_USEC
+    coalescer.advance()
+  }
+
+  func testIdleInputIsNotDelayed() {
+    let coalescer = coalescer()
+    append(coalescer, "a")
+    XCTAssertEqual(["a"], writes)
+    XCTAssertNil(coalescer.deadline)
+
+    // Interactive typing: keystrokes further apart than the budget.
+    advance(coalescer, us: 100_000)
+    append(coalescer, "b")
+    XCTAssertEqual(["a", "b"], writes)
+  }
+
+  func testBurstIsCoalesced() {
+    let coalescer = coalescer()
+    append(coalescer, "a")
+    now += 100 * NSEC_PER_USEC
+    append(coalescer, "b")
+    now += 100 * NSEC_PER_USEC
+    append(coalescer, "c")
+    XCTAssertEqual(["a"], writes)
+    // Deadline is budget after the first pending byte.
+    XCTAssertEqual(2_100 * NSEC_PER_USEC, coalescer.deadline)
+
+    advance(coalescer, us: 1_000)
+    XCTAssertEqual(["a"], writes)
+    advance(coalescer, us: 1_000)
+    XCTAssertEqual(["a", "bc"], writes)
+    XCTAssertNil(coalescer.deadline)
+    XCTAssertEqual(3, coalescer.statistics.chunks)
+    XCTAssertEqual(2, coalescer.statistics.writes)
+  }
+
+  func testMaxSize() {
+    let coalescer = coalescer(maxSize: 8)
+    append(coalescer, "start")
+    append(coalescer, "12345")
+    append(coalescer, "678")
+    XCTAssertEqual(["start", "12345678"], writes)
+    // Chunks are never split: pending input is written first.
+    append(coalescer, "abc")
+    append(coalescer, "0123456789")
+    XCTAssertEqual(["start", "12345678", "abc", "0123456789"], writes)
+    XCTAssertEqual(0, coalescer.pendingCount)
+  }
+
+  func testEscapeSequencesAreNotDelayed() {
+    let coalescer = coalescer()
+    append(coalescer, "a")
+    append(coalescer, "b")
+    // Up arrow: written right away, after the pending input.
+    append(coalescer, "\u{1b}[A")
+    XCTAssertEqual(["a", "b\u{1b}[A"], writes)
+    XCTAssertNil(coalescer.deadline)
+  }
+
+  func testFlushAndDisabledCoalescing() {
+    var coalescer = coalescer()
+    append(coalescer, "a")
+    append(coalescer, "b")
+    coalescer.flush()
+    XCTAssertEqual(["a", "b"], writes)
+
+    writes.removeAll()
+    coalescer = self.coalescer(budget: 0)
+    append(coalescer, "a")
+    append(coalescer, "b")
+    XCTAssertEqual(["a", "b"], writes)
+  }
+}
@@ -0,0 +1,167 @@
+//
+//  LaunchSchedulerTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class LaunchSchedulerTests: XCTestCase {
+
+  // Manual clock (ns)
+  private var now: UInt64 = 0
+
+  private func scheduler(concurrency: Int = 4, batchSize: Int = 2, timeout: Int = 1000) -> LaunchScheduler {
+    LaunchScheduler(options: .init(concurrency: concurrency, batchSize: batchSize, timeout: timeout, tick: 10)) { [unowned self] in self.now }
+  }
+
+  private func advance(_ scheduler: LaunchScheduler, ms: UInt64) {
+    now += ms * NSEC_PER_MSEC
+    scheduler.advance()
+  }
+
+  func testPipeline() {
+    let scheduler = scheduler()
+    var spawned = [Int]()
+    var completed = [Int]()
+    var idle = 0
+    scheduler.spawn = { spawned.append($0) }
+    scheduler.completion = { id, error in
+      XCTAssertNil(error)
+      completed.append(id)
+    }
+    scheduler.onIdle = { idle += 1 }
+
+    scheduler.enqueue(1...10)
+    // a single batch per pump.
+    XCTAssertEqual(spawned, [1, 2])
+    advance(scheduler, ms: 10)
+    XCTAssertEqual(spawned, [1, 2, 3, 4])
+    // concurrency limit reached.
+    advance(scheduler, ms: 10)
+    XCTAssertEqual(spawned, [1, 2, 3, 4])
+    XCTAssertEqual(scheduler.inflight, 4)
+
+    scheduler.didConnect(1)
+    XCTAssertEqual(scheduler.state(of: 1), .connected)
+    now += 5 * NSEC_PER_MSEC
+    scheduler.didBecomeReady(1)
+    XCTAssertEqual(scheduler.state(of: 1), .ready)
+    // ready hosts free a slot immediately.
+    XCTAssertEqual(spawned, [1, 2, 3, 4, 5])
+
+    while !scheduler.isIdle {
+      for id in spawned where scheduler.state(of: id) == .spawned {
+        scheduler.didConnect(id)
+        scheduler.didBecomeReady(id)
+      }
+      advance(scheduler, ms: 10)
+    }
+    XCTAssertEqual(spawned, Array(1...10))
+    XCTAssertEqual(completed.sorted(), Array(1...10))
+    XCTAssertEqual(idle, 1)
+    XCTAssertEqual(scheduler.timings.total.count, 10)
+    XCTAssertEqual(scheduler.timings.handshake.count, 10)
+    XCTAssertEqual(scheduler.timings.handshake.max, 5 * NSEC_PER_MSEC)
+  }
+
+  func testAcceptTime() {
+    let scheduler = scheduler()
+    scheduler.spawn = { _ in }
+    scheduler.enqueue([1])
+    XCTAssertEqual(scheduler.state(of: 1), .spawned)
+
+    // Connection accepted 6ms after the spawn, hello matched 4ms later.
+    now += 10 * NSEC_PER_MSEC
+    scheduler.didConnect(1, at: now - 4 * NSEC_PER_MSEC)
+    scheduler.didBecomeReady(1)
+    XCTAssertEqual(scheduler.timings.connect.max, 6 * NSEC_PER_MSEC)
+    XCTAssertEqual(scheduler.timings.handshake.max, 4 * NSEC_PER_MSEC)
+  }
+
+  func testTimeout() {
+    let scheduler = scheduler(timeout: 100)
+    var errors = [Int: POSIXErrorCode]()
+    scheduler.spawn = { _ in }
+    scheduler.completion = { id, error in
+      errors[id] = (error as? POSIXError)?.code
+    }
+
+    scheduler.enqueue([1, 2])
+    scheduler.didConnect(2)
+    advance(scheduler, ms: 90)
+    XCTAssertTrue(errors.isEmpty)
+    scheduler.didBecomeReady(2)
+    advance(scheduler, ms: 20)
+    XCTAssertEqual(scheduler.state(of: 1), .timeout)
+    XCTAssertEqual(errors[1], .ETIMEDOUT)
+    XCTAssertNil(errors[2])
+    XCTAssertTrue(scheduler.isIdle)
+
+    // late events are ignored.
+    scheduler.didBecomeReady(1)
+    XCTAssertEqual(scheduler.state(of: 1), .timeout)
+
+    // per launch timeout
+    scheduler.enqueue([3])
+    scheduler.enqueue([4], timeout: 500)
+    advance(scheduler, ms: 110)
+    XCTAssertEqual(errors[3], .ETIMEDOUT)
+    XCTAssertEqual(scheduler.state(of: 4), .spawned)
+    advance(scheduler, ms: 400)
+    XCTAssertEqual(errors[4], .ETIMEDOUT)
+  }
+
+  func testSpawnFailure() {
+    let scheduler = scheduler(concurrency: 2, batchSize: 8)
+    var failed = [Int]()
+    var idle = 0
+    scheduler.spawn = { id in
+      if id % 2 == 0 { throw POSIXError(.EIO) }
+    }
+    scheduler.completion = { id, error in
+      if error != nil { failed.append(id) }
+    }
+    scheduler.onIdle = { idle += 1 }
+
+    scheduler.enqueue(1...4)
+    // 2 failed synchronously, and its slot is used by 3.
+    XCTAssertEqual(failed, [2])
+    XCTAssertEqual(scheduler.inflight, 2)
+    XCTAssertEqual(scheduler.state(of: 4), .pending)
+
+    scheduler.didFail(1, error: POSIXError(.ECONNRESET))
+    XCTAssertEqual(failed, [2, 1, 4])
+    XCTAssertEqual(idle, 0)
+    scheduler.didBecomeReady(3)
+    XCTAssertEqual(idle, 1)
+  }
+
+  // Headless equivalent of a 1000 --dummy hosts session: hosts connect 20ms after being spawned.
+  func testLargeSession() {
+    let scheduler = scheduler(concurrency: 64, batchSize: 16, timeout: 5000)
+    var spawnedAt = [Int: UInt64]()
+    var ready = 0
+    scheduler.spawn = { spawnedAt[$0] = self.now }
+    scheduler.completion = { _, error in
+      XCTAssertNil(error)
+      ready += 1
+    }
+
+    scheduler.enqueue(0..<1000)
+    while !scheduler.isIdle {
+      for (id, date) in spawnedAt where now - date >= 20 * NSEC_PER_MSEC {
+        scheduler.didConnect(id)
+        scheduler.didBecomeReady(id)
+        spawnedAt[id] = nil
+      }
+      XCTAssertLessThanOrEqual(scheduler.inflight, 64)
+      advance(scheduler, ms: 10)
+    }
+    XCTAssertEqual(ready, 1000)
+    XCTAssertEqual(scheduler.timings.total.count, 1000)
+  }
+}
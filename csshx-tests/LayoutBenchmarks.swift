@@ -0,0 +1,53 @@
+//
+//  LayoutBenchmarks.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class LayoutBenchmarks: Benchmark {
+
+  private typealias Planner = LayoutPlanner<Int>
+
+  private let screens = [
+    Planner.Screen(frame: CGRect(x: 0, y: 0, width: 1728, height: 1000), reserved: 87),
+    Planner.Screen(frame: CGRect(x: 1728, y: 0, width: 2560, height: 1440)),
+  ]
+
+  func testBestLayout() {
+    benchmark("best_layout") {
+      for count in 1...2048 {
+        _ = getBestLayout(for: 16.0 / 9.0, hosts: count, on: CGSize(width: 2560, height: 1440))
+      }
+    }
+  }
+
+  func testGrids() {
+    let hosts = Array(0..<2048)
+    benchmark("grids") {
+      for count in stride(from: 16, through: hosts.count, by: 16) {
+        let byRow = HostGrid.byRow(hosts: hosts[..<count], rows: count / 16, columns: 16)
+        let byColumns = HostGrid.byColumns(hosts: hosts[..<count], rows: 16, columns: count / 16)
+        XCTAssertEqual(byRow.count + byColumns.count, 2 * count)
+      }
+    }
+  }
+
+  // Full pass, as done on each host added or removed: plan, then diff against the previous layout.
+  func testPlan() {
+    let planner = Planner(ratio: 16.0 / 9.0)
+    var hosts = Array(0..<1000)
+    var cache = Planner.Cache()
+    _ = cache.diff(planner.plan(hosts: hosts, on: screens).placements)
+
+    benchmark("plan_1000") {
+      hosts.swapAt(0, hosts.count - 1)
+      let changes = cache.diff(planner.plan(hosts: hosts, on: screens).placements)
+      XCTAssertEqual(changes.moved.count, 2)
+    }
+  }
+}
@@ -41,4 +41,189 @@ final class WindowLayoutManagerTests: XCTestCase {
     XCTAssertEqual(6, rows)
     XCTAssertEqual(4, columns)
   }
+
+  // MARK: - Planner
+  private typealias Planner = LayoutPlanner<Int>
+
+  private let screen = CGRect(x: 0, y: 0, width: 1728, height: 1000)
+
+  func testPlanAllHosts() throws {
+    let planner = Planner(ratio: 16.0 / 9.0)
+    for count in [1, 2, 3, 7, 24, 100, 999, 5000] {
+      let plan = planner.plan(hosts: Array(0..<count), on: [Planner.Screen(frame: screen, reserved: 87)])
+      XCTAssertEqual(plan.placements.map(\.id), Array(0..<count))
+
+      let grid = try XCTUnwrap(plan.grids.first ?? nil)
+      XCTAssertEqual(grid.count, count)
+      XCTAssertGreaterThanOrEqual(grid.rows * grid.columns, count)
+
+      let bounds = CGRect(x: 0, y: 87, width: 1728, height: 913)
+      for placement in plan.placements {
+        // allow rounding errors
+        XCTAssertTrue(bounds.insetBy(dx: -0.01, dy: -0.01).contains(placement.frame), "\(count): \(placement.frame)")
+        XCTAssertEqual(placement.frame.width, bounds.width / CGFloat(grid.columns), accuracy: 0.001)
+      }
+      // first window at the top left corner
+      XCTAssertEqual(plan.placements[0].frame.minX, 0)
+      XCTAssertEqual(plan.placements[0].frame.maxY, 1000, accuracy: 0.001)
+    }
+  }
+
+  func testPlanRequestedGrid() {
+    let planner = Planner(ratio: 16.0 / 9.0)
+    var plan = planner.plan(hosts: Array(0..<5), on: [Planner.Screen(frame: screen, columns: 4)])
+    XCTAssertEqual(plan.grids[0]?.grid, [[0, 1, 2, 3], [4]])
+
+    plan = planner.plan(hosts: Array(0..<5), on: [Planner.Screen(frame: screen, rows: 4)])
+    XCTAssertEqual(plan.grids[0]?.grid, [[0, 1], [2], [3], [4]])
+  }
+
+  func testPlanMultipleScreens() {
+    let planner = Planner(ratio: 16.0 / 9.0)
+    let screens = [
+      Planner.Screen(frame: screen),
+      Planner.Screen(frame: CGRect(x: 1728, y: 0, width: 864, height: 1000)),
+      Planner.Screen(frame: CGRect(x: 0, y: 1000, width: 1728, height: 1000)),
+    ]
+    // hosts dispatched proportionally to the screens area
+    var plan = planner.plan(hosts: Array(0..<50), on: screens)
+    XCTAssertEqual(plan.grids.map { $0?.count ?? 0 }, [20, 10, 20])
+    XCTAssertEqual(Set(plan.placements.map(\.id)).count, 50)
+
+    // no host left for the last screen
+    plan = planner.plan(hosts: Array(0..<2), on: screens)
+    XCTAssertEqual(plan.grids.map { $0?.count ?? 0 }, [1, 1, 0])
+    XCTAssertNil(plan.grids[2])
+  }
+
+  func testPlanUnknownRatio() {
+    // without ratio nor requested grid, nothing can be laid out.
+    let plan = Planner().plan(hosts: Array(0..<5), on: [Planner.Screen(frame: screen)])
+    XCTAssertTrue(plan.placements.isEmpty)
+  }
+
+  func testCacheDiff() {
+    let planner = Planner(ratio: 16.0 / 9.0)
+    let screens = [Planner.Screen(frame: screen)]
+    var cache = Planner.Cache()
+
+    var changes = cache.diff(planner.plan(hosts: Array(0..<24), on: screens).placements)
+    XCTAssertEqual(changes.added.count, 24)
+    XCTAssertTrue(changes.moved.isEmpty)
+
+    // Same layout -> nothing to do
+    changes = cache.diff(planner.plan(hosts: Array(0..<24), on: screens).placements)
+    XCTAssertTrue(changes.isEmpty)
+
+    // Swapping two hosts only moves them
+    var hosts = Array(0..<24)
+    hosts.swapAt(3, 17)
+    changes = cache.diff(planner.plan(hosts: hosts, on: screens).placements)
+    XCTAssertTrue(changes.added.isEmpty)
+    XCTAssertEqual(changes.moved.map(\.id).sorted(), [3, 17])
+
+    // Removing the last host switches to a 5x5 grid, and the removed host is forgotten.
+    hosts.removeLast()
+    changes = cache.diff(planner.plan(hosts: hosts, on: screens).placements)
+    XCTAssertTrue(changes.added.isEmpty)
+    XCTAssertEqual(changes.moved.count, 23)
+    XCTAssertEqual(cache.count, 23)
+
+    // Re-added host is laid out from scratch
+    hosts.append(23)
+    changes = cache.diff(planner.plan(hosts: hosts, on: screens).placements)
+    XCTAssertEqual(changes.added.map(\.id), [23])
+
+    cache.invalidate(5)
+    changes = cache.diff(planner.plan(hosts: hosts, on: screens).placements)
+    XCTAssertEqual(changes.added.map(\.id), [5])
+
+    cache.invalidateAll()
+    changes = cache.diff(planner.plan(hosts: hosts, on: screens).placements)
+    XCTAssertEqual(changes.added.count, 24)
+  }
+
+  func testBestLayoutPerformance() {
+    measure {
+      for count in 1...5000 {
+        _ = getBestLayout(for: 16.0 / 9.0, hosts: count, on: CGSize(width: 1728, height: 1000))
+      }
+    }
+  }
+
+  func testPlanPerformance() {
+    let planner = Planner(ratio: 16.0 / 9.0)
+    let screens = [Planner.Screen(frame: screen), Planner.Screen(frame: CGRect(x: 1728, y: 0, width: 1728, height: 1000))]
+    let hosts = Array(0..<5000)
+    var cache = Planner.Cache()
+    measure {
+      let plan = planner.plan(hosts: hosts, on: screens)
+      _ = cache.diff(plan.placements)
+    }
+  }
+
+  // MARK: - Grid
+  func testGridNavigation() {
+    // 5 hosts by columns on 4 rows: [[0, 1], [2], [3], [4]]
+    let grid = HostGrid.byColumns(hosts: ArraySlice(0..<5), rows: 4, columns: 2)
+    XCTAssertEqual(grid.rowCount, 4)
+    XCTAssertTrue(grid.position(of: 2)! == (1, 0))
+    XCTAssertNil(grid.position(of: 5))
+
+    XCTAssertEqual(grid.getHostRight(of: 0), 1)
+    XCTAssertNil(grid.getHostRight(of: 1))
+    XCTAssertNil(grid.getHostLeft(of: 0))
+    XCTAssertEqual(grid.getHostBelow(0), 2)
+    XCTAssertNil(grid.getHostBelow(1))
+    XCTAssertEqual(grid.getHostAbove(2), 0)
+    XCTAssertNil(grid.getHostBelow(4))
+
+    XCTAssertEqual(Array(grid.row(0)), [0, 1])
+    XCTAssertEqual(grid.column(0), [0, 2, 3, 4])
+    XCTAssertEqual(grid.column(1), [1])
+  }
+
+  func testLayoutNavigation() {
+    let planner = Planner(ratio: 16.0 / 9.0)
+    let screens = [
+      Planner.Screen(frame: screen, columns: 3),
+      Planner.Screen(frame: CGRect(x: 1728, y: 0, width: 1728, height: 1000), columns: 2),
+    ]
+    // [[0, 1, 2], [3, 4]] and [[5, 6], [7, 8], [9]]
+    let layout = planner.plan(hosts: Array(0..<10), on: screens).layout
+    XCTAssertEqual(layout.count, 10)
+    XCTAssertEqual(layout.position(of: 8), HostLayout<Int>.Position(screen: 1, row: 1, column: 1))
+
+    XCTAssertEqual(layout.neighbour(of: 1, .right), 2)
+    // continue on next screen, same row
+    XCTAssertEqual(layout.neighbour(of: 2, .right), 5)
+    XCTAssertEqual(layout.neighbour(of: 4, .right), 7)
+    XCTAssertNil(layout.neighbour(of: 8, .right))
+    // and back
+    XCTAssertEqual(layout.neighbour(of: 7, .left), 4)
+    // missing row on previous screen -> last row
+    XCTAssertEqual(layout.neighbour(of: 9, .left), 4)
+    XCTAssertNil(layout.neighbour(of: 0, .left))
+    XCTAssertEqual(layout.neighbour(of: 6, .down), 8)
+    XCTAssertNil(layout.neighbour(of: 6, .up))
+
+    XCTAssertEqual(layout.row(of: 4), [3, 4])
+    XCTAssertEqual(layout.column(of: 7), [5, 7, 9])
+    XCTAssertEqual(layout.screen(of: 9), [5, 6, 7, 8, 9])
+    XCTAssertEqual(layout.row(of: 42), [])
+  }
+
+  func testNavigationPerformance() {
+    let layout = Planner(ratio: 16.0 / 9.0).plan(hosts: Array(0..<1000), on: [Planner.Screen(frame: screen)]).layout
+    measure {
+      for _ in 0..<100 {
+        // walk the whole grid
+        var host = 0
+        while let next = layout.neighbour(of: host, .right) { host = next }
+        while let next = layout.neighbour(of: host, .down) { host = next }
+        while let next = layout.neighbour(of: host, .left) { host = next }
+        while let next = layout.neighbour(of: host, .up) { host = next }
+      }
+    }
+  }
 }
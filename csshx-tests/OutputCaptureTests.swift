@@ -0,0 +1,77 @@
+//
+//  OutputCaptureTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class OutputCaptureTests: XCTestCase {
+
+  func testHasherSplitInvariance() {
+    let content = (0..<1000).map { UInt8(truncatingIfNeeded: $0 &* 7) }
+    var whole = StreamHasher()
+    content.withUnsafeBytes { whole.update($0) }
+
+    for split in [1, 3, 7, 8, 9, 100, 999] {
+      var hasher = StreamHasher()
+      content.withUnsafeBytes { bytes in
+        var offset = 0
+        while offset < bytes.count {
+          let end = min(bytes.count, offset + split)
+          hasher.update(UnsafeRawBufferPointer(rebasing: bytes[offset..<end]))
+          offset = end
+        }
+      }
+      XCTAssertEqual(hasher.finalize(), whole.finalize(), "split: \(split)")
+      XCTAssertEqual(hasher.count, content.count)
+    }
+
+    var other = StreamHasher()
+    content.dropLast().withUnsafeBytes { other.update($0) }
+    XCTAssertNotEqual(other.finalize(), whole.finalize())
+  }
+
+  func testGrouping() {
+    let capture = OutputCapture<Int>(sampleSize: 1024)
+    capture.begin(command: "uname")
+
+    func receive(_ output: String, from host: Int) {
+      Array(output.utf8).withUnsafeBytes { capture.append($0, from: host) }
+    }
+    // Command echo and next prompt include the hostname, and are ignored.
+    for host in 1...3 {
+      receive("host\(host)$ uname\r\nDar", from: host)
+      receive("win\r\nhost\(host)$ ", from: host)
+    }
+    receive("host4$ uname\r\nLinux\r\nhost4$ ", from: 4)
+
+    let variants = capture.variants(of: 1...5)
+    XCTAssertEqual(variants.map(\.hosts), [[1, 2, 3], [4], [5]])
+    XCTAssertEqual(String(decoding: variants[0].sample, as: UTF8.self), "Darwin\r\n")
+    XCTAssertEqual(String(decoding: variants[1].sample, as: UTF8.self), "Linux\r\n")
+    XCTAssertEqual(variants[2].size, 0)
+    XCTAssertEqual(capture.command, "uname")
+
+    // A new command resets the output.
+    capture.begin(command: "true")
+    XCTAssertEqual(capture.variants(of: 1...5).map(\.hosts), [[1, 2, 3, 4, 5]])
+  }
+
+  func testSampleTruncation() {
+    let capture = OutputCapture<Int>(sampleSize: 4)
+    let output = Array("$ cat\nline 1\nline 2\n".utf8)
+    output.withUnsafeBytes { capture.append($0, from: 1) }
+    // The whole output is hashed, only the sample is truncated.
+    Array("$ cat\nline 1\nline 3\n".utf8).withUnsafeBytes { capture.append($0, from: 2) }
+
+    let variants = capture.variants(of: [1, 2])
+    XCTAssertEqual(variants.count, 2)
+    XCTAssertEqual(variants[0].sample, Array("line".utf8))
+    XCTAssertEqual(variants[0].size, 14)
+    XCTAssertTrue(variants[0].truncated)
+  }
+}
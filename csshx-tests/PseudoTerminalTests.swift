@@ -0,0 +1,99 @@
+//
+//  PseudoTerminalTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class PseudoTerminalTests: XCTestCase {
+
+  // A 200 lines paste.
+  private static let payload: [UInt8] = Array(repeating: Array("set interfaces ge-0/0/0 unit 0 family inet dhcp\n".utf8), count: 200).flatMap { $0 }
+
+  // Open a pty with a raw slave, and drain the slave in background while running body.
+  private func withTerminal(_ body: (PseudoTerminal) throws -> Void, received: (([UInt8]) -> Void)? = nil) throws {
+    let pty = try PseudoTerminal.open()
+    let slave = open(pty.slave, O_RDWR | O_NOCTTY)
+    XCTAssertGreaterThanOrEqual(slave, 0)
+
+    // Raw mode, so the line discipline neither buffers lines nor echoes them back to the master.
+    var t = termios()
+    tcgetattr(slave, &t)
+    cfmakeraw(&t)
+    tcsetattr(slave, TCSANOW, &t)
+
+    let done = DispatchSemaphore(value: 0)
+    nonisolated(unsafe) var data = [UInt8]()
+    Thread.detachNewThread {
+      var buffer = [UInt8](repeating: 0, count: 64 * 1024)
+      while true {
+        let count = read(slave, &buffer, buffer.count)
+        guard count > 0 else { break }
+        data.append(contentsOf: buffer[0..<count])
+      }
+      done.signal()
+    }
+
+    try body(pty)
+
+    // Closing the master wakes up the reader (EIO)
+    pty.close()
+    done.wait()
+    close(slave)
+    received?(data)
+  }
+
+  private static func write(_ fd: Int32, _ bytes: ArraySlice<UInt8>) {
+    var remaining = bytes
+    while !remaining.isEmpty {
+      let count = remaining.withUnsafeBytes { Darwin.write(fd, $0.baseAddress, $0.count) }
+      guard count > 0 else { return }
+      remaining = remaining.dropFirst(count)
+    }
+  }
+
+  func testBulkWrite() throws {
+    try withTerminal { pty in
+      Self.write(pty.master, Self.payload[...])
+      // wait for the reader to consume everything.
+      usleep(100_000)
+    } received: { data in
+      XCTAssertEqual(Self.payload, data)
+    }
+  }
+
+  func testWindowSize() throws {
+    let pty = try PseudoTerminal.open()
+    defer { pty.close() }
+
+    pty.windowSize = winsize(ws_row: 42, ws_col: 132, ws_xpixel: 0, ws_ypixel: 0)
+    XCTAssertEqual(42, pty.windowSize?.ws_row)
+    XCTAssertEqual(132, pty.windowSize?.ws_col)
+  }
+
+  // pty injection mode: one write() per chunk received from the controller.
+  func testBulkInjectionPerformance() throws {
+    try withTerminal { pty in
+      measure {
+        Self.write(pty.master, Self.payload[...])
+      }
+    }
+  }
+
+  // tiocsti injection mode: one syscall per byte.
+  // TIOCSTI only works on the controlling terminal of the calling process, which the test runner does not have,
+  // so this is approximated using one single byte write() per character, which goes through the same line discipline path.
+  func testPerByteInjectionPerformance() throws {
+    try withTerminal { pty in
+      measure {
+        for idx in Self.payload.indices {
+          Self.write(pty.master, Self.payload[idx...idx])
+        }
+      }
+    }
+  }
+}
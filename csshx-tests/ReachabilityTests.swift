@@ -0,0 +1,141 @@
+//
+//  ReachabilityTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class ReachabilityTests: XCTestCase {
+
+  private var listener: Int32 = -1
+  private var port: UInt16 = 0
+
+  override func setUpWithError() throws {
+    (listener, port) = try Self.listen()
+  }
+
+  override func tearDownWithError() throws {
+    if listener >= 0 {
+      close(listener)
+    }
+  }
+
+  // Local TCP listener on an ephemeral port.
+  private static func listen() throws -> (Int32, UInt16) {
+    let fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)
+    guard fd >= 0 else { throw POSIXError.errno }
+
+    var addr = sockaddr_in()
+    addr.sin_len = UInt8(MemoryLayout<sockaddr_in>.size)
+    addr.sin_family = sa_family_t(AF_INET)
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1")
+    var len = socklen_t(MemoryLayout<sockaddr_in>.size)
+    let result = withUnsafeMutablePointer(to: &addr) { ptr in
+      ptr.withMemoryRebound(to: sockaddr.self, capacity: 1) { sa in
+        bind(fd, sa, len) == 0 && Darwin.listen(fd, 16) == 0 && getsockname(fd, sa, &len) == 0
+      }
+    }
+    guard result else {
+      let error = POSIXError.errno
+      close(fd)
+      throw error
+    }
+    return (fd, UInt16(bigEndian: addr.sin_port))
+  }
+
+  // Local IPv6 TCP listener on an ephemeral port.
+  private static func listen6() throws -> (Int32, UInt16) {
+    let fd = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP)
+    guard fd >= 0 else { throw POSIXError.errno }
+
+    var addr = sockaddr_in6()
+    addr.sin6_len = UInt8(MemoryLayout<sockaddr_in6>.size)
+    addr.sin6_family = sa_family_t(AF_INET6)
+    addr.sin6_addr = in6addr_loopback
+    var len = socklen_t(MemoryLayout<sockaddr_in6>.size)
+    let result = withUnsafeMutablePointer(to: &addr) { ptr in
+      ptr.withMemoryRebound(to: sockaddr.self, capacity: 1) { sa in
+        bind(fd, sa, len) == 0 && Darwin.listen(fd, 16) == 0 && getsockname(fd, sa, &len) == 0
+      }
+    }
+    guard result else {
+      let error = POSIXError.errno
+      close(fd)
+      throw error
+    }
+    return (fd, UInt16(bigEndian: addr.sin6_port))
+  }
+
+  private func target(_ hostname: String, port: UInt16? = nil) -> Target {
+    Target(user: nil, hostname: hostname, port: port, command: nil)
+  }
+
+  func testTCPProbe() throws {
+    let checker = Reachability(options: .init(method: .tcp, timeout: 1000))
+    // 'localhost' is resolved through /etc/hosts.
+    XCTAssertEqual(checker.check([target("127.0.0.1", port: port), target("localhost", port: port)]),
+                   [.reachable, .reachable])
+  }
+
+  func testClosedPort() throws {
+    // Reserve an ephemeral port, then close it.
+    let (fd, closed) = try Self.listen()
+    close(fd)
+
+    let checker = Reachability(options: .init(method: .tcp, timeout: 1000))
+    XCTAssertEqual(checker.check([target("127.0.0.1", port: closed)]), [.unreachable(.ECONNREFUSED)])
+  }
+
+  func testUnresolvedHost() throws {
+    let checker = Reachability(options: .init(method: .tcp, timeout: 1000))
+    let statuses = checker.check([target("csshx-tests.invalid", port: port), target("localhost", port: port)])
+    XCTAssertEqual(statuses.count, 2)
+    guard case .unresolved = statuses[0] else {
+      return XCTFail("unexpected status: \(statuses[0])")
+    }
+    XCTAssertEqual(statuses[1], .reachable)
+  }
+
+  func testICMPProbe() throws {
+    let fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP)
+    guard fd >= 0 else {
+      throw XCTSkip("ICMP sockets not permitted")
+    }
+    close(fd)
+
+    let checker = Reachability(options: .init(method: .icmp, timeout: 1000))
+    XCTAssertEqual(checker.check([target("127.0.0.1"), target("localhost", port: 2222)]), [.reachable, .reachable])
+  }
+
+  func testICMPFallbackUsesTargetPort() throws {
+    let fd: Int32
+    let port: UInt16
+    do {
+      (fd, port) = try Self.listen6()
+    } catch {
+      throw XCTSkip("IPv6 loopback not available: \(error)")
+    }
+    defer { close(fd) }
+
+    // No ICMP for IPv6: probed with TCP, on the target port (not the default ssh port).
+    let checker = Reachability(options: .init(method: .icmp, timeout: 1000))
+    XCTAssertEqual(checker.check([target("::1", port: port)]), [.reachable])
+  }
+
+  func testLookupCache() throws {
+    let checker = Reachability(options: .init(method: .tcp, timeout: 1000, concurrency: 4))
+    let targets = (0..<32).map { _ in target("localhost", port: port) }
+    XCTAssertEqual(checker.check(targets), Array(repeating: .reachable, count: 32))
+    XCTAssertEqual(checker.check([target("localhost", port: port)]), [.reachable])
+    XCTAssertEqual(checker.lookups, 1)
+  }
+
+  func testChecksum() {
+    // echo request, id 0x1234, seq 1
+    XCTAssertEqual(Reachability.checksum([8, 0, 0, 0, 0x12, 0x34, 0, 1]), 0xe5ca)
+  }
+}
@@ -0,0 +1,56 @@
+//
+//  RingBufferTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class RingBufferTests: XCTestCase {
+
+  private func append(_ string: String, to buffer: inout RingBuffer) {
+    Array(string.utf8).withUnsafeBytes { buffer.append($0) }
+  }
+
+  private func content(_ buffer: RingBuffer) -> String {
+    String(decoding: buffer.bytes, as: UTF8.self)
+  }
+
+  func testGrowth() {
+    var buffer = RingBuffer(capacity: 8)
+    XCTAssertTrue(buffer.isEmpty)
+    append("abc", to: &buffer)
+    append("de", to: &buffer)
+    XCTAssertEqual(content(buffer), "abcde")
+    XCTAssertEqual(buffer.count, 5)
+  }
+
+  func testWrap() {
+    var buffer = RingBuffer(capacity: 8)
+    append("abcdef", to: &buffer)
+    append("ghij", to: &buffer)
+    XCTAssertEqual(content(buffer), "cdefghij")
+    append("klmnopqrs", to: &buffer)
+    XCTAssertEqual(content(buffer), "lmnopqrs")
+    append("t", to: &buffer)
+    XCTAssertEqual(content(buffer), "mnopqrst")
+    XCTAssertEqual(buffer.count, 8)
+    XCTAssertEqual(buffer.total, 20)
+  }
+
+  func testDispatchData() {
+    var buffer = RingBuffer(capacity: 4)
+    var data = DispatchData.empty
+    Array("hello".utf8).withUnsafeBytes { data.append($0) }
+    Array(" world".utf8).withUnsafeBytes { data.append($0) }
+    buffer.append(data)
+    XCTAssertEqual(content(buffer), "orld")
+
+    buffer.removeAll()
+    XCTAssertTrue(buffer.isEmpty)
+    XCTAssertEqual(buffer.total, 11)
+  }
+}
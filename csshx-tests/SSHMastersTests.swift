@@ -0,0 +1,105 @@
+//
+//  SSHMastersTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class SSHMastersTests: XCTestCase {
+
+  private var directory: URL!
+  private var log: URL { directory.appendingPathComponent("ssh.log") }
+
+  override func setUpWithError() throws {
+    directory = FileManager.default.temporaryDirectory.appendingPathComponent("csshx-tests-\(UUID())")
+    try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+  }
+
+  override func tearDownWithError() throws {
+    try? FileManager.default.removeItem(at: directory)
+  }
+
+  // Fake ssh: logs its arguments, fails for the 'down' host, and is slow to start for the 'slow' host.
+  private func fakeSSH() throws -> String {
+    let url = directory.appendingPathComponent("ssh")
+    try """
+    #!/bin/sh
+    echo "$@" >> '\(log.path)'
+    for last; do :; done
+    [ "$last" = down ] && exit 255
+    [ "$last" = slow ] && sleep 0.5
+    exit 0
+    """.write(to: url, atomically: false, encoding: .utf8)
+    try FileManager.default.setAttributes([.posixPermissions: 0o755], ofItemAtPath: url.path)
+    return url.path
+  }
+
+  private func calls() throws -> [String] {
+    guard FileManager.default.fileExists(atPath: log.path) else { return [] }
+    return try String(contentsOf: log, encoding: .utf8).split(separator: "\n").map(String.init)
+  }
+
+  func testPrewarm() throws {
+    let masters = SSHMasters(options: SSHMasters.Options(ssh: try fakeSSH(), sshArgs: "-o ConnectTimeout=1",
+                                                         directory: directory.path, concurrency: 2))
+    let idle = expectation(description: "masters started")
+    idle.assertForOverFulfill = false
+    masters.onIdle = { idle.fulfill() }
+
+    let a = Target(user: "john", hostname: "a", port: 2222, command: nil)
+    let b = Target(user: nil, hostname: "b", port: nil, command: "uptime")
+    let down = Target(user: nil, hostname: "down", port: nil, command: nil)
+    // A target shares its master with the same host, whatever the command.
+    let same = Target(user: "john", hostname: "a", port: 2222, command: "ls")
+    XCTAssertEqual(masters.controlPath(for: a), masters.controlPath(for: same))
+    XCTAssertNotEqual(masters.controlPath(for: a), masters.controlPath(for: Target(user: nil, hostname: "a", port: 2222, command: nil)))
+
+    masters.prewarm([a, b, same, down])
+    wait(for: [idle], timeout: 10)
+
+    XCTAssertEqual(.ready, masters.states[masters.controlPath(for: a)])
+    XCTAssertEqual(.ready, masters.states[masters.controlPath(for: b)])
+    XCTAssertEqual(.failed, masters.states[masters.controlPath(for: down)])
+
+    var lines = try calls()
+    XCTAssertEqual(3, lines.count)
+    XCTAssertTrue(lines.contains("-M -N -f -o BatchMode=yes -o ControlPath=\(masters.controlPath(for: a)) -o ControlPersist=60 -l john -p 2222 -o ConnectTimeout=1 a"))
+
+    // Ready masters are not started again.
+    masters.prewarm([a])
+    XCTAssertTrue(masters.isIdle)
+
+    // Only ready masters are stopped.
+    masters.close()
+    let deadline = Date() + 10
+    while lines.count < 5, Date() < deadline {
+      RunLoop.current.run(until: Date() + 0.01)
+      lines = try calls()
+    }
+    XCTAssertEqual(5, lines.count)
+    XCTAssertTrue(lines.contains("-O exit -o ControlPath=\(masters.controlPath(for: b)) b"))
+  }
+
+  func testCloseWhileStarting() throws {
+    let masters = SSHMasters(options: SSHMasters.Options(ssh: try fakeSSH(), directory: directory.path))
+    let slow = Target(user: nil, hostname: "slow", port: nil, command: nil)
+    masters.prewarm([slow])
+    XCTAssertEqual(.starting, masters.states[masters.controlPath(for: slow)])
+    masters.close()
+
+    // Stopped once started.
+    let exit = "-O exit -o ControlPath=\(masters.controlPath(for: slow)) slow"
+    let deadline = Date() + 10
+    var lines = try calls()
+    while !lines.contains(exit), Date() < deadline {
+      RunLoop.current.run(until: Date() + 0.01)
+      lines = try calls()
+    }
+    XCTAssertEqual(.ready, masters.states[masters.controlPath(for: slow)])
+    XCTAssertTrue(lines.contains(exit))
+  }
+}
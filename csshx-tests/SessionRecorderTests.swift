@@ -0,0 +1,87 @@
+//
+//  SessionRecorderTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class SessionRecorderTests: XCTestCase {
+
+  private var path: String = ""
+
+  override func setUp() {
+    path = FileManager.default.temporaryDirectory.appendingPathComponent("csshx-recording-\(UUID()).bin").path
+  }
+
+  override func tearDown() {
+    unlink(path)
+  }
+
+  private func record(_ recorder: SessionRecorder, _ string: String, host: String? = nil) {
+    Array(string.utf8).withUnsafeBytes { recorder.record($0, host: host) }
+  }
+
+  func testRoundTrip() throws {
+    var now: UInt64 = 1000
+    let recorder = try SessionRecorder(path: path, clock: { now })
+    record(recorder, "ls -l\r")
+    now += 250_000
+    record(recorder, "web-1", host: "admin@web-1")
+    now += 1_000_000
+    record(recorder, "db-1", host: "db-1:2222")
+    record(recorder, "web-1 again", host: "admin@web-1")
+    record(recorder, "")
+    recorder.close()
+    XCTAssertEqual(recorder.recordedBytes, 26)
+
+    let recording = try Recording(contentsOf: path)
+    XCTAssertEqual(recording.hosts, ["admin@web-1", "db-1:2222"])
+    XCTAssertEqual(recording.entries.map(\.time), [0, 250_000, 1_250_000, 1_250_000, 1_250_000])
+    XCTAssertEqual(recording.entries.map(\.host), [nil, 0, 1, 0, nil])
+    XCTAssertEqual(recording.entries.map { String(decoding: $0.bytes, as: UTF8.self) },
+                   ["ls -l\r", "web-1", "db-1", "web-1 again", ""])
+    XCTAssertEqual(recording.duration, 1_250_000)
+    XCTAssertEqual(recording.byteCount, 26)
+  }
+
+  func testTargets() throws {
+    var now: UInt64 = 0
+    let recorder = try SessionRecorder(path: path, clock: { now })
+    record(recorder, "before")
+    recorder.record(targets: ["web-1", "web-2"])
+    record(recorder, "uptime\r")
+    // Unchanged: not recorded again.
+    recorder.record(targets: ["web-1", "web-2"])
+    now += 1000
+    recorder.record(targets: ["web-2"])
+    record(recorder, "web-1 only", host: "web-1")
+    record(recorder, "reboot\r")
+    recorder.close()
+
+    let recording = try Recording(contentsOf: path)
+    XCTAssertEqual(recording.hosts, ["web-1", "web-2"])
+    XCTAssertEqual(recording.entries.map(\.targets), [nil, [0, 1], nil, [1]])
+    XCTAssertEqual(recording.entries.map(\.host), [nil, nil, 0, nil])
+  }
+
+  func testInvalidRecording() throws {
+    let recorder = try SessionRecorder(path: path)
+    record(recorder, "hello world")
+    recorder.close()
+
+    let data = try Data(contentsOf: URL(fileURLWithPath: path))
+    // truncated
+    XCTAssertThrowsError(try Recording(data: data.dropLast(3)))
+    // bad magic
+    var invalid = data
+    invalid[0] = 0
+    XCTAssertThrowsError(try Recording(data: invalid))
+    // unknown record
+    XCTAssertThrowsError(try Recording(data: data + [42]))
+    XCTAssertEqual(try Recording(data: data).entries.count, 1)
+  }
+}
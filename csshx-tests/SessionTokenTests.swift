@@ -0,0 +1,113 @@
+//
+//  SessionTokenTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class SessionTokenTests: XCTestCase {
+
+  private var fds: [Int32] = [-1, -1]
+
+  override func setUpWithError() throws {
+    guard socketpair(AF_UNIX, SOCK_STREAM, 0, &fds) == 0 else {
+      throw POSIXError.errno
+    }
+  }
+
+  override func tearDown() {
+    fds.forEach { Darwin.close($0) }
+  }
+
+  // Send frame from the host end of the socket pair.
+  private func send(_ frame: Frame) throws {
+    let bytes = Array(frame.data())
+    let written = bytes.withUnsafeBytes { Darwin.write(fds[1], $0.baseAddress, $0.count) }
+    guard written == bytes.count else { throw POSIXError.errno }
+  }
+
+  // Match the first frame received on the controller end of the socket pair.
+  private func accept(_ sessions: inout PendingSessions<String>) throws -> String {
+    var buffer = [UInt8](repeating: 0, count: 256)
+    let count = buffer.withUnsafeMutableBytes { Darwin.read(fds[0], $0.baseAddress, $0.count) }
+    guard count > 0 else { throw POSIXError.errno }
+
+    var decoder = FrameDecoder()
+    var matched: String? = nil
+    try buffer[..<count].withUnsafeBytes { bytes in
+      try decoder.decode(bytes) { frame in
+        if matched == nil {
+          matched = try sessions.match(frame)
+        }
+      }
+    }
+    return try XCTUnwrap(matched)
+  }
+
+  func testDescription() {
+    let token = SessionToken(high: 0x0123_4567_89ab_cdef, low: 0x42)
+    XCTAssertEqual(token.description, "0123456789abcdef0000000000000042")
+    XCTAssertEqual(SessionToken(token.description), token)
+    XCTAssertNil(SessionToken("0123456789abcdef"))
+    XCTAssertNil(SessionToken("0123456789abcdefg000000000000042"))
+    XCTAssertNotEqual(SessionToken.random(), SessionToken.random())
+  }
+
+  func testMatch() throws {
+    var sessions = PendingSessions<String>()
+    let tokens = (0..<100).map { _ in SessionToken.random() }
+    for (idx, token) in tokens.enumerated() {
+      sessions.insert("host-\(idx)", for: token)
+    }
+    XCTAssertEqual(sessions.count, 100)
+
+    try send(.hello(version: Wire.version, pid: 42, token: tokens[57]))
+    XCTAssertEqual(try accept(&sessions), "host-57")
+    XCTAssertEqual(sessions.count, 99)
+  }
+
+  func testSingleUse() throws {
+    var sessions = PendingSessions<String>()
+    let token = SessionToken.random()
+    sessions.insert("host", for: token)
+
+    try send(.hello(version: Wire.version, pid: 42, token: token))
+    XCTAssertEqual(try accept(&sessions), "host")
+
+    try send(.hello(version: Wire.version, pid: 43, token: token))
+    XCTAssertThrowsError(try accept(&sessions)) { error in
+      guard case WireError.unknownSession = error else { return XCTFail("unexpected error: \(error)") }
+    }
+    XCTAssertTrue(sessions.isEmpty)
+  }
+
+  func testRejectedHandshake() throws {
+    var sessions = PendingSessions<String>()
+    let token = SessionToken.random()
+    sessions.insert("host", for: token)
+
+    try send(.hello(version: Wire.version, pid: 42, token: .random()))
+    XCTAssertThrowsError(try accept(&sessions)) { error in
+      guard case WireError.unknownSession = error else { return XCTFail("unexpected error: \(error)") }
+    }
+
+    try send(.resize(rows: 24, columns: 80))
+    XCTAssertThrowsError(try accept(&sessions)) { error in
+      guard case WireError.unexpectedFrame(.resize) = error else { return XCTFail("unexpected error: \(error)") }
+    }
+
+    try send(.hello(version: Wire.version + 1, pid: 42, token: token))
+    XCTAssertThrowsError(try accept(&sessions)) { error in
+      guard case WireError.unsupportedVersion = error else { return XCTFail("unexpected error: \(error)") }
+    }
+
+    // Failed attempts do not consume the token.
+    XCTAssertEqual(sessions.count, 1)
+    sessions.remove(token)
+    XCTAssertTrue(sessions.isEmpty)
+  }
+}
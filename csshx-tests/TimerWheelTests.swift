@@ -0,0 +1,60 @@
+//
+//  TimerWheelTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+final class TimerWheelTests: XCTestCase {
+
+  func testExpiration() {
+    var wheel = TimerWheel<Int>(tick: 10, slots: 8, now: 0)
+    wheel.schedule(1, at: 25)
+    wheel.schedule(2, at: 5)
+    wheel.schedule(3, at: 40)
+
+    XCTAssertEqual(wheel.advance(to: 9), [2])
+    XCTAssertEqual(wheel.advance(to: 24), [])
+    XCTAssertEqual(wheel.advance(to: 25), [1])
+    XCTAssertEqual(wheel.count, 1)
+    XCTAssertEqual(wheel.advance(to: 100), [3])
+    XCTAssertTrue(wheel.isEmpty)
+  }
+
+  func testCancelAndReschedule() {
+    var wheel = TimerWheel<String>(tick: 10, slots: 8, now: 0)
+    wheel.schedule("a", at: 20)
+    wheel.schedule("b", at: 20)
+    wheel.cancel("a")
+    wheel.schedule("b", at: 50)
+
+    XCTAssertEqual(wheel.advance(to: 30), [])
+    XCTAssertEqual(wheel.deadline(for: "b"), 50)
+    XCTAssertEqual(wheel.advance(to: 50), ["b"])
+    XCTAssertTrue(wheel.isEmpty)
+  }
+
+  func testMultipleRounds() {
+    // 8 slots of 10 -> a revolution is 80.
+    var wheel = TimerWheel<Int>(tick: 10, slots: 8, now: 0)
+    wheel.schedule(1, at: 15)
+    wheel.schedule(2, at: 95)
+    wheel.schedule(3, at: 400)
+
+    var expired = [Int]()
+    for now in stride(from: 0, through: 400, by: 5) {
+      for key in wheel.advance(to: UInt64(now)) {
+        expired.append(key)
+        // never expire early, nor later than the tick following the deadline
+        let deadline = [1: 15, 2: 95, 3: 400][key]!
+        XCTAssertGreaterThanOrEqual(UInt64(now), deadline)
+        XCTAssertLessThanOrEqual(UInt64(now), deadline + wheel.tick)
+      }
+    }
+    XCTAssertEqual(expired, [1, 2, 3])
+  }
+}
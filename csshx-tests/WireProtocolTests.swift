@@ -0,0 +1,226 @@
+//
+//  WireProtocolTests.swift
+//  csshx-tests
+//
+//  Created by Jean-Daniel Dupas.
+//
+
+import XCTest
+
+// @testable import CsshxCore
+
+// Owning version of Frame, for comparison.
+private enum Message: Equatable {
+  case hello(UInt8, Int32, SessionToken)
+  case input([UInt8])
+  case resize(UInt16, UInt16)
+  case ping(UInt32, UInt64)
+  case pong(UInt32, UInt64, UInt64)
+  case status(Int32, Int32?)
+  case credit(UInt32)
+  case relayStats(RelayStats)
+  case output([UInt8])
+  case resume
+
+  init(_ frame: Frame) {
+    switch frame {
+      case .hello(let version, let pid, let token): self = .hello(version, pid, token)
+      case .input(let bytes): self = .input(Array(bytes))
+      case .resize(let rows, let columns): self = .resize(rows, columns)
+      case .ping(let id, let ts): self = .ping(id, ts)
+      case .pong(let id, let ts, let received): self = .pong(id, ts, received)
+      case .status(let pid, let code): self = .status(pid, code)
+      case .credit(let count): self = .credit(count)
+      case .relayStats(let stats): self = .relayStats(stats)
+      case .output(let bytes): self = .output(Array(bytes))
+      case .resume: self = .resume
+    }
+  }
+
+  func withFrame<R>(_ body: (Frame) throws -> R) rethrows -> R {
+    switch self {
+      case .hello(let version, let pid, let token): return try body(.hello(version: version, pid: pid, token: token))
+      case .input(let bytes): return try bytes.withUnsafeBytes { try body(.input($0)) }
+      case .resize(let rows, let columns): return try body(.resize(rows: rows, columns: columns))
+      case .ping(let id, let ts): return try body(.ping(id: id, timestamp: ts))
+      case .pong(let id, let ts, let received): return try body(.pong(id: id, timestamp: ts, received: received))
+      case .status(let pid, let code): return try body(.status(pid: pid, exitCode: code))
+      case .credit(let count): return try body(.credit(count))
+      case .relayStats(let stats): return try body(.relayStats(stats))
+      case .output(let bytes): return try bytes.withUnsafeBytes { try body(.output($0)) }
+      case .resume: return try body(.resume)
+    }
+  }
+
+  static func random(using rng: inout some RandomNumberGenerator) -> Message {
+    switch Int.random(in: 0..<10, using: &rng) {
+      case 0: return .hello(.random(in: 0...255, using: &rng), .random(in: .min ... .max, using: &rng),
+                            SessionToken(high: rng.next(), low: rng.next()))
+      case 1: return .input((0..<Int.random(in: 0..<2048, using: &rng)).map { _ in UInt8.random(in: 0...255, using: &rng) })
+      case 2: return .resize(.random(in: 0 ... .max, using: &rng), .random(in: 0 ... .max, using: &rng))
+      case 3: return .ping(.random(in: 0 ... .max, using: &rng), .random(in: 0 ... .max, using: &rng))
+      case 4: return .pong(.random(in: 0 ... .max, using: &rng), .random(in: 0 ... .max, using: &rng), .random(in: 0 ... .max, using: &rng))
+      case 5: return .status(.random(in: .min ... .max, using: &rng), Bool.random(using: &rng) ? nil : .random(in: .min ... .max, using: &rng))
+      case 6: return .credit(.random(in: 0 ... .max, using: &rng))
+      case 7: return .output((0..<Int.random(in: 0..<2048, using: &rng)).map { _ in UInt8.random(in: 0...255, using: &rng) })
+      case 8: return .resume
+      default: return .relayStats(RelayStats(hosts: .random(in: 0 ... .max, using: &rng), received: rng.next(),
+                                             queued: rng.next(), forwarded: rng.next(), dropped: rng.next(),
+                                             latencyP50: rng.next(), latencyP99: rng.next()))
+    }
+  }
+}
+
+// Deterministic generator, so failures can be reproduced.
+private struct SplitMix64: RandomNumberGenerator {
+  var state: UInt64
+
+  mutating func next() -> UInt64 {
+    state &+= 0x9E3779B97F4A7C15
+    var z = state
+    z = (z ^ (z >> 30)) &* 0xBF58476D1CE4E5B9
+    z = (z ^ (z >> 27)) &* 0x94D049BB133111EB
+    return z ^ (z >> 31)
+  }
+}
+
+final class WireProtocolTests: XCTestCase {
+
+  private func encode(_ messages: [Message]) -> [UInt8] {
+    var encoded = [UInt8]()
+    for message in messages {
+      message.withFrame { frame in
+        let start = encoded.count
+        encoded.append(contentsOf: repeatElement(0, count: frame.encodedSize))
+        encoded.withUnsafeMutableBytes { buffer in
+          XCTAssertEqual(frame.encodedSize, frame.encode(into: UnsafeMutableRawBufferPointer(rebasing: buffer[start...])))
+        }
+      }
+    }
+    return encoded
+  }
+
+  func testEncodingLayout() throws {
+    let encoded = encode([.credit(0x01020304)])
+    XCTAssertEqual([Wire.FrameType.credit.rawValue, 0, 0, 0, 4, 1, 2, 3, 4], encoded)
+
+    let data = Frame.credit(0x01020304).data()
+    XCTAssertEqual(encoded, Array(data))
+  }
+
+  func testRoundTrip() throws {
+    var rng = SplitMix64(state: 42)
+    let messages = (0..<500).map { _ in Message.random(using: &rng) }
+
+    var decoder = FrameDecoder()
+    var received = [Message]()
+    try encode(messages).withUnsafeBytes { bytes in
+      try decoder.decode(bytes) { received.append(Message($0)) }
+    }
+    XCTAssertEqual(messages, received)
+  }
+
+  func testRandomSplits() throws {
+    var rng = SplitMix64(state: 1337)
+    for _ in 0..<50 {
+      let messages = (0..<100).map { _ in Message.random(using: &rng) }
+      let encoded = encode(messages)
+
+      var decoder = FrameDecoder()
+      var received = [Message]()
+      var offset = 0
+      while offset < encoded.count {
+        // frequently split inside headers
+        let count = min(encoded.count - offset, Bool.random(using: &rng) ? .random(in: 1...6, using: &rng) : .random(in: 1...4096, using: &rng))
+        try encoded[offset..<offset + count].withUnsafeBytes { bytes in
+          try decoder.decode(bytes) { received.append(Message($0)) }
+        }
+        offset += count
+      }
+      XCTAssertEqual(messages, received)
+    }
+  }
+
+  func testRoundTripOverSocketPair() throws {
+    var fds: [Int32] = [0, 0]
+    XCTAssertEqual(0, socketpair(AF_UNIX, SOCK_STREAM, 0, &fds))
+    let (writer, reader) = (fds[0], fds[1])
+    defer { close(reader) }
+
+    var rng = SplitMix64(state: 7)
+    let messages = (0..<2000).map { _ in Message.random(using: &rng) }
+    let encoded = encode(messages)
+
+    Thread.detachNewThread {
+      var rng = SplitMix64(state: 8)
+      var offset = 0
+      while offset < encoded.count {
+        let count = min(encoded.count - offset, .random(in: 1...8192, using: &rng))
+        let written = encoded[offset..<offset + count].withUnsafeBytes { write(writer, $0.baseAddress, $0.count) }
+        guard written > 0 else { break }
+        offset += written
+      }
+      close(writer)
+    }
+
+    var decoder = FrameDecoder()
+    var received = [Message]()
+    // Odd buffer size, so frames are split across reads.
+    var buffer = [UInt8](repeating: 0, count: 1021)
+    while true {
+      let count = read(reader, &buffer, buffer.count)
+      guard count > 0 else { break }
+      try buffer.withUnsafeBytes { bytes in
+        try decoder.decode(UnsafeRawBufferPointer(rebasing: bytes[0..<count])) { received.append(Message($0)) }
+      }
+    }
+    XCTAssertEqual(messages, received)
+  }
+
+  func testDispatchDataDecoding() throws {
+    let messages: [Message] = [.hello(Wire.version, 12, .random()), .input(Array("hello world".utf8)), .ping(1, 2)]
+    var data = DispatchData.empty
+    for message in messages {
+      message.withFrame { data.append($0.data()) }
+    }
+
+    var decoder = FrameDecoder()
+    var received = [Message]()
+    try decoder.decode(data) { received.append(Message($0)) }
+    XCTAssertEqual(messages, received)
+  }
+
+  func testInvalidFrames() throws {
+    // unknown type
+    var decoder = FrameDecoder()
+    XCTAssertThrowsError(try [UInt8]([0xff, 0, 0, 0, 0]).withUnsafeBytes { try decoder.decode($0) { _ in } })
+
+    // oversized payload
+    decoder = FrameDecoder()
+    let length = UInt32(Wire.maxPayloadSize + 1)
+    let header = [Wire.FrameType.input.rawValue] + withUnsafeBytes(of: length.bigEndian) { Array($0) }
+    XCTAssertThrowsError(try header.withUnsafeBytes { try decoder.decode($0) { _ in } })
+
+    // invalid fixed size payload
+    decoder = FrameDecoder()
+    XCTAssertThrowsError(try [UInt8]([Wire.FrameType.credit.rawValue, 0, 0, 0, 2, 1, 2]).withUnsafeBytes { try decoder.decode($0) { _ in } })
+  }
+
+  // Random garbage must either be decoded or rejected, but never crash the decoder.
+  func testFuzzGarbage() throws {
+    var rng = SplitMix64(state: 0xC55)
+    for _ in 0..<2000 {
+      var bytes = (0..<Int.random(in: 0..<64, using: &rng)).map { _ in UInt8.random(in: 0...255, using: &rng) }
+      // Keep lengths small most of the time, so payloads are actually parsed.
+      if bytes.count >= Wire.headerSize, Bool.random(using: &rng) {
+        bytes[0] = Wire.FrameType.allCases.randomElement(using: &rng)!.rawValue
+        bytes[1] = 0
+        bytes[2] = 0
+        bytes[3] = 0
+        bytes[4] = .random(in: 0...24, using: &rng)
+      }
+      var decoder = FrameDecoder()
+      _ = try? bytes.withUnsafeBytes { try decoder.decode($0) { _ in } }
+    }
+  }
+}
@@ -35,6 +35,19 @@ final class csshx_tests: XCTestCase {
     XCTAssertEqual("john", user)
     XCTAssertEqual("www.example.com", host)
     XCTAssertEqual("[22-24]", port)
+
+    // Empty user, hostname or port are part of the hostname.
+    (user, host, port) = try "@host:".parseUserHostPort()
+    XCTAssertNil(user)
+    XCTAssertEqual("@host:", host)
+    XCTAssertNil(port)
+
+    (user, host, port) = try "a@b@c:1:2".parseUserHostPort()
+    XCTAssertEqual("a", user)
+    XCTAssertEqual("b@c", host)
+    XCTAssertEqual("1:2", port)
+
+    XCTAssertThrowsError(try "".parseUserHostPort())
   }
 
 }
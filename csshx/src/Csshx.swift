@@ -15,6 +15,8 @@ struct Csshx {
   // To launch csshx in controller or host mode, use the following command:
   // csshx -- controller <options>
   // csshx -- host <options>
+  // csshx -- relay <options> <hosts>
+  // csshx -- replay <options> <recording>
 
   static func main() throws {
     let args = CommandLine.arguments.dropFirst()
@@ -24,6 +26,10 @@ struct Csshx {
           return ControllerCommand.main(Array(args.dropFirst(2)))
         case "host":
           return HostCommand.main(Array(args.dropFirst(2)))
+        case "relay":
+          return RelayCommand.main(Array(args.dropFirst(2)))
+        case "replay":
+          return ReplayCommand.main(Array(args.dropFirst(2)))
         default:
           // Let the launcher fails with argument parsing and report error properly.
           break